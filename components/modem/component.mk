@@ -1,3 +1,6 @@
 COMPONENT_ADD_INCLUDEDIRS := include
 COMPONENT_PRIV_INCLUDEDIRS := private_include
 COMPONENT_SRCDIRS := src
+
+# esp_modem_cmux.hpp needs C++17
+src/esp_modem_cmux.o: CXXFLAGS += -std=gnu++17
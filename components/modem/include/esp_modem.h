@@ -20,8 +20,10 @@ extern "C" {
 #include "esp_modem_dce.h"
 #include "esp_modem_dte.h"
 #include "esp_event.h"
+#include "esp_heap_caps.h"
 #include "driver/uart.h"
 #include "esp_modem_compat.h"
+#include "esp_modem_transport.h"
 
 /**
  * @brief Declare Event Base for ESP Modem
@@ -40,10 +42,47 @@ typedef enum {
 } esp_modem_event_t;
 
 /**
- * @brief ESP Modem DTE Configuration
+ * @brief Classes of the memory allocated by the DTE, each placed by its own heap capabilities
+ *
+ */
+typedef enum {
+    ESP_MODEM_MEM_RX = 0,   /*!< Receive path: line, DLCI line, PPP reassembly and RX pipeline buffers */
+    ESP_MODEM_MEM_TX,       /*!< Transient command buffers */
+    ESP_MODEM_MEM_BULK,     /*!< Staging: RX pipeline queue, dial on demand queue */
+    ESP_MODEM_MEM_CLASSES
+} esp_modem_mem_class_t;
+
+/**
+ * @brief Heap capabilities of internal RAM
+ *
+ */
+#define ESP_MODEM_MEM_CAPS_INTERNAL (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+
+/**
+ * @brief Heap capabilities of PSRAM, allocations fall back to internal RAM without PSRAM
+ *
+ */
+#define ESP_MODEM_MEM_CAPS_EXTERNAL (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+
+/**
+ * @brief Bytes allocated by the DTE per memory class and region
  *
+ * UART driver ring buffers are allocated by the driver in internal RAM and not counted.
  */
 typedef struct {
+    size_t internal_bytes[ESP_MODEM_MEM_CLASSES];   /*!< Bytes in internal RAM now */
+    size_t external_bytes[ESP_MODEM_MEM_CLASSES];   /*!< Bytes in PSRAM now */
+    size_t internal_peak;                           /*!< Peak of the internal RAM total */
+    size_t external_peak;                           /*!< Peak of the PSRAM total */
+    uint32_t fallbacks;                             /*!< Allocations which asked for PSRAM and got internal RAM */
+    uint32_t failures;                              /*!< Allocations which failed */
+} esp_modem_mem_report_t;
+
+/**
+ * @brief ESP Modem DTE Configuration
+ *
+ */
+typedef struct esp_modem_dte_config {
     uart_port_t port_num;           /*!< UART port number */
     uart_word_length_t data_bits;   /*!< Data bits of UART */
     uart_stop_bits_t stop_bits;     /*!< Stop bits of UART */
@@ -60,10 +99,133 @@ typedef struct {
     int event_queue_size;           /*!< UART Event Queue Size */
     uint32_t event_task_stack_size; /*!< UART Event Task Stack size */
     int event_task_priority;        /*!< UART Event Task Priority */
+    int event_task_core;            /*!< Core of the UART Event Task, tskNO_AFFINITY for any */
+    bool rx_pipeline;               /*!< Read and decode in a separate RX task, the event task only runs the handlers */
+    uint32_t rx_task_stack_size;    /*!< RX Task Stack size */
+    int rx_task_priority;           /*!< RX Task Priority */
+    int rx_task_core;               /*!< Core of the RX Task, tskNO_AFFINITY for any */
+    int rx_queue_size;              /*!< Bytes of decoded lines and frames queued between the RX and event task */
     int line_buffer_size;           /*!< Line buffer size for command mode */
     bool cmux;
+    esp_modem_transport_t *transport;   /*!< Transport to the DCE, NULL for the UART above. The DTE takes ownership */
+    bool use_saved_buffer_sizes;    /*!< Replace the buffer and queue sizes above by those saved with esp_modem_save_buffer_sizes() */
+    int ri_io_num;                  /*!< Ring indicator pin (active low), a wakeup source from light sleep, UART_PIN_NO_CHANGE if not connected */
+    int uart_wakeup_threshold;      /*!< RX edges waking the chip from light sleep (UART0/1 only), 0 to disable. The bytes counted are lost */
+    uint32_t wake_hold_ms;          /*!< Time light sleep stays blocked after a wakeup, a command or received data */
+    uint32_t mem_caps[ESP_MODEM_MEM_CLASSES];   /*!< Heap capabilities of each memory class, see esp_modem_mem_class_t */
 } esp_modem_dte_config_t;
 
+/**
+ * @brief CMUX TX statistics of the data DLCI
+ *
+ */
+typedef struct {
+    uint32_t packets;               /*!< Packets passed to send_cmux_data */
+    uint32_t coalesced_packets;     /*!< Packets which shared a frame with an earlier packet */
+    uint32_t frames;                /*!< UIH frames sent */
+    uint64_t payload_bytes;         /*!< Payload bytes sent */
+    uint64_t overhead_bytes;        /*!< Framing bytes sent */
+} esp_modem_cmux_tx_stats_t;
+
+/**
+ * @brief RX statistics and interrupt moderation state
+ *
+ */
+typedef struct {
+    uint32_t data_events;           /*!< Data events received from the transport */
+    uint64_t data_bytes;            /*!< Bytes announced by data events */
+    uint32_t moderation_raises;     /*!< Moderation level increases */
+    uint32_t moderation_lowers;     /*!< Moderation level decreases */
+    uint8_t moderation_level;       /*!< Current moderation level, 0 is the most responsive */
+    uint32_t last_event_rate;       /*!< Data events per second in the last measuring window */
+    uint32_t throttles;             /*!< Times the DCE was asked to stop sending because the RX buffer filled up */
+    uint32_t unknown_lines;         /*!< Lines no handler took, posted as ESP_MODEM_EVENT_UNKNOWN */
+    uint32_t unknown_dropped;       /*!< ESP_MODEM_EVENT_UNKNOWN events lost because the event queue was full */
+    uint32_t fcs_errors;            /*!< CMUX frames dropped because of a wrong FCS */
+    uint64_t rx_busy_us;            /*!< Time spent reading and decoding received data, waits and handlers excluded */
+    uint64_t handler_busy_us;       /*!< Time spent in the line, frame and PPP handlers */
+} esp_modem_rx_stats_t;
+
+/**
+ * @brief Wakeup statistics, kept when a ring indicator or UART wakeup is configured
+ *
+ */
+typedef struct {
+    uint32_t ri_wakeups;            /*!< Wakeups by the ring indicator */
+    uint32_t uart_wakeups;          /*!< Wakeups by UART activity */
+    uint32_t idle_rx;               /*!< Data received while sleep was allowed and the chip was awake for another reason */
+    uint32_t sleep_allowed;         /*!< Times light sleep was allowed again */
+    uint32_t wake_lines;            /*!< Lines (URCs) dispatched within the hold time of a wakeup */
+} esp_modem_wake_stats_t;
+
+/**
+ * @brief Buffer and queue sizes of a DTE, as in esp_modem_dte_config_t
+ *
+ */
+typedef struct {
+    int rx_buffer_size;             /*!< UART RX Buffer Size */
+    int tx_buffer_size;             /*!< UART TX Buffer Size */
+    int event_queue_size;           /*!< UART Event Queue Size */
+    int pattern_queue_size;         /*!< UART Pattern Queue Size */
+    int line_buffer_size;           /*!< Line buffer size */
+} esp_modem_buffer_sizes_t;
+
+/**
+ * @brief Buffer usage report of a DTE
+ *
+ * Peaks are only known for transports which report watermarks (UART); other
+ * sizes are recommended unchanged.
+ */
+typedef struct {
+    esp_modem_buffer_sizes_t configured;    /*!< Sizes in use */
+    esp_modem_buffer_sizes_t peak;          /*!< Highest usage since init, tx_buffer_size is the largest write */
+    esp_modem_buffer_sizes_t recommended;   /*!< Peak plus margin, never below the driver minimums */
+    uint32_t rx_overflows;                  /*!< Received data lost by the transport */
+    uint32_t line_overflows;                /*!< Lines or frames dropped because the line buffer was full */
+} esp_modem_buffer_report_t;
+
+/**
+ * @brief Bring-up phases recorded in the startup timeline
+ *
+ */
+typedef enum {
+    ESP_MODEM_PHASE_DTE_INIT = 0,   /*!< Transport opened, event loop and tasks created */
+    ESP_MODEM_PHASE_LEAVE_DATA,     /*!< "+++" and CMUX close down sent */
+    ESP_MODEM_PHASE_SYNC,           /*!< DCE answered AT */
+    ESP_MODEM_PHASE_IDENTITY,       /*!< Echo off, module name, PIN, IMEI, IMSI and operator queried */
+    ESP_MODEM_PHASE_CMUX_MODE,      /*!< AT+CMUX accepted */
+    ESP_MODEM_PHASE_DLCI0_OPEN,     /*!< Control channel opened */
+    ESP_MODEM_PHASE_DLCI1_OPEN,     /*!< Data channel opened */
+    ESP_MODEM_PHASE_DLCI2_OPEN,     /*!< AT channel opened */
+    ESP_MODEM_PHASE_PDP_CONTEXT,    /*!< PDP context defined */
+    ESP_MODEM_PHASE_DIAL,           /*!< Dial answered with CONNECT */
+    ESP_MODEM_PHASE_PPP_GOT_IP,     /*!< PPP negotiation done, IP address assigned */
+    ESP_MODEM_PHASE_MAX
+} esp_modem_phase_t;
+
+/**
+ * @brief Startup timeline of a DTE
+ *
+ */
+typedef struct {
+    int64_t start_us;                       /*!< esp_timer_get_time() when esp_modem_dte_init() was called */
+    uint32_t end_ms[ESP_MODEM_PHASE_MAX];   /*!< First time each phase completed, ms after start_us, 0 if not yet */
+} esp_modem_timeline_t;
+
+/**
+ * @brief Raw data transfer on the command channel, e.g. a modem file or socket upload
+ *
+ */
+typedef struct {
+    const char *command;                                            /*!< Command opening the transfer */
+    const char *prompt;                                             /*!< Text the DCE sends before taking data, e.g. "CONNECT" or "> " */
+    uint32_t prompt_timeout_ms;                                     /*!< Time to wait for the prompt */
+    esp_err_t (*next)(void *ctx, const void **data, size_t *len);   /*!< Next block to send, valid until the next call, len 0 at the end */
+    void *ctx;                                                      /*!< Context of next */
+    esp_err_t (*handle_result)(modem_dce_t *dce, const char *line); /*!< Handler of the final response, NULL for OK/ERROR */
+    uint32_t result_timeout_ms;                                     /*!< Time to wait for the final response after the last byte */
+} esp_modem_raw_transfer_t;
+
 /**
  * @brief Type used for reception callback
  *
@@ -92,8 +254,24 @@ typedef esp_err_t (*esp_modem_on_receive)(void *buffer, size_t len, void *contex
         .event_queue_size = 30,                 \
         .event_task_stack_size = 2048,          \
         .event_task_priority = 5,               \
+        .event_task_core = tskNO_AFFINITY,      \
+        .rx_pipeline = false,                   \
+        .rx_task_stack_size = 2048,             \
+        .rx_task_priority = 6,                  \
+        .rx_task_core = tskNO_AFFINITY,         \
+        .rx_queue_size = 4096,                  \
         .line_buffer_size = 512,                \
-        .cmux = true                            \
+        .cmux = true,                           \
+        .transport = NULL,                      \
+        .use_saved_buffer_sizes = false,        \
+        .ri_io_num = UART_PIN_NO_CHANGE,        \
+        .uart_wakeup_threshold = 0,             \
+        .wake_hold_ms = 200,                    \
+        .mem_caps = {                           \
+            ESP_MODEM_MEM_CAPS_INTERNAL,        \
+            ESP_MODEM_MEM_CAPS_INTERNAL,        \
+            ESP_MODEM_MEM_CAPS_EXTERNAL,        \
+        }                                       \
     }
 
 /**
@@ -105,6 +283,21 @@ typedef esp_err_t (*esp_modem_on_receive)(void *buffer, size_t len, void *contex
  */
 modem_dte_t *esp_modem_dte_init(const esp_modem_dte_config_t *config);
 
+/**
+ * @brief Restart the protocol state of a DTE without reinstalling the UART driver
+ *
+ * Flushes the UART and the line/CMUX parser, returns to command mode and asks
+ * the DCE to leave PPP and CMUX mode. The UART driver, the event task and the
+ * event loop stay alive and the bound DCE object is kept, so recovery continues
+ * with dce->sync() and esp_modem_start_cmux()/esp_modem_start_ppp().
+ *
+ * @param dte Modem DTE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dte_reset(modem_dte_t *dte);
+
 /**
  * @brief Register event handler for ESP Modem event loop
  *
@@ -129,6 +322,21 @@ esp_err_t esp_modem_set_event_handler(modem_dte_t *dte, esp_event_handler_t hand
  */
 esp_err_t esp_modem_remove_event_handler(modem_dte_t *dte, esp_event_handler_t handler);
 
+/**
+ * @brief Unregister event handler registered for one event id
+ *
+ * esp_modem_remove_event_handler() only removes handlers registered for
+ * ESP_EVENT_ANY_ID.
+ *
+ * @param dte modem_dte_t type object
+ * @param handler event handler to unregister
+ * @param event_id event id the handler was registered for
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid combination of event base and event id
+ */
+esp_err_t esp_modem_remove_event_handler_id(modem_dte_t *dte, esp_event_handler_t handler, int32_t event_id);
+
 /**
  * @brief Setup PPP Session
  *
@@ -159,6 +367,53 @@ esp_err_t esp_modem_start_cmux(modem_dte_t *dte);
  */
 esp_err_t esp_modem_stop_ppp(modem_dte_t *dte);
 
+/**
+ * @brief Drop the data call but keep the PPP network interface up
+ *
+ * Takes the esp_modem_dte_reset() fast path without posting ESP_MODEM_EVENT_PPP_STOP,
+ * so the PPP session of the network interface survives and renegotiates after
+ * esp_modem_resume_ppp(). Once the DCE answers commands again the call is hung
+ * up, which releases the radio. Used for dial on demand. In command mode, e.g.
+ * after an attempt which failed to hang up, only the hang up is done.
+ *
+ * @param dte Modem DTE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL if the DCE did not answer or hang up
+ */
+esp_err_t esp_modem_suspend_ppp(modem_dte_t *dte);
+
+/**
+ * @brief Dial again after esp_modem_suspend_ppp()
+ *
+ * Synchronizes with the DCE, starts CMUX if the DTE uses it and dials, without
+ * posting ESP_MODEM_EVENT_PPP_START.
+ *
+ * @param dte Modem DTE object
+ * @return esp_err_t
+ *      - ESP_OK when the DCE answered CONNECT
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_resume_ppp(modem_dte_t *dte);
+
+/**
+ * @brief Send a command, then raw data once the DCE prompts for it, and wait for the final response
+ *
+ * Blocks are written from where the source keeps them, without staging them in
+ * RAM. In CMUX mode they are split into frames on the AT channel. The prompt is
+ * matched before a line end arrives, so "> " works as well as "CONNECT".
+ *
+ * @param dte Modem DTE object
+ * @param transfer transfer description
+ * @param sent bytes handed to the transport, may be NULL
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if PPP owns the only channel (CMUX not used)
+ *      - ESP_ERR_TIMEOUT if the prompt or the final response did not come in time
+ *      - ESP_FAIL if the command or the transfer failed
+ */
+esp_err_t esp_modem_send_raw(modem_dte_t *dte, const esp_modem_raw_transfer_t *transfer, size_t *sent);
+
 /**
  * @brief Setup on reception callback
  *
@@ -170,6 +425,121 @@ esp_err_t esp_modem_stop_ppp(modem_dte_t *dte);
  */
 esp_err_t esp_modem_set_rx_cb(modem_dte_t *dte, esp_modem_on_receive receive_cb, void *receive_cb_ctx);
 
+/**
+ * @brief Get CMUX TX statistics of the data DLCI
+ *
+ * @param dte Modem DTE object
+ * @param stats output statistics
+ * @return ESP_OK on success
+ */
+esp_err_t esp_modem_get_cmux_tx_stats(modem_dte_t *dte, esp_modem_cmux_tx_stats_t *stats);
+
+/**
+ * @brief Get peak usage of the DTE buffers and queues with recommended sizes
+ *
+ * @param dte Modem DTE object
+ * @param report output report
+ * @return ESP_OK on success
+ */
+esp_err_t esp_modem_get_buffer_report(modem_dte_t *dte, esp_modem_buffer_report_t *report);
+
+/**
+ * @brief Allocate memory of a class, placed by the capabilities configured for it
+ *
+ * Used by the modem component for the DTE buffers, and for staging buffers
+ * belonging to the DTE, so they show up in the memory report.
+ *
+ * @param dte Modem DTE object
+ * @param mem_class memory class
+ * @param size bytes to allocate
+ * @return pointer to the memory, NULL on failure
+ */
+void *esp_modem_dte_malloc(modem_dte_t *dte, esp_modem_mem_class_t mem_class, size_t size);
+
+/**
+ * @brief Free memory allocated by esp_modem_dte_malloc()
+ *
+ * @param dte Modem DTE object
+ * @param mem_class memory class given to esp_modem_dte_malloc()
+ * @param ptr memory to free, may be NULL
+ */
+void esp_modem_dte_free(modem_dte_t *dte, esp_modem_mem_class_t mem_class, void *ptr);
+
+/**
+ * @brief Get the bytes allocated by the DTE per memory class in internal RAM and PSRAM
+ *
+ * @param dte Modem DTE object
+ * @param report output report
+ * @return ESP_OK on success
+ */
+esp_err_t esp_modem_get_mem_report(modem_dte_t *dte, esp_modem_mem_report_t *report);
+
+/**
+ * @brief Save the recommended buffer sizes to NVS
+ *
+ * They are applied by esp_modem_dte_init() when use_saved_buffer_sizes is set.
+ * Run this after the device has seen representative traffic; nvs_flash_init()
+ * has to be called before.
+ *
+ * @param dte Modem DTE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - error code of the NVS API otherwise
+ */
+esp_err_t esp_modem_save_buffer_sizes(modem_dte_t *dte);
+
+/**
+ * @brief Record the completion of a bring-up phase
+ *
+ * Only the first completion of each phase after esp_modem_dte_init() is kept.
+ * When the PPP_GOT_IP phase completes, the timeline is logged as one line.
+ *
+ * @param dte Modem DTE object
+ * @param phase completed phase
+ */
+void esp_modem_mark_phase(modem_dte_t *dte, esp_modem_phase_t phase);
+
+/**
+ * @brief Get the startup timeline
+ *
+ * @param dte Modem DTE object
+ * @param timeline output timeline
+ * @return ESP_OK on success
+ */
+esp_err_t esp_modem_get_timeline(modem_dte_t *dte, esp_modem_timeline_t *timeline);
+
+/**
+ * @brief Get RX statistics and the interrupt moderation state
+ *
+ * rx_busy_us plus handler_busy_us, sampled twice, gives the CPU time the
+ * receive side used in between; handlers of ESP_MODEM_EVENT_UNKNOWN and other
+ * events run in the same task but are not included.
+ *
+ * @param dte Modem DTE object
+ * @param stats output statistics
+ * @return ESP_OK on success
+ */
+esp_err_t esp_modem_get_rx_stats(modem_dte_t *dte, esp_modem_rx_stats_t *stats);
+
+/**
+ * @brief Get wakeup statistics
+ *
+ * With a ring indicator or UART wakeup configured, the DTE holds a power
+ * management lock against light sleep in data and CMUX mode, while a command
+ * runs and for wake_hold_ms after a wakeup or received data. In between, light
+ * sleep is allowed and the modem wakes the chip for URCs. The ring indicator
+ * takes the lock from its interrupt, so URCs sent after RI asserts are received
+ * whole; a UART wakeup loses the bytes counted by uart_wakeup_threshold, which
+ * should stay at the minimum so only the leading CR LF of a URC is used up.
+ *
+ * @param dte Modem DTE object
+ * @param stats output statistics
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if no wakeup source is configured
+ */
+esp_err_t esp_modem_get_wake_stats(modem_dte_t *dte, esp_modem_wake_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
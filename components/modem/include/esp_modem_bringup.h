@@ -0,0 +1,91 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_modem_dce.h"
+
+/**
+ * @brief Max number of steps of one bring-up
+ *
+ */
+#define ESP_MODEM_BRINGUP_MAX_STEPS (32)
+
+/**
+ * @brief Bit of a step in esp_modem_bringup_step_t::requires
+ *
+ */
+#define ESP_MODEM_BRINGUP_STEP(index) (1UL << (index))
+
+/**
+ * @brief One step of a bring-up
+ *
+ */
+typedef struct {
+    const char *name;                               /*!< Name, for the log */
+    esp_err_t (*run)(modem_dce_t *dce, void *arg);  /*!< Step function */
+    void *arg;                                      /*!< Argument of the step function */
+    uint32_t requires;                              /*!< ESP_MODEM_BRINGUP_STEP() of the steps which have to succeed first */
+    bool dial;                                      /*!< Starts PPP, e.g. by attaching the netif; without CMUX every other step runs before */
+    bool optional;                                  /*!< A failure does not fail the bring-up, steps requiring this one are skipped */
+} esp_modem_bringup_step_t;
+
+/**
+ * @brief Outcome of one step
+ *
+ */
+typedef enum {
+    ESP_MODEM_BRINGUP_PENDING = 0,  /*!< Not run, bring-up stopped before */
+    ESP_MODEM_BRINGUP_DONE,         /*!< Succeeded */
+    ESP_MODEM_BRINGUP_FAILED,       /*!< Failed */
+    ESP_MODEM_BRINGUP_SKIPPED       /*!< A required step failed or was skipped */
+} esp_modem_bringup_state_t;
+
+/**
+ * @brief Result of one step
+ *
+ */
+typedef struct {
+    esp_modem_bringup_state_t state;    /*!< Outcome */
+    uint32_t start_ms;                  /*!< Start, relative to the start of the bring-up */
+    uint32_t duration_ms;               /*!< Run time */
+} esp_modem_bringup_result_t;
+
+/**
+ * @brief Run bring-up steps, dialing as early as their dependencies allow
+ *
+ * The dial steps and the steps they require run first, in index order, and
+ * the remaining steps follow. With CMUX those go to the AT channel while PPP
+ * negotiates on the data channel, so informational queries no longer add to
+ * the time to IP. Without CMUX the data channel is the only channel, so every
+ * step runs before dialing.
+ *
+ * @param dce Modem DCE object
+ * @param steps steps, a step may only require steps of lower index
+ * @param count number of steps, at most ESP_MODEM_BRINGUP_MAX_STEPS
+ * @param results per step results, count entries, NULL if not needed
+ * @return esp_err_t
+ *      - ESP_OK if no mandatory step failed
+ *      - ESP_ERR_INVALID_ARG on too many steps or a forward requirement
+ *      - ESP_FAIL if a mandatory step failed or was skipped
+ */
+esp_err_t esp_modem_bringup(modem_dce_t *dce, const esp_modem_bringup_step_t *steps, size_t count,
+                            esp_modem_bringup_result_t *results);
+
+#ifdef __cplusplus
+}
+#endif
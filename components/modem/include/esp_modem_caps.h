@@ -0,0 +1,132 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_modem_dce.h"
+
+/**
+ * @brief Max length of the firmware revision (AT+CGMR) the capabilities are keyed on
+ *
+ */
+#define ESP_MODEM_CAPS_REVISION_LENGTH (48)
+
+/**
+ * @brief Max number of baud rates kept from AT+IPR=?
+ *
+ */
+#define ESP_MODEM_CAPS_MAX_BAUD_RATES (16)
+
+/**
+ * @brief Supported commands, bits of esp_modem_caps_t::commands
+ *
+ */
+#define ESP_MODEM_CAP_CMUX      (1 << 0)  /*!< AT+CMUX */
+#define ESP_MODEM_CAP_IPR       (1 << 1)  /*!< AT+IPR */
+#define ESP_MODEM_CAP_IFC       (1 << 2)  /*!< AT+IFC */
+#define ESP_MODEM_CAP_CGDCONT   (1 << 3)  /*!< AT+CGDCONT */
+#define ESP_MODEM_CAP_PSM       (1 << 4)  /*!< AT+CPSMS */
+#define ESP_MODEM_CAP_EDRX      (1 << 5)  /*!< AT+CEDRXS */
+
+/**
+ * @brief PDP types, bits of esp_modem_caps_t::pdp_types
+ *
+ */
+#define ESP_MODEM_CAP_PDP_IP        (1 << 0)
+#define ESP_MODEM_CAP_PDP_IPV6      (1 << 1)
+#define ESP_MODEM_CAP_PDP_IPV4V6    (1 << 2)
+#define ESP_MODEM_CAP_PDP_PPP       (1 << 3)
+
+/**
+ * @brief Inclusive range of a numeric parameter
+ *
+ */
+typedef struct {
+    uint16_t min;
+    uint16_t max;
+} esp_modem_caps_range_t;
+
+/**
+ * @brief Capabilities of a DCE, parsed from the test commands (AT+...=?)
+ *
+ * Value sets of small parameters are bit masks, bit n set when value n is supported.
+ */
+typedef struct {
+    char revision[ESP_MODEM_CAPS_REVISION_LENGTH];          /*!< Firmware revision, AT+CGMR */
+    uint32_t commands;                                      /*!< ESP_MODEM_CAP_ bits of the supported commands */
+    uint8_t cmux_modes;                                     /*!< AT+CMUX <mode> values */
+    uint8_t cmux_subsets;                                   /*!< AT+CMUX <subset> values */
+    esp_modem_caps_range_t cmux_frame_size;                 /*!< AT+CMUX <N1> range */
+    uint32_t baud_rates[ESP_MODEM_CAPS_MAX_BAUD_RATES];     /*!< AT+IPR rates, ascending */
+    uint8_t baud_rate_count;                                /*!< Valid entries of baud_rates */
+    uint8_t ifc_dce_by_dte;                                 /*!< AT+IFC <DCE_by_DTE> values */
+    uint8_t ifc_dte_by_dce;                                 /*!< AT+IFC <DTE_by_DCE> values */
+    esp_modem_caps_range_t pdp_cid;                         /*!< AT+CGDCONT <cid> range */
+    uint8_t pdp_types;                                      /*!< ESP_MODEM_CAP_PDP_ bits */
+    uint8_t edrx_act_types;                                 /*!< AT+CEDRXS <AcT-type> values */
+} esp_modem_caps_t;
+
+/**
+ * @brief Probe the capabilities of the DCE
+ *
+ * Sends AT+CGMR and the test command of every known feature. A command answered
+ * with ERROR or not at all is reported as unsupported, so this takes a command
+ * timeout per missing feature.
+ *
+ * @param dce Modem DCE object
+ * @param caps probed capabilities
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL if the firmware revision could not be read
+ */
+esp_err_t esp_modem_caps_probe(modem_dce_t *dce, esp_modem_caps_t *caps);
+
+/**
+ * @brief Get the capabilities of the DCE, probing only once per firmware revision
+ *
+ * Reads the firmware revision and returns the capabilities saved in NVS for it.
+ * A new revision is probed with esp_modem_caps_probe() and saved, so the probe
+ * runs once per firmware update. nvs_flash_init() has to be called before.
+ *
+ * @param dce Modem DCE object
+ * @param caps capabilities
+ * @param cached set to true if the capabilities came from NVS, may be NULL
+ * @return esp_err_t
+ *      - ESP_OK on success, also if only saving failed
+ *      - ESP_FAIL if the firmware revision could not be read
+ */
+esp_err_t esp_modem_caps_get(modem_dce_t *dce, esp_modem_caps_t *caps, bool *cached);
+
+/**
+ * @brief Erase the capabilities saved in NVS, the next esp_modem_caps_get() probes again
+ *
+ * @return ESP_OK on success, NVS error code otherwise
+ */
+esp_err_t esp_modem_caps_clear(void);
+
+/**
+ * @brief Highest supported baud rate not above a limit
+ *
+ * @param caps capabilities
+ * @param limit highest rate the DTE can use
+ * @return baud rate, 0 if the DCE reported none
+ */
+uint32_t esp_modem_caps_max_baud_rate(const esp_modem_caps_t *caps, uint32_t limit);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,253 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+/**
+ * @brief Header-only CMUX (3GPP TS 27.010 basic option) frame codec for C++17
+ *
+ * The FCS table and the FCS of every header of a known address and control
+ * are computed at compile time, so encoding a frame is a copy and a lookup.
+ * The DTE uses it through the C functions of esp_modem_cmux.cpp.
+ */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#if __has_include(<span>)
+#include <span>
+#endif
+#include "esp_modem_dce.h"
+
+namespace esp_modem::cmux {
+
+/* Max information field length with a one byte length field */
+constexpr size_t max_payload = 127;
+/* Flag, address, control, length and FCS, flag */
+constexpr size_t overhead = 6;
+/* DLCIs addressable by the 6 bit DLCI field */
+constexpr size_t dlcis = 64;
+
+#if defined(__cpp_lib_span) && __cpp_lib_span >= 202002L
+template <typename T>
+using span = std::span<T>;
+#else
+/**
+ * @brief The part of std::span used by the codec, for C++17
+ */
+template <typename T>
+class span {
+public:
+    constexpr span() noexcept = default;
+    constexpr span(T *data, size_t size) noexcept : data_(data), size_(size) {}
+    template <size_t N>
+    constexpr span(T (&array)[N]) noexcept : data_(array), size_(N) {}
+    template <typename U, size_t N>
+    constexpr span(std::array<U, N> &array) noexcept : data_(array.data()), size_(N) {}
+    constexpr T *data() const noexcept { return data_; }
+    constexpr size_t size() const noexcept { return size_; }
+    constexpr T &operator[](size_t i) const noexcept { return data_[i]; }
+private:
+    T *data_ = nullptr;
+    size_t size_ = 0;
+};
+#endif
+
+/**
+ * @brief Table of the reflected CRC8 with FCS_POLYNOMIAL
+ */
+constexpr std::array<uint8_t, 256> make_crc_table()
+{
+    std::array<uint8_t, 256> table{};
+    for (unsigned i = 0; i < table.size(); i++) {
+        uint8_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x01) ? (crc >> 1) ^ FCS_POLYNOMIAL : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+inline constexpr std::array<uint8_t, 256> crc_table = make_crc_table();
+
+/**
+ * @brief CRC8 of the frame check sequence, before the final complement
+ */
+constexpr uint8_t crc(const uint8_t *data, size_t length, uint8_t crc = FCS_INIT_VALUE)
+{
+    for (size_t i = 0; i < length; i++) {
+        crc = crc_table[crc ^ data[i]];
+    }
+    return crc;
+}
+
+/**
+ * @brief Frame check sequence of a header
+ */
+constexpr uint8_t fcs(const uint8_t *data, size_t length)
+{
+    return 0xFF - crc(data, length);
+}
+
+/**
+ * @brief Address field of a DLCI
+ *
+ * @param dlci DLCI
+ * @param command true to set the C/R bit
+ */
+constexpr uint8_t address(uint8_t dlci, bool command)
+{
+    return (dlci << 2) | (command ? CR : 0) | EA;
+}
+
+/**
+ * @brief One byte length field
+ */
+constexpr uint8_t length_field(size_t length)
+{
+    return (length << 1) | EA;
+}
+
+/**
+ * @brief FCS of the headers of one address and control, indexed by payload length
+ */
+template <uint8_t Address, uint8_t Control>
+inline constexpr std::array<uint8_t, max_payload + 1> header_fcs = [] {
+    std::array<uint8_t, max_payload + 1> table{};
+    for (size_t length = 0; length < table.size(); length++) {
+        const uint8_t header[] = { Address, Control, length_field(length) };
+        table[length] = fcs(header, sizeof(header));
+    }
+    return table;
+}();
+
+/**
+ * @brief Write a frame of a compile-time address and control
+ *
+ * @param out buffer of the frame
+ * @param payload information field
+ * @param length length of payload, at most max_payload
+ * @return length of the frame, 0 if the payload is too long or out too small
+ */
+template <uint8_t Address, uint8_t Control>
+inline size_t encode(span<uint8_t> out, const uint8_t *payload, size_t length)
+{
+    if (length > max_payload || out.size() < length + overhead) {
+        return 0;
+    }
+    out[0] = SOF_MARKER;
+    out[1] = Address;
+    out[2] = Control;
+    out[3] = length_field(length);
+    if (length) {
+        std::memcpy(&out[4], payload, length);
+    }
+    out[4 + length] = header_fcs<Address, Control>[length];
+    out[5 + length] = SOF_MARKER;
+    return length + overhead;
+}
+
+/**
+ * @brief Write a UIH frame of a compile-time DLCI, as sent by the DTE (C/R clear)
+ */
+template <uint8_t Dlci>
+inline size_t encode_uih(span<uint8_t> out, const uint8_t *payload, size_t length)
+{
+    static_assert(Dlci < dlcis, "DLCI out of range");
+    return encode<address(Dlci, false), FT_UIH>(out, payload, length);
+}
+
+/**
+ * @brief Write a frame of a runtime address and control
+ *
+ * @return length of the frame, 0 if the payload is too long or out too small
+ */
+inline size_t encode(span<uint8_t> out, uint8_t address, uint8_t control, const uint8_t *payload, size_t length)
+{
+    if (length > max_payload || out.size() < length + overhead) {
+        return 0;
+    }
+    out[0] = SOF_MARKER;
+    out[1] = address;
+    out[2] = control;
+    out[3] = length_field(length);
+    if (length) {
+        std::memcpy(&out[4], payload, length);
+    }
+    out[4 + length] = fcs(&out[1], 3);
+    out[5 + length] = SOF_MARKER;
+    return length + overhead;
+}
+
+/**
+ * @brief Result of parsing the start of a buffer
+ */
+enum class parse_result {
+    complete,       /*!< A valid frame */
+    incomplete,     /*!< The frame is not received whole yet */
+    invalid,        /*!< No frame: missing flags or two byte length */
+    bad_fcs,        /*!< A whole frame with a wrong FCS, size tells how much to skip */
+};
+
+/**
+ * @brief Frame found by parse()
+ */
+struct frame {
+    uint8_t dlci;               /*!< DLCI */
+    uint8_t control;            /*!< Control field, frame type with P/F */
+    const uint8_t *payload;     /*!< Information field */
+    size_t length;              /*!< Length of the information field */
+    size_t size;                /*!< Length of the frame, flags included */
+
+    constexpr bool is_uih() const
+    {
+        return (control & ~PF) == FT_UIH;
+    }
+};
+
+/**
+ * @brief Parse the frame at the start of a buffer
+ *
+ * @param in received bytes, starting with the opening flag
+ * @param out frame found, valid with complete and bad_fcs
+ * @return parse result
+ */
+constexpr parse_result parse(span<const uint8_t> in, frame &out)
+{
+    if (in.size() < 4) {
+        return parse_result::incomplete;
+    }
+    if (in[0] != SOF_MARKER || !(in[3] & EA)) {
+        return parse_result::invalid;
+    }
+    size_t length = in[3] >> 1;
+    size_t size = length + overhead;
+    if (in.size() < size) {
+        return parse_result::incomplete;
+    }
+    if (in[size - 1] != SOF_MARKER) {
+        return parse_result::invalid;
+    }
+    out.dlci = in[1] >> 2;
+    out.control = in[2];
+    out.payload = &in[4];
+    out.length = length;
+    out.size = size;
+    /* The FCS of UIH and of frames without information field covers the header only */
+    const uint8_t check[] = { in[1], in[2], in[3], in[4 + length] };
+    return crc(check, sizeof(check)) == FCS_GOOD_VALUE ? parse_result::complete : parse_result::bad_fcs;
+}
+
+} // namespace esp_modem::cmux
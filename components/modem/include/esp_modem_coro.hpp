@@ -0,0 +1,797 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+/**
+ * @brief C++20 coroutine interface for AT command sequences
+ *
+ * A flow is a coroutine returning esp_err_t which awaits commands, prompts,
+ * sleeps and other flows. Flows run on the task of one executor, which sends
+ * their commands one after the other; a suspended flow costs its coroutine
+ * frame instead of a task stack. The executor has to be the only user of the
+ * AT channel while flows run.
+ */
+
+#if !defined(__cpp_impl_coroutine)
+#error "esp_modem_coro.hpp needs C++20 coroutines, build with -std=gnu++20 (and -fcoroutines with GCC 10)"
+#endif
+
+#include <atomic>
+#include <coroutine>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_modem_dce_service.h"
+#include "esp_modem_cxx.hpp"
+
+namespace esp_modem::coro {
+
+/**
+ * @brief Error seen by the awaitables of a cancelled flow
+ */
+constexpr esp_err_t cancelled = ESP_ERR_INVALID_STATE;
+
+/**
+ * @brief Identifier of a spawned flow
+ */
+using flow_id = uint32_t;
+
+/**
+ * @brief Callback for a finished flow, called from the executor task
+ *
+ * @param id flow identifier returned by executor::spawn()
+ * @param err value returned by the flow
+ * @param ctx context pointer passed to executor::spawn()
+ */
+using done_cb_t = void (*)(flow_id id, esp_err_t err, void *ctx);
+
+/**
+ * @brief Executor configuration
+ */
+struct executor_config {
+    uint32_t task_stack_size = 3072;    /*!< Executor task stack size, the only stack the flows use */
+    int task_priority = 5;              /*!< Executor task priority */
+    int queue_size = 8;                 /*!< Spawn and cancel requests waiting for the executor task, other tasks block when it is full */
+    size_t response_size = 256;         /*!< Buffer of the response lines of the running command */
+};
+
+/**
+ * @brief Coroutine frames of all flows
+ */
+struct frame_stats {
+    size_t frames;          /*!< Frames allocated now */
+    size_t bytes;           /*!< Bytes allocated now */
+    size_t peak_bytes;      /*!< Highest number of bytes allocated at once */
+};
+
+class flow;
+
+namespace detail {
+
+class core;
+struct root_state;
+
+enum class wait_kind : uint8_t {
+    command,    /*!< Queued command */
+    prompt,     /*!< Queued command waiting for a prompt */
+    sleep,      /*!< Sleeping until a tick */
+};
+
+/**
+ * @brief Awaitable a flow is suspended on, linked into the lists of the executor
+ */
+struct waiter {
+    waiter(wait_kind wait) noexcept : kind(wait) {}
+
+    wait_kind kind;
+    esp_err_t err = ESP_OK;             /*!< Result passed to await_resume() */
+    std::coroutine_handle<> handle;     /*!< Suspended coroutine, a nested flow or the root */
+    root_state *root = nullptr;         /*!< Spawned flow the coroutine belongs to */
+    waiter *next = nullptr;
+};
+
+/**
+ * @brief Command or prompt awaitable
+ */
+struct command_waiter : waiter {
+    core *owner;
+    const char *data;                   /*!< Command, or data sent before the prompt */
+    size_t length;
+    const char *prompt;                 /*!< Expected prompt, NULL for a command */
+    uint32_t timeout_ms;
+};
+
+/**
+ * @brief Sleep awaitable
+ */
+struct sleep_waiter : waiter {
+    core *owner;
+    TickType_t wake;                    /*!< Tick to resume at */
+};
+
+/**
+ * @brief State of a spawned flow, shared by the nested flows it awaits
+ */
+struct root_state {
+    core *owner = nullptr;
+    flow_id id = 0;
+    esp_err_t cancel_err = ESP_OK;      /*!< Error of a cancelled flow, ESP_OK while running */
+    bool has_deadline = false;
+    TickType_t deadline = 0;            /*!< Cancel with ESP_ERR_TIMEOUT at this tick */
+    waiter *waiting = nullptr;          /*!< Awaitable the flow is suspended on */
+    done_cb_t done = nullptr;
+    void *ctx = nullptr;
+    std::coroutine_handle<> handle;     /*!< Frame of the spawned flow */
+    root_state *next = nullptr;         /*!< Live flows of the executor */
+};
+
+inline std::atomic<size_t> s_frames;
+inline std::atomic<size_t> s_frame_bytes;
+inline std::atomic<size_t> s_frame_peak;
+
+} // namespace detail
+
+/**
+ * @brief Coroutine type of a flow, co_return the esp_err_t result
+ *
+ * A flow starts suspended. Hand it to executor::spawn() or co_await it from
+ * another flow; otherwise destroying the flow object frees it unstarted.
+ */
+class flow {
+public:
+    struct promise_type;
+
+    struct final_awaiter {
+        bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept;
+        void await_resume() const noexcept {}
+    };
+
+    struct promise_type {
+        esp_err_t result = ESP_OK;
+        detail::root_state *root = nullptr;     /*!< Own state when spawned, the parent's when awaited */
+        std::coroutine_handle<> parent;         /*!< Flow awaiting this one, resumed when it finishes */
+        detail::root_state state;
+
+        static void *operator new(size_t size) noexcept
+        {
+            void *frame = ::operator new(size, std::nothrow);
+            if (frame) {
+                detail::s_frames++;
+                size_t bytes = detail::s_frame_bytes += size;
+                size_t peak = detail::s_frame_peak;
+                while (bytes > peak && !detail::s_frame_peak.compare_exchange_weak(peak, bytes)) {
+                }
+            }
+            return frame;
+        }
+        static void operator delete(void *frame, size_t size) noexcept
+        {
+            detail::s_frames--;
+            detail::s_frame_bytes -= size;
+            ::operator delete(frame);
+        }
+        static flow get_return_object_on_allocation_failure() noexcept { return flow(); }
+
+        flow get_return_object() noexcept { return flow(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        final_awaiter final_suspend() const noexcept { return {}; }
+        void return_value(esp_err_t err) noexcept { result = err; }
+        void unhandled_exception() noexcept { result = ESP_FAIL; }
+    };
+
+    flow() noexcept = default;
+    flow(flow &&other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    flow &operator=(flow &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+    flow(const flow &) = delete;
+    flow &operator=(const flow &) = delete;
+    ~flow() { reset(); }
+
+    /**
+     * @brief False if the frame could not be allocated
+     */
+    explicit operator bool() const noexcept { return static_cast<bool>(handle_); }
+
+    /**
+     * @brief Run as a nested flow, which shares the cancellation of the awaiting one
+     */
+    auto operator co_await() && noexcept
+    {
+        struct awaiter {
+            std::coroutine_handle<promise_type> child;
+            bool await_ready() const noexcept { return !child; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
+            {
+                child.promise().parent = h;
+                child.promise().root = h.promise().root;
+                return child;
+            }
+            esp_err_t await_resume() const noexcept { return child ? child.promise().result : ESP_ERR_NO_MEM; }
+        };
+        return awaiter{handle_};
+    }
+
+    /**
+     * @brief Coroutine frames of all flows, e.g. to compare with the task stacks they replace
+     */
+    static frame_stats stats() noexcept
+    {
+        return {detail::s_frames, detail::s_frame_bytes, detail::s_frame_peak};
+    }
+
+private:
+    friend class executor;
+
+    explicit flow(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle) {}
+
+    void reset() noexcept
+    {
+        if (auto handle = std::exchange(handle_, nullptr)) {
+            handle.destroy();
+        }
+    }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail {
+
+/**
+ * @brief Executor state, owned by executor and used by its task
+ */
+class core {
+public:
+    enum class request_kind : uint8_t { spawn, cancel, stop };
+
+    struct request {
+        request_kind kind;
+        flow_id id;
+        esp_err_t err;
+        root_state *root;
+    };
+
+    core(modem_dce_t *dce, const executor_config &config) noexcept : dce_(dce), config_(config) {}
+
+    ~core()
+    {
+        unregister_core(this);
+        if (queue_) {
+            vQueueDelete(queue_);
+        }
+        if (exit_sem_) {
+            vSemaphoreDelete(exit_sem_);
+        }
+        delete[] response_;
+    }
+
+    esp_err_t start() noexcept
+    {
+        response_ = new (std::nothrow) char[config_.response_size];
+        queue_ = xQueueCreate(config_.queue_size, sizeof(request));
+        exit_sem_ = xSemaphoreCreateBinary();
+        if (!response_ || !queue_ || !exit_sem_) {
+            return ESP_ERR_NO_MEM;
+        }
+        register_core(this);
+        if (xTaskCreate(task_entry, "modem_coro", config_.task_stack_size, this,
+                        config_.task_priority, &task_) != pdTRUE) {
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    }
+
+    void stop() noexcept
+    {
+        request stop_request = {request_kind::stop, 0, ESP_OK, nullptr};
+        xQueueSend(queue_, &stop_request, portMAX_DELAY);
+        xSemaphoreTake(exit_sem_, portMAX_DELAY);
+    }
+
+    esp_err_t post(const request &req) noexcept
+    {
+        /* Other tasks wait for room, the executor task itself must not */
+        TickType_t wait = xTaskGetCurrentTaskHandle() == task_ ? 0 : portMAX_DELAY;
+        return xQueueSend(queue_, &req, wait) == pdTRUE ? ESP_OK : ESP_ERR_NO_MEM;
+    }
+
+    flow_id next_id() noexcept { return ++last_id_; }
+
+    void enqueue(command_waiter *w) noexcept
+    {
+        w->next = nullptr;
+        if (commands_tail_) {
+            commands_tail_->next = w;
+        } else {
+            commands_ = w;
+        }
+        commands_tail_ = w;
+    }
+
+    void enqueue(sleep_waiter *w) noexcept
+    {
+        waiter **pos = &sleepers_;
+        while (*pos && (int32_t)(static_cast<sleep_waiter *>(*pos)->wake - w->wake) <= 0) {
+            pos = &(*pos)->next;
+        }
+        w->next = *pos;
+        *pos = w;
+    }
+
+    std::string_view response() const noexcept { return {response_, response_len_}; }
+
+    /**
+     * @brief Called from the final suspend point of a spawned flow
+     */
+    void finish(root_state *root, esp_err_t result) noexcept
+    {
+        for (root_state **pos = &live_; *pos; pos = &(*pos)->next) {
+            if (*pos == root) {
+                *pos = root->next;
+                break;
+            }
+        }
+        if (root->done) {
+            root->done(root->id, result, root->ctx);
+        }
+        /* Suspended at its final point, so the frame may go */
+        root->handle.destroy();
+    }
+
+private:
+    static void task_entry(void *arg)
+    {
+        core *self = static_cast<core *>(arg);
+        self->run();
+        xSemaphoreGive(self->exit_sem_);
+        vTaskDelete(NULL);
+    }
+
+    void run() noexcept
+    {
+        bool running = true;
+        while (running) {
+            request req;
+            TickType_t wait = commands_ ? 0 : next_timeout();
+            while (running && xQueueReceive(queue_, &req, wait) == pdTRUE) {
+                running = handle_request(req);
+                wait = 0;
+            }
+            if (!running) {
+                break;
+            }
+            expire();
+            if (command_waiter *w = static_cast<command_waiter *>(commands_)) {
+                commands_ = w->next;
+                if (!commands_) {
+                    commands_tail_ = nullptr;
+                }
+                w->err = execute(w);
+                resume(w);
+            }
+        }
+        /* Frames of nested flows are owned by their parents */
+        commands_ = commands_tail_ = sleepers_ = nullptr;
+        while (root_state *root = live_) {
+            live_ = root->next;
+            if (root->done) {
+                root->done(root->id, cancelled, root->ctx);
+            }
+            root->handle.destroy();
+        }
+    }
+
+    bool handle_request(const request &req) noexcept
+    {
+        switch (req.kind) {
+        case request_kind::spawn:
+            req.root->next = live_;
+            live_ = req.root;
+            req.root->handle.resume();
+            break;
+        case request_kind::cancel:
+            for (root_state *root = live_; root; root = root->next) {
+                if (root->id == req.id) {
+                    cancel(root, req.err);
+                    break;
+                }
+            }
+            break;
+        case request_kind::stop:
+            return false;
+        }
+        return true;
+    }
+
+    TickType_t next_timeout() const noexcept
+    {
+        TickType_t now = xTaskGetTickCount();
+        TickType_t wait = portMAX_DELAY;
+        auto earlier = [&](TickType_t tick) {
+            TickType_t left = (int32_t)(tick - now) > 0 ? tick - now : 0;
+            if (left < wait) {
+                wait = left;
+            }
+        };
+        if (sleepers_) {
+            earlier(static_cast<sleep_waiter *>(sleepers_)->wake);
+        }
+        for (root_state *root = live_; root; root = root->next) {
+            if (root->has_deadline) {
+                earlier(root->deadline);
+            }
+        }
+        return wait;
+    }
+
+    void expire() noexcept
+    {
+        TickType_t now = xTaskGetTickCount();
+        while (sleepers_ && (int32_t)(static_cast<sleep_waiter *>(sleepers_)->wake - now) <= 0) {
+            waiter *w = sleepers_;
+            sleepers_ = w->next;
+            resume(w);
+        }
+        /* A cancelled flow may finish and leave the list, so rescan after each one */
+        for (root_state *root = live_; root;) {
+            if (root->has_deadline && (int32_t)(root->deadline - now) <= 0) {
+                root->has_deadline = false;
+                cancel(root, ESP_ERR_TIMEOUT);
+                root = live_;
+            } else {
+                root = root->next;
+            }
+        }
+    }
+
+    void cancel(root_state *root, esp_err_t err) noexcept
+    {
+        if (root->cancel_err != ESP_OK) {
+            return;
+        }
+        root->cancel_err = err;
+        waiter *w = root->waiting;
+        if (w && (unlink(&sleepers_, w) || unlink(&commands_, w))) {
+            w->err = err;
+            resume(w);
+        }
+    }
+
+    bool unlink(waiter **list, waiter *w) noexcept
+    {
+        waiter *prev = nullptr;
+        for (waiter **pos = list; *pos; prev = *pos, pos = &(*pos)->next) {
+            if (*pos == w) {
+                *pos = w->next;
+                if (list == &commands_ && commands_tail_ == w) {
+                    commands_tail_ = prev;
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void resume(waiter *w) noexcept
+    {
+        w->root->waiting = nullptr;
+        w->handle.resume();
+    }
+
+    esp_err_t execute(command_waiter *w) noexcept
+    {
+        modem_dte_t *dte = dce_->dte;
+        response_len_ = 0;
+        response_[0] = '\0';
+        if (w->prompt) {
+            return dte->send_wait(dte, w->data, w->length, w->prompt, w->timeout_ms);
+        }
+        dce_->handle_line = handle_line;
+        if (dte->send_cmd(dte, w->data, w->timeout_ms) != ESP_OK) {
+            return dce_->state == MODEM_STATE_PROCESSING ? ESP_ERR_TIMEOUT : ESP_FAIL;
+        }
+        return dce_->state == MODEM_STATE_SUCCESS ? ESP_OK : ESP_FAIL;
+    }
+
+    /**
+     * @brief Collect the lines before the final result code of the running command, called from the DTE task
+     */
+    static esp_err_t handle_line(modem_dce_t *dce, const char *line)
+    {
+        core *self = find_core(dce);
+        if (!self) {
+            return ESP_FAIL;
+        }
+        if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+            return esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+        } else if (strstr(line, MODEM_RESULT_CODE_ERROR) || strstr(line, MODEM_RESULT_CODE_NO_CARRIER)) {
+            return esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+        }
+        size_t len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == '\n')) {
+            len--;
+        }
+        size_t used = self->response_len_ ? self->response_len_ + 1 : 0;
+        if (len > 0 && used + len < self->config_.response_size) {
+            if (used) {
+                self->response_[self->response_len_] = '\n';
+            }
+            memcpy(self->response_ + used, line, len);
+            self->response_len_ = used + len;
+            self->response_[self->response_len_] = '\0';
+        }
+        return ESP_OK;
+    }
+
+    static core *find_core(modem_dce_t *dce) noexcept
+    {
+        core *found = nullptr;
+        portENTER_CRITICAL(&s_cores_lock);
+        for (core *c = s_cores; c && !found; c = c->next_core_) {
+            if (c->dce_ == dce) {
+                found = c;
+            }
+        }
+        portEXIT_CRITICAL(&s_cores_lock);
+        return found;
+    }
+
+    static void register_core(core *c) noexcept
+    {
+        portENTER_CRITICAL(&s_cores_lock);
+        c->next_core_ = s_cores;
+        s_cores = c;
+        c->registered_ = true;
+        portEXIT_CRITICAL(&s_cores_lock);
+    }
+
+    static void unregister_core(core *c) noexcept
+    {
+        portENTER_CRITICAL(&s_cores_lock);
+        for (core **pos = &s_cores; c->registered_ && *pos; pos = &(*pos)->next_core_) {
+            if (*pos == c) {
+                *pos = c->next_core_;
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&s_cores_lock);
+    }
+
+    /* Line handlers get only the DCE, so executors are looked up by it */
+    static inline core *s_cores = nullptr;
+    static inline portMUX_TYPE s_cores_lock = portMUX_INITIALIZER_UNLOCKED;
+
+    modem_dce_t *dce_;
+    executor_config config_;
+    QueueHandle_t queue_ = nullptr;
+    SemaphoreHandle_t exit_sem_ = nullptr;
+    TaskHandle_t task_ = nullptr;
+    char *response_ = nullptr;
+    size_t response_len_ = 0;
+    waiter *commands_ = nullptr;            /*!< Commands in order of issue */
+    waiter *commands_tail_ = nullptr;
+    waiter *sleepers_ = nullptr;            /*!< Sleeps ordered by wake tick */
+    root_state *live_ = nullptr;            /*!< Spawned flows which have not finished */
+    std::atomic<flow_id> last_id_{0};
+    core *next_core_ = nullptr;
+    bool registered_ = false;
+};
+
+} // namespace detail
+
+inline std::coroutine_handle<> flow::final_awaiter::await_suspend(std::coroutine_handle<promise_type> h) noexcept
+{
+    promise_type &promise = h.promise();
+    if (promise.parent) {
+        return promise.parent;
+    }
+    promise.root->owner->finish(promise.root, promise.result);
+    return std::noop_coroutine();
+}
+
+/**
+ * @brief Awaitable command, resumes with the response lines before the final result code
+ *
+ * The view is valid until the flow awaits again.
+ */
+class command : detail::command_waiter {
+public:
+    command(detail::core *owner, const char *data, size_t length, const char *prompt, uint32_t timeout_ms) noexcept
+        : detail::command_waiter{{prompt ? detail::wait_kind::prompt : detail::wait_kind::command}, owner, data, length,
+                                 prompt, timeout_ms} {}
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<flow::promise_type> h) noexcept
+    {
+        root = h.promise().root;
+        if (root->cancel_err != ESP_OK) {
+            err = root->cancel_err;
+            return false;
+        }
+        handle = h;
+        root->waiting = this;
+        owner->enqueue(this);
+        return true;
+    }
+    result<std::string_view> await_resume() const noexcept
+    {
+        if (err != ESP_OK) {
+            return unexpected{err};
+        }
+        return owner->response();
+    }
+};
+
+/**
+ * @brief Awaitable sleep, resumes with ESP_OK or the error of a cancelled flow
+ */
+class sleep : detail::sleep_waiter {
+public:
+    sleep(detail::core *owner, uint32_t ms) noexcept
+        : detail::sleep_waiter{{detail::wait_kind::sleep}, owner, xTaskGetTickCount() + pdMS_TO_TICKS(ms)} {}
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<flow::promise_type> h) noexcept
+    {
+        root = h.promise().root;
+        if (root->cancel_err != ESP_OK) {
+            err = root->cancel_err;
+            return false;
+        }
+        handle = h;
+        root->waiting = this;
+        owner->enqueue(this);
+        return true;
+    }
+    esp_err_t await_resume() const noexcept { return err; }
+};
+
+/**
+ * @brief Owner of a modem executor and its task, the flows left are cancelled on destruction
+ */
+class executor {
+public:
+    executor() noexcept = default;
+    executor(executor &&other) noexcept : core_(std::exchange(other.core_, nullptr)) {}
+    executor &operator=(executor &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            core_ = std::exchange(other.core_, nullptr);
+        }
+        return *this;
+    }
+    executor(const executor &) = delete;
+    executor &operator=(const executor &) = delete;
+    ~executor() { reset(); }
+
+    static result<executor> create(dce &modem, const executor_config &config = {})
+    {
+        return create(modem.get(), config);
+    }
+
+    /**
+     * @brief Create an executor for a DCE owned elsewhere, e.g. by C code
+     */
+    static result<executor> create(modem_dce_t *modem, const executor_config &config = {})
+    {
+        executor created;
+        created.core_ = new (std::nothrow) detail::core(modem, config);
+        if (!created.core_) {
+            return unexpected{ESP_ERR_NO_MEM};
+        }
+        esp_err_t err = created.core_->start();
+        if (err != ESP_OK) {
+            delete std::exchange(created.core_, nullptr);
+            return unexpected{err};
+        }
+        return created;
+    }
+
+    explicit operator bool() const noexcept { return core_ != nullptr; }
+
+    /**
+     * @brief Stop the task, cancel the flows left and free the executor
+     *
+     * Must not be called from a flow.
+     */
+    void reset() noexcept
+    {
+        if (detail::core *old = std::exchange(core_, nullptr)) {
+            old->stop();
+            delete old;
+        }
+    }
+
+    /**
+     * @brief Start a flow on the executor task, may be called from any task
+     *
+     * @param f flow to run, owned by the executor from now on
+     * @param done called with the result of the flow, may be NULL
+     * @param ctx context pointer passed to done
+     * @param timeout_ms cancel the flow with ESP_ERR_TIMEOUT after this long, 0 for no limit
+     * @return identifier for cancel(), ESP_ERR_NO_MEM if the frame could not be allocated or, in a flow, the request queue is full
+     */
+    result<flow_id> spawn(flow &&f, done_cb_t done = nullptr, void *ctx = nullptr, uint32_t timeout_ms = 0)
+    {
+        if (!f) {
+            return unexpected{ESP_ERR_NO_MEM};
+        }
+        flow::promise_type &promise = f.handle_.promise();
+        detail::root_state &root = promise.state;
+        promise.root = &root;
+        root.owner = core_;
+        root.id = core_->next_id();
+        root.done = done;
+        root.ctx = ctx;
+        root.handle = f.handle_;
+        root.has_deadline = timeout_ms != 0;
+        root.deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+        esp_err_t err = core_->post({detail::core::request_kind::spawn, root.id, ESP_OK, &root});
+        if (err != ESP_OK) {
+            return unexpected{err};
+        }
+        f.handle_ = nullptr;
+        return root.id;
+    }
+
+    /**
+     * @brief Cancel a flow, may be called from any task
+     *
+     * A queued command or a sleep of the flow resumes with err at once, a command
+     * already sent finishes first. Later awaits of the flow fail with err.
+     */
+    result<void> cancel(flow_id id, esp_err_t err = cancelled)
+    {
+        return check(core_->post({detail::core::request_kind::cancel, id, err, nullptr}));
+    }
+
+    /**
+     * @brief Send a command, e.g. co_await modem.cmd("AT+CSQ\r")
+     *
+     * The command string has to stay valid until the flow resumes.
+     */
+    command cmd(const char *command_str, uint32_t timeout_ms = MODEM_COMMAND_TIMEOUT_DEFAULT) noexcept
+    {
+        return command(core_, command_str, strlen(command_str), nullptr, timeout_ms);
+    }
+
+    /**
+     * @brief Send data and wait for a prompt from the DCE (e.g. "\r\n> " after AT+CMGS), without CMUX only
+     */
+    command prompt(const char *data, const char *expected, uint32_t timeout_ms = MODEM_COMMAND_TIMEOUT_DEFAULT) noexcept
+    {
+        return command(core_, data, strlen(data), expected, timeout_ms);
+    }
+
+    /**
+     * @brief Suspend the flow without holding the executor
+     */
+    coro::sleep sleep(uint32_t ms) noexcept { return coro::sleep(core_, ms); }
+
+private:
+    detail::core *core_ = nullptr;
+};
+
+} // namespace esp_modem::coro
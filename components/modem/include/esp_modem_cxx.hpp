@@ -0,0 +1,364 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+/**
+ * @brief Move-only C++ handles owning the DTE, DCE and netif of the C API
+ *
+ * Everything is inline over the C functions. Destroy in reverse order of
+ * creation: netif, DCE, DTE. Declaring the handles in the order dte, dce,
+ * netif makes scope exit do that.
+ */
+
+#include <cassert>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include "esp_netif.h"
+#include "esp_modem.h"
+#include "esp_modem_netif.h"
+#include "sim800.h"
+#include "bg96.h"
+#include "sim7600.h"
+
+namespace esp_modem {
+
+/**
+ * @brief Error of a result, in the style of std::unexpected
+ */
+struct unexpected {
+    esp_err_t code;     /*!< ESP error code, never ESP_OK */
+};
+
+/**
+ * @brief Value or error code, in the style of std::expected
+ */
+template <typename T>
+class result {
+public:
+    result(T value) : value_(std::move(value)) {}
+    result(unexpected err) : error_(err.code) {}
+
+    bool has_value() const noexcept { return value_.has_value(); }
+    explicit operator bool() const noexcept { return has_value(); }
+    esp_err_t error() const noexcept { return error_; }
+    /* Only valid with a value, check has_value() first */
+    T &value() & { assert(value_); return *value_; }
+    T &&value() && { assert(value_); return std::move(*value_); }
+    T &operator*() & { assert(value_); return *value_; }
+    T &&operator*() && { assert(value_); return std::move(*value_); }
+    T *operator->() { assert(value_); return &*value_; }
+    template <typename U>
+    T value_or(U &&other) const & { return value_ ? *value_ : static_cast<T>(std::forward<U>(other)); }
+
+private:
+    std::optional<T> value_;
+    esp_err_t error_ = ESP_OK;
+};
+
+/**
+ * @brief Success or error code
+ */
+template <>
+class result<void> {
+public:
+    result() = default;
+    result(unexpected err) : error_(err.code) {}
+
+    bool has_value() const noexcept { return error_ == ESP_OK; }
+    explicit operator bool() const noexcept { return has_value(); }
+    esp_err_t error() const noexcept { return error_; }
+
+private:
+    esp_err_t error_ = ESP_OK;
+};
+
+/**
+ * @brief Result of a C call returning esp_err_t
+ */
+inline result<void> check(esp_err_t err)
+{
+    if (err != ESP_OK) {
+        return unexpected{err};
+    }
+    return {};
+}
+
+/**
+ * @brief Owner of a DTE, deinitialized on destruction
+ */
+class dte {
+public:
+    dte() noexcept = default;
+    explicit dte(modem_dte_t *handle) noexcept : handle_(handle) {}
+    dte(dte &&other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    dte &operator=(dte &&other) noexcept
+    {
+        if (this != &other) {
+            reset(std::exchange(other.handle_, nullptr));
+        }
+        return *this;
+    }
+    dte(const dte &) = delete;
+    dte &operator=(const dte &) = delete;
+    ~dte() { reset(); }
+
+    static result<dte> create(const esp_modem_dte_config_t &config)
+    {
+        modem_dte_t *handle = esp_modem_dte_init(&config);
+        if (!handle) {
+            return unexpected{ESP_FAIL};
+        }
+        return dte(handle);
+    }
+
+    modem_dte_t *get() const noexcept { return handle_; }
+    explicit operator bool() const noexcept { return handle_ != nullptr; }
+    modem_dte_t *release() noexcept { return std::exchange(handle_, nullptr); }
+    void reset(modem_dte_t *handle = nullptr) noexcept
+    {
+        if (modem_dte_t *old = std::exchange(handle_, handle)) {
+            old->deinit(old);
+        }
+    }
+
+    result<void> start_ppp() { return check(esp_modem_start_ppp(handle_)); }
+    result<void> stop_ppp() { return check(esp_modem_stop_ppp(handle_)); }
+    result<void> send_cmd(const char *command, uint32_t timeout_ms)
+    {
+        return check(handle_->send_cmd(handle_, command, timeout_ms));
+    }
+
+private:
+    modem_dte_t *handle_ = nullptr;
+};
+
+/**
+ * @brief Owner of a DCE, deinitialized on destruction
+ */
+class dce {
+public:
+    /**
+     * @brief Signal quality reported by the DCE
+     */
+    struct signal_quality {
+        uint32_t rssi;      /*!< Received signal strength indication */
+        uint32_t ber;       /*!< Bit error rate */
+    };
+
+    /**
+     * @brief Battery status reported by the DCE
+     */
+    struct battery_status {
+        uint32_t bcs;       /*!< Charge status */
+        uint32_t bcl;       /*!< Charge level, percent */
+        uint32_t voltage;   /*!< Voltage, mV */
+    };
+
+    dce() noexcept = default;
+    explicit dce(modem_dce_t *handle) noexcept : handle_(handle) {}
+    dce(dce &&other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    dce &operator=(dce &&other) noexcept
+    {
+        if (this != &other) {
+            reset(std::exchange(other.handle_, nullptr));
+        }
+        return *this;
+    }
+    dce(const dce &) = delete;
+    dce &operator=(const dce &) = delete;
+    ~dce() { reset(); }
+
+    /**
+     * @brief Create a DCE with one of the device init functions (sim800_init, bg96_init, sim7600_init)
+     */
+    template <modem_dce_t *(*Init)(modem_dte_t *)>
+    static result<dce> create(dte &owner)
+    {
+        modem_dce_t *handle = Init(owner.get());
+        if (!handle) {
+            return unexpected{ESP_FAIL};
+        }
+        return dce(handle);
+    }
+    static result<dce> sim800(dte &owner) { return create<sim800_init>(owner); }
+    static result<dce> bg96(dte &owner) { return create<bg96_init>(owner); }
+    static result<dce> sim7600(dte &owner) { return create<sim7600_init>(owner); }
+
+    modem_dce_t *get() const noexcept { return handle_; }
+    explicit operator bool() const noexcept { return handle_ != nullptr; }
+    modem_dce_t *release() noexcept { return std::exchange(handle_, nullptr); }
+    void reset(modem_dce_t *handle = nullptr) noexcept
+    {
+        if (modem_dce_t *old = std::exchange(handle_, handle)) {
+            old->deinit(old);
+        }
+    }
+
+    /* Views into the DCE, valid while it lives */
+    std::string_view name() const { return handle_->name; }
+    std::string_view oper() const { return handle_->oper; }
+    std::string_view imei() const { return handle_->imei; }
+    std::string_view imsi() const { return handle_->imsi; }
+
+    result<void> sync() { return check(handle_->sync(handle_)); }
+    result<void> echo_mode(bool on) { return check(handle_->echo_mode(handle_, on)); }
+    result<void> store_profile() { return check(handle_->store_profile(handle_)); }
+    result<void> set_flow_ctrl(modem_flow_ctrl_t flow_ctrl) { return check(handle_->set_flow_ctrl(handle_, flow_ctrl)); }
+    result<void> define_pdp_context(uint32_t cid, const char *type, const char *apn)
+    {
+        return check(handle_->define_pdp_context(handle_, cid, type, apn));
+    }
+    result<void> hang_up() { return check(handle_->hang_up(handle_)); }
+    result<void> power_down() { return check(handle_->power_down(handle_)); }
+    result<signal_quality> get_signal_quality()
+    {
+        signal_quality quality{};
+        esp_err_t err = handle_->get_signal_quality(handle_, &quality.rssi, &quality.ber);
+        if (err != ESP_OK) {
+            return unexpected{err};
+        }
+        return quality;
+    }
+    result<battery_status> get_battery_status()
+    {
+        battery_status status{};
+        esp_err_t err = handle_->get_battery_status(handle_, &status.bcs, &status.bcl, &status.voltage);
+        if (err != ESP_OK) {
+            return unexpected{err};
+        }
+        return status;
+    }
+
+private:
+    modem_dce_t *handle_ = nullptr;
+};
+
+/**
+ * @brief Owner of an esp-netif instance and its modem adapter with the default handlers
+ */
+class netif {
+public:
+    netif() noexcept = default;
+    netif(netif &&other) noexcept
+        : esp_netif_(std::exchange(other.esp_netif_, nullptr)), adapter_(std::exchange(other.adapter_, nullptr)) {}
+    netif &operator=(netif &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            esp_netif_ = std::exchange(other.esp_netif_, nullptr);
+            adapter_ = std::exchange(other.adapter_, nullptr);
+        }
+        return *this;
+    }
+    netif(const netif &) = delete;
+    netif &operator=(const netif &) = delete;
+    ~netif() { reset(); }
+
+    /**
+     * @brief Create the esp-netif instance and the modem adapter, and set the default handlers
+     */
+    static result<netif> create(dte &owner, const esp_netif_config_t &config)
+    {
+        netif created;
+        created.esp_netif_ = esp_netif_new(&config);
+        if (!created.esp_netif_) {
+            return unexpected{ESP_ERR_NO_MEM};
+        }
+        created.adapter_ = esp_modem_netif_setup(owner.get());
+        if (!created.adapter_) {
+            return unexpected{ESP_ERR_NO_MEM};
+        }
+        esp_err_t err = esp_modem_netif_set_default_handlers(created.adapter_, created.esp_netif_);
+        if (err != ESP_OK) {
+            return unexpected{err};
+        }
+        return created;
+    }
+
+    esp_netif_t *get() const noexcept { return esp_netif_; }
+    void *adapter() const noexcept { return adapter_; }
+    explicit operator bool() const noexcept { return adapter_ != nullptr; }
+
+    /**
+     * @brief Attach the adapter to the esp-netif instance, which starts PPP
+     */
+    result<void> attach() { return check(esp_netif_attach(esp_netif_, adapter_)); }
+
+    void reset() noexcept
+    {
+        if (void *adapter = std::exchange(adapter_, nullptr)) {
+            esp_modem_netif_clear_default_handlers(adapter);
+            esp_modem_netif_teardown(adapter);
+        }
+        if (esp_netif_t *instance = std::exchange(esp_netif_, nullptr)) {
+            esp_netif_destroy(instance);
+        }
+    }
+
+private:
+    esp_netif_t *esp_netif_ = nullptr;
+    void *adapter_ = nullptr;
+};
+
+/**
+ * @brief Registration of a modem event handler, removed on destruction
+ */
+class event_subscription {
+public:
+    event_subscription() noexcept = default;
+    event_subscription(event_subscription &&other) noexcept
+        : dte_(std::exchange(other.dte_, nullptr)), handler_(std::exchange(other.handler_, nullptr)),
+          event_id_(other.event_id_) {}
+    event_subscription &operator=(event_subscription &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            dte_ = std::exchange(other.dte_, nullptr);
+            handler_ = std::exchange(other.handler_, nullptr);
+            event_id_ = other.event_id_;
+        }
+        return *this;
+    }
+    event_subscription(const event_subscription &) = delete;
+    event_subscription &operator=(const event_subscription &) = delete;
+    ~event_subscription() { reset(); }
+
+    static result<event_subscription> create(dte &owner, esp_event_handler_t handler, int32_t event_id, void *handler_args)
+    {
+        esp_err_t err = esp_modem_set_event_handler(owner.get(), handler, event_id, handler_args);
+        if (err != ESP_OK) {
+            return unexpected{err};
+        }
+        event_subscription subscription;
+        subscription.dte_ = owner.get();
+        subscription.handler_ = handler;
+        subscription.event_id_ = event_id;
+        return subscription;
+    }
+
+    void reset() noexcept
+    {
+        if (esp_event_handler_t handler = std::exchange(handler_, nullptr)) {
+            esp_modem_remove_event_handler_id(std::exchange(dte_, nullptr), handler, event_id_);
+        }
+    }
+
+private:
+    modem_dte_t *dte_ = nullptr;
+    esp_event_handler_t handler_ = nullptr;
+    int32_t event_id_ = ESP_EVENT_ANY_ID;
+};
+
+} // namespace esp_modem
@@ -46,6 +46,12 @@ typedef struct modem_dte modem_dte_t;
 #define MODEM_IMEI_LENGTH (15)         /*!< IMEI Number Length */
 #define MODEM_IMSI_LENGTH (15)         /*!< IMSI Number Length */
 
+/**
+ * @brief RSSI value reported by AT+CSQ when the signal is not known or not detectable
+ *
+ */
+#define ESP_MODEM_RSSI_UNKNOWN (99)
+
 /**
  * @brief Specific Timeout Constraint, Unit: millisecond
  *
@@ -55,6 +61,7 @@ typedef struct modem_dte modem_dte_t;
 #define MODEM_COMMAND_TIMEOUT_MODE_CHANGE (5000) /*!< Timeout value for changing working mode */
 #define MODEM_COMMAND_TIMEOUT_HANG_UP (90000)    /*!< Timeout value for hang up */
 #define MODEM_COMMAND_TIMEOUT_POWEROFF (1000)    /*!< Timeout value for power down */
+#define MODEM_COMMAND_TIMEOUT_DNS (60000)        /*!< Timeout value for a modem-native DNS lookup */
 
 /**
  * @brief Working state of DCE
@@ -66,6 +73,18 @@ typedef enum {
     MODEM_STATE_FAIL        /*!< Process failed */
 } modem_state_t;
 
+/**
+ * @brief Result of a modem-native ping
+ *
+ */
+typedef struct {
+    uint32_t sent;          /*!< Echo requests sent */
+    uint32_t received;      /*!< Echo replies received */
+    uint32_t rtt_min_ms;    /*!< Minimum round trip time */
+    uint32_t rtt_avg_ms;    /*!< Average round trip time */
+    uint32_t rtt_max_ms;    /*!< Maximum round trip time */
+} modem_ping_stats_t;
+
 /* CRC8 is the reflected CRC8/ROHC algorithm */
 #define FCS_POLYNOMIAL 0xe0 /* reversed crc8 */
 #define FCS_INIT_VALUE 0xFF
@@ -131,6 +150,10 @@ struct modem_dce {
     esp_err_t (*power_down)(modem_dce_t *dce);                          /*!< Normal power down */
     esp_err_t (*deinit)(modem_dce_t *dce);                              /*!< Deinitialize */
     esp_err_t (*setup_cmux)(modem_dce_t *dce);                              /*!< Setup CMUX */
+    esp_err_t (*ping)(modem_dce_t *dce, const char *host, uint32_t count,
+                      uint32_t timeout_ms, modem_ping_stats_t *stats);  /*!< Ping from the modem's own IP stack */
+    esp_err_t (*resolve)(modem_dce_t *dce, const char *host,
+                         char *ip, size_t ip_len);                      /*!< DNS lookup from the modem's own IP stack */
 };
 
 #ifdef __cplusplus
@@ -17,6 +17,127 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Number of traffic classes accounted by the modem netif
+ *
+ */
+#define ESP_MODEM_NETIF_TRAFFIC_CLASSES (8)
+
+/**
+ * @brief Flow of one IPv4 packet passing through the modem netif
+ *
+ */
+typedef struct {
+    uint8_t protocol;           /*!< IP protocol (6 TCP, 17 UDP, ...), 0 for non-IP PPP frames */
+    uint32_t local_addr;        /*!< Local IPv4 address (network byte order) */
+    uint32_t remote_addr;       /*!< Remote IPv4 address (network byte order) */
+    uint16_t local_port;        /*!< Local TCP/UDP port, 0 if not applicable */
+    uint16_t remote_port;       /*!< Remote TCP/UDP port, 0 if not applicable */
+} esp_modem_flow_t;
+
+/**
+ * @brief Classification rule, the first matching rule gives the traffic class
+ *
+ */
+typedef struct {
+    uint8_t protocol;           /*!< IP protocol to match, 0 for any */
+    uint32_t remote_addr;       /*!< Remote IPv4 address (network byte order) */
+    uint32_t remote_mask;       /*!< Mask applied to remote_addr, 0 for any */
+    uint16_t remote_port_min;   /*!< Remote port range, 0..0 for any */
+    uint16_t remote_port_max;
+    uint16_t local_port_min;    /*!< Local port range, 0..0 for any */
+    uint16_t local_port_max;
+    uint8_t traffic_class;      /*!< Class assigned to matching packets */
+} esp_modem_traffic_rule_t;
+
+/**
+ * @brief Custom classifier (e.g. mapping local ports to owner tags), overrides the rules
+ *
+ * @param flow decoded flow of the packet
+ * @param tx true for outgoing packets
+ * @param ctx user context
+ * @return traffic class of the packet
+ */
+typedef uint8_t (*esp_modem_traffic_classifier_t)(const esp_modem_flow_t *flow, bool tx, void *ctx);
+
+/**
+ * @brief Limits of one traffic class, enforced on outgoing IP packets before they reach the DTE
+ *
+ */
+typedef struct {
+    uint32_t rate_bytes_per_sec;    /*!< Token bucket rate, 0 for unlimited */
+    uint32_t burst_bytes;           /*!< Token bucket depth, at least one packet (e.g. the MTU) when rate limited */
+    uint64_t monthly_quota_bytes;   /*!< TX + RX bytes allowed per calendar month, 0 for unlimited */
+} esp_modem_traffic_limit_t;
+
+/**
+ * @brief Traffic accounting configuration
+ *
+ */
+typedef struct {
+    const esp_modem_traffic_rule_t *rules;          /*!< Classification rules, referenced and not copied */
+    size_t rule_count;                              /*!< Number of rules */
+    esp_modem_traffic_classifier_t classifier;      /*!< Custom classifier, NULL to use the rules */
+    void *classifier_ctx;                           /*!< Context of the custom classifier */
+    esp_modem_traffic_limit_t limits[ESP_MODEM_NETIF_TRAFFIC_CLASSES]; /*!< Per-class limits */
+    uint32_t persist_interval_ms;                   /*!< Period of saving counters to NVS, 0 to disable */
+} esp_modem_traffic_config_t;
+
+/**
+ * @brief Counters of one traffic class
+ *
+ */
+typedef struct {
+    uint64_t tx_bytes;          /*!< Bytes sent since counters were created */
+    uint64_t rx_bytes;          /*!< Bytes received since counters were created */
+    uint32_t tx_packets;        /*!< Packets sent */
+    uint32_t rx_packets;        /*!< Packets received */
+    uint32_t tx_rate_drops;     /*!< Packets dropped by the rate limit */
+    uint32_t tx_quota_drops;    /*!< Packets dropped by the monthly quota */
+    uint64_t period_bytes;      /*!< TX + RX bytes in the current month */
+} esp_modem_traffic_counters_t;
+
+/**
+ * @brief Dial on demand configuration
+ *
+ */
+typedef struct {
+    uint32_t idle_timeout_ms;       /*!< Drop the call after this long without IP packets, LCP/IPCP frames do not count */
+    uint32_t connect_timeout_ms;    /*!< Give up a dial which did not get an IP address in time */
+    size_t queue_size;              /*!< Bytes of outgoing packets held while dialing */
+    uint32_t task_stack_size;       /*!< Stack size of the task which dials and hangs up */
+    int task_priority;              /*!< Priority of the task which dials and hangs up */
+} esp_modem_demand_config_t;
+
+/**
+ * @brief Dial on demand default configuration
+ *
+ */
+#define ESP_MODEM_DEMAND_DEFAULT_CONFIG()   \
+    {                                       \
+        .idle_timeout_ms = 60000,           \
+        .connect_timeout_ms = 60000,        \
+        .queue_size = 4096,                 \
+        .task_stack_size = 3072,            \
+        .task_priority = 5,                 \
+    }
+
+/**
+ * @brief Dial on demand metrics
+ *
+ */
+typedef struct {
+    uint32_t sessions;          /*!< Sessions which got an IP address, the first one included */
+    uint32_t dial_failures;     /*!< Dials which failed or timed out */
+    uint32_t hang_up_failures;  /*!< Calls which could not be dropped, retried at the next check */
+    uint32_t last_setup_ms;     /*!< Time from the first packet to the IP address, last session */
+    uint32_t max_setup_ms;      /*!< Longest setup */
+    uint64_t total_setup_ms;    /*!< Sum of all setup times, divide by sessions for the average */
+    uint64_t connected_ms;      /*!< Time with an IP address, current session included */
+    uint32_t queued_packets;    /*!< Packets held while dialing and sent afterwards */
+    uint32_t queue_drops;       /*!< Packets dropped because the queue was full or the dial failed */
+} esp_modem_demand_stats_t;
+
 /**
  * @brief Creates handle to esp_modem used as an esp-netif driver
  *
@@ -48,6 +169,86 @@ esp_err_t esp_modem_netif_clear_default_handlers(void *h);
  */
 esp_err_t esp_modem_netif_set_default_handlers(void *h, esp_netif_t * esp_netif);
 
+/**
+ * @brief Enable per-class traffic accounting and limits on the modem netif
+ *
+ * Counters are restored from NVS when persisting is enabled, so nvs_flash_init()
+ * has to be called before.
+ *
+ * @param h pointer to the esp-netif adapter for esp-modem
+ * @note The rules array and classifier_ctx are referenced, not copied. They must outlive the configuration:
+ *       a packet being classified when a new configuration is set may still use the previous ones, so keep
+ *       them valid for as long as the modem netif is running.
+ *
+ * @param config traffic configuration
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if a class has a rate limit and no burst
+ *      - ESP_ERR_NO_MEM on allocation failure
+ */
+esp_err_t esp_modem_netif_set_traffic_config(void *h, const esp_modem_traffic_config_t *config);
+
+/**
+ * @brief Get counters of one traffic class
+ *
+ * @param h pointer to the esp-netif adapter for esp-modem
+ * @param traffic_class class to report
+ * @param counters output counters
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid class
+ *      - ESP_ERR_INVALID_STATE if accounting is not enabled
+ */
+esp_err_t esp_modem_netif_get_traffic_counters(void *h, uint8_t traffic_class, esp_modem_traffic_counters_t *counters);
+
+/**
+ * @brief Save traffic counters to NVS now
+ *
+ * @param h pointer to the esp-netif adapter for esp-modem
+ * @return ESP_OK on success, NVS error code otherwise
+ */
+esp_err_t esp_modem_netif_save_traffic_counters(void *h);
+
+/**
+ * @brief Start a new quota period, e.g. on billing date when it does not match the calendar month
+ *
+ * @param h pointer to the esp-netif adapter for esp-modem
+ * @return ESP_OK on success
+ */
+esp_err_t esp_modem_netif_reset_traffic_period(void *h);
+
+/**
+ * @brief Enable dial on demand
+ *
+ * The first session is dialed on attach as usual. After idle_timeout_ms without
+ * IP packets the call is dropped with esp_modem_suspend_ppp() while the PPP
+ * interface stays up; the next outgoing IP packet is queued and dials again with
+ * esp_modem_resume_ppp(). Queued packets are sent once the renegotiated session
+ * got its IP address. Has to be called before esp_netif_attach().
+ *
+ * @param h pointer to the esp-netif adapter for esp-modem
+ * @param config dial on demand configuration
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on zero idle timeout or queue size
+ *      - ESP_ERR_INVALID_STATE if already enabled
+ *      - ESP_ERR_NO_MEM on allocation failure
+ *      - ESP_FAIL if the task, timer or event handler could not be created
+ */
+esp_err_t esp_modem_netif_set_demand_config(void *h, const esp_modem_demand_config_t *config);
+
+/**
+ * @brief Get dial on demand metrics
+ *
+ * @param h pointer to the esp-netif adapter for esp-modem
+ * @param stats output metrics
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on NULL stats
+ *      - ESP_ERR_INVALID_STATE if dial on demand is not enabled
+ */
+esp_err_t esp_modem_netif_get_demand_stats(void *h, esp_modem_demand_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,140 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_types.h"
+#include "esp_err.h"
+
+/**
+ * @brief Persistent store-and-forward outbox
+ *
+ * Outgoing payloads are appended to a ring in a dedicated data partition and
+ * sent in batches, so that the radio connects once per batch instead of once
+ * per message.
+ */
+typedef struct esp_modem_outbox esp_modem_outbox_t;
+
+/**
+ * @brief Outbox Configuration
+ *
+ */
+typedef struct {
+    const char *partition_label;                            /*!< Label of the data partition holding the ring */
+    size_t max_message_size;                                /*!< Largest payload accepted by esp_modem_outbox_put() */
+    size_t flush_size_threshold;                            /*!< Start a session when this many bytes are pending */
+    uint32_t flush_max_age_ms;                              /*!< Start a session when the oldest message is this old */
+    bool flush_on_ppp_up;                                   /*!< Piggyback pending messages when PPP comes up for other reasons */
+    bool drop_oldest_when_full;                             /*!< Erase the oldest messages instead of rejecting new ones */
+    esp_err_t (*session_open)(void *ctx);                   /*!< Bring the link up, called only if PPP is not already up */
+    esp_err_t (*send)(const void *data, size_t len, void *ctx); /*!< Send one payload */
+    void (*session_close)(void *ctx);                       /*!< Release the link opened by session_open */
+    void *ctx;                                              /*!< Context passed to the callbacks */
+    uint32_t task_stack_size;                               /*!< Outbox task stack size */
+    int task_priority;                                      /*!< Outbox task priority */
+    uint32_t buffer_caps;                                   /*!< Heap capabilities of the message buffer, 0 for the default heap */
+} esp_modem_outbox_config_t;
+
+/**
+ * @brief Outbox statistics
+ *
+ */
+typedef struct {
+    uint32_t pending_messages;      /*!< Messages waiting in flash */
+    uint32_t pending_bytes;         /*!< Payload bytes waiting in flash */
+    uint32_t sessions;              /*!< Radio sessions which sent at least one message */
+    uint32_t sent_messages;         /*!< Messages sent */
+    uint64_t sent_bytes;            /*!< Payload bytes sent */
+    uint32_t dropped_messages;      /*!< Messages lost because the ring was full or corrupted */
+    uint32_t last_batch_messages;   /*!< Messages sent in the last session */
+    uint32_t last_batch_bytes;      /*!< Bytes sent in the last session */
+    uint32_t max_batch_messages;    /*!< Largest batch sent in one session */
+} esp_modem_outbox_stats_t;
+
+/**
+ * @brief Outbox Default Configuration
+ *
+ */
+#define ESP_MODEM_OUTBOX_DEFAULT_CONFIG()       \
+    {                                           \
+        .partition_label = "outbox",            \
+        .max_message_size = 1024,               \
+        .flush_size_threshold = 4096,           \
+        .flush_max_age_ms = 15 * 60 * 1000,     \
+        .flush_on_ppp_up = true,                \
+        .drop_oldest_when_full = false,         \
+        .session_open = NULL,                   \
+        .send = NULL,                           \
+        .session_close = NULL,                  \
+        .ctx = NULL,                            \
+        .task_stack_size = 4096,                \
+        .task_priority = 5,                     \
+        .buffer_caps = 0,                       \
+    }
+
+/**
+ * @brief Create the outbox, recover messages left in flash and start its task
+ *
+ * @param config outbox configuration
+ * @return esp_modem_outbox_t*
+ *      - Outbox object on success
+ *      - NULL on error
+ */
+esp_modem_outbox_t *esp_modem_outbox_create(const esp_modem_outbox_config_t *config);
+
+/**
+ * @brief Append one payload to the outbox
+ *
+ * @param outbox outbox object
+ * @param data payload
+ * @param len payload length
+ * @return esp_err_t
+ *      - ESP_OK on success, the payload is in flash
+ *      - ESP_ERR_INVALID_SIZE if the payload is larger than max_message_size
+ *      - ESP_ERR_NO_MEM if the ring is full
+ *      - flash error code otherwise
+ */
+esp_err_t esp_modem_outbox_put(esp_modem_outbox_t *outbox, const void *data, size_t len);
+
+/**
+ * @brief Request a session now, regardless of the thresholds
+ *
+ * @param outbox outbox object
+ * @return ESP_OK on success
+ */
+esp_err_t esp_modem_outbox_flush(esp_modem_outbox_t *outbox);
+
+/**
+ * @brief Get outbox statistics
+ *
+ * @param outbox outbox object
+ * @param stats output statistics
+ * @return ESP_OK on success
+ */
+esp_err_t esp_modem_outbox_get_stats(esp_modem_outbox_t *outbox, esp_modem_outbox_stats_t *stats);
+
+/**
+ * @brief Stop the outbox task and free the outbox, pending messages stay in flash
+ *
+ * @param outbox outbox object
+ * @return ESP_OK on success
+ */
+esp_err_t esp_modem_outbox_destroy(esp_modem_outbox_t *outbox);
+
+#ifdef __cplusplus
+}
+#endif
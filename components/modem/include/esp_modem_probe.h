@@ -0,0 +1,118 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_modem_dce.h"
+
+/**
+ * @brief Max length of a resolved IP address string
+ *
+ */
+#define ESP_MODEM_PROBE_IP_LENGTH (46)
+
+/**
+ * @brief Verdict of a connectivity probe, used to pick the recovery step
+ *
+ */
+typedef enum {
+    ESP_MODEM_PROBE_NETWORK_OK = 0,     /*!< The modem reaches the network, a dead data path means only PPP needs restarting */
+    ESP_MODEM_PROBE_NO_DATA,            /*!< Signal present but the host is unreachable, re-attach the packet data context */
+    ESP_MODEM_PROBE_NO_SIGNAL,          /*!< No signal, wait for coverage */
+    ESP_MODEM_PROBE_NO_RESPONSE         /*!< The modem does not answer commands, restart the modem */
+} esp_modem_probe_verdict_t;
+
+/**
+ * @brief Connectivity Probe Configuration
+ *
+ */
+typedef struct {
+    const char *host;               /*!< Host to resolve and ping */
+    uint32_t count;                 /*!< Number of echo requests */
+    uint32_t timeout_ms;            /*!< Timeout of one echo request */
+    uint32_t max_loss_percent;      /*!< Highest packet loss still considered a working network */
+    bool resolve;                   /*!< Resolve the host with the modem's DNS before pinging */
+} esp_modem_probe_config_t;
+
+/**
+ * @brief Connectivity Probe Result
+ *
+ */
+typedef struct {
+    esp_modem_probe_verdict_t verdict;      /*!< Verdict */
+    uint32_t rssi;                          /*!< Signal quality at the time of the probe (AT+CSQ units) */
+    bool resolved;                          /*!< The host name was resolved */
+    char ip[ESP_MODEM_PROBE_IP_LENGTH];     /*!< Resolved address */
+    uint32_t resolve_ms;                    /*!< Time taken by the DNS lookup */
+    modem_ping_stats_t ping;                /*!< Ping statistics */
+    uint32_t loss_percent;                  /*!< Packet loss */
+} esp_modem_probe_result_t;
+
+/**
+ * @brief Connectivity Probe Default Configuration
+ *
+ */
+#define ESP_MODEM_PROBE_DEFAULT_CONFIG()        \
+    {                                           \
+        .host = "8.8.8.8",                      \
+        .count = 3,                             \
+        .timeout_ms = 4000,                     \
+        .max_loss_percent = 50,                 \
+        .resolve = false,                       \
+    }
+
+/**
+ * @brief Probe connectivity with the modem's own ping and DNS
+ *
+ * The commands go to the command channel, so with CMUX the PPP session on the
+ * data channel stays up and lwIP is not involved.
+ *
+ * @param dce Modem DCE object
+ * @param config probe configuration
+ * @param result probe result, the verdict is valid whenever ESP_OK is returned
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_SUPPORTED if the DCE has no native ping
+ *      - ESP_ERR_INVALID_STATE if PPP owns the only channel (CMUX not used)
+ */
+esp_err_t esp_modem_probe_run(modem_dce_t *dce, const esp_modem_probe_config_t *config, esp_modem_probe_result_t *result);
+
+/**
+ * @brief Take the recovery step of a probe verdict
+ *
+ * Network OK restarts only PPP, no data detaches and re-attaches the packet
+ * data service (AT+CGATT) before dialing again, no signal does nothing. In
+ * these cases the PPP session of the network interface survives and
+ * renegotiates, as with esp_modem_suspend_ppp() and esp_modem_resume_ppp().
+ * When the modem does not respond, esp_modem_dte_reset() stops the PPP session,
+ * then CMUX is started again if used and the call is dialed with
+ * esp_modem_start_ppp(); if the modem still does not answer, the caller has to
+ * power cycle it.
+ *
+ * @param dce Modem DCE object
+ * @param result result of esp_modem_probe_run()
+ * @return esp_err_t
+ *      - ESP_OK on success, also when there is nothing to do
+ *      - ESP_ERR_INVALID_STATE if not in PPP mode
+ *      - ESP_ERR_TIMEOUT if the modem did not respond after the DTE reset
+ *      - ESP_FAIL if the data call could not be restored
+ */
+esp_err_t esp_modem_probe_recover(modem_dce_t *dce, const esp_modem_probe_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,164 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_modem_dce.h"
+
+/**
+ * @brief Number of transfer classes tracked by the scheduler statistics
+ *
+ */
+#define ESP_MODEM_SCHEDULER_MAX_CLASSES (4)
+
+/**
+ * @brief Link-quality-aware transmission scheduler
+ *
+ */
+typedef struct esp_modem_scheduler esp_modem_scheduler_t;
+
+/**
+ * @brief Callback which performs a deferred transfer
+ *
+ * Called from the scheduler task once the transfer is released.
+ *
+ * @param rssi signal quality (AT+CSQ units) at the time of release
+ * @param ctx context pointer passed to esp_modem_scheduler_submit()
+ */
+typedef void (*esp_modem_transfer_cb_t)(uint32_t rssi, void *ctx);
+
+/**
+ * @brief Scheduler Configuration
+ *
+ */
+typedef struct {
+    uint32_t rssi_threshold;        /*!< Release transfers at or above this AT+CSQ rssi (dBm = -113 + 2 * rssi) */
+    uint32_t deadline_margin_ms;    /*!< Release transfers when their deadline is closer than this, whatever the signal */
+    uint32_t sample_interval_ms;    /*!< Max age of the signal sample before esp_modem_scheduler_sample_signal() issues AT+CSQ, 0 to rely on esp_modem_scheduler_update_signal() only */
+    uint32_t nominal_ms_per_kib;    /*!< Airtime of 1 KiB at good signal, used for the savings estimate */
+    uint32_t active_current_ma;     /*!< Modem current while transferring, used for the savings estimate */
+    int max_transfers;              /*!< Max number of pending transfers */
+    uint32_t task_stack_size;       /*!< Scheduler task stack size */
+    int task_priority;              /*!< Scheduler task priority */
+} esp_modem_scheduler_config_t;
+
+/**
+ * @brief Per-class scheduler statistics
+ *
+ */
+typedef struct {
+    uint32_t released;              /*!< Transfers released */
+    uint32_t released_on_signal;    /*!< Transfers released because the signal crossed the threshold */
+    uint32_t released_on_deadline;  /*!< Transfers released because their deadline approached */
+    uint64_t bytes;                 /*!< Sum of size hints of released transfers */
+    uint64_t wait_ms;               /*!< Total time transfers spent deferred */
+    int64_t time_saved_ms;          /*!< Estimated airtime saved by deferring (negative if signal got worse) */
+    int64_t energy_saved_uah;       /*!< Estimated modem energy saved by deferring */
+} esp_modem_scheduler_stats_t;
+
+/**
+ * @brief Scheduler Default Configuration
+ *
+ */
+#define ESP_MODEM_SCHEDULER_DEFAULT_CONFIG()    \
+    {                                           \
+        .rssi_threshold = 15,                   \
+        .deadline_margin_ms = 2000,             \
+        .sample_interval_ms = 10000,            \
+        .nominal_ms_per_kib = 100,              \
+        .active_current_ma = 200,               \
+        .max_transfers = 16,                    \
+        .task_stack_size = 3072,                \
+        .task_priority = 5,                     \
+    }
+
+/**
+ * @brief Create the transmission scheduler and start its task
+ *
+ * @param dce Modem DCE object, queried by esp_modem_scheduler_sample_signal()
+ * @param config scheduler configuration
+ * @return esp_modem_scheduler_t*
+ *      - Scheduler object on success
+ *      - NULL on error
+ */
+esp_modem_scheduler_t *esp_modem_scheduler_create(modem_dce_t *dce, const esp_modem_scheduler_config_t *config);
+
+/**
+ * @brief Submit a deferrable transfer
+ *
+ * @param sched scheduler object
+ * @param transfer_class class used to group statistics (0 .. ESP_MODEM_SCHEDULER_MAX_CLASSES - 1)
+ * @param size_hint expected size of the transfer in bytes
+ * @param deadline_ms latest time (from now) the transfer may start
+ * @param cb callback performing the transfer
+ * @param ctx context pointer passed to the callback
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid class or callback
+ *      - ESP_ERR_NO_MEM if max_transfers are already pending
+ */
+esp_err_t esp_modem_scheduler_submit(esp_modem_scheduler_t *sched, uint8_t transfer_class, size_t size_hint,
+                                     uint32_t deadline_ms, esp_modem_transfer_cb_t cb, void *ctx);
+
+/**
+ * @brief Feed a signal quality sample obtained elsewhere (e.g. a periodic AT+CSQ of the application)
+ *
+ * @param sched scheduler object
+ * @param rssi received signal strength indication in AT+CSQ units
+ * @return ESP_OK on success
+ */
+esp_err_t esp_modem_scheduler_update_signal(esp_modem_scheduler_t *sched, uint32_t rssi);
+
+/**
+ * @brief Issue AT+CSQ if transfers are pending and the signal sample is older than sample_interval_ms
+ *
+ * After a failed query the next one is sent sample_interval_ms later at the earliest.
+ *
+ * The scheduler task never sends commands itself, as the DCE runs one command at
+ * a time. Call this from the task which sends the other commands of the
+ * application, e.g. its periodic status loop.
+ *
+ * @param sched scheduler object
+ * @return esp_err_t
+ *      - ESP_OK if a sample was taken or none was needed
+ *      - ESP_FAIL if the signal quality query failed
+ */
+esp_err_t esp_modem_scheduler_sample_signal(esp_modem_scheduler_t *sched);
+
+/**
+ * @brief Get statistics of one transfer class
+ *
+ * @param sched scheduler object
+ * @param transfer_class class to report
+ * @param stats output statistics
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid class
+ */
+esp_err_t esp_modem_scheduler_get_stats(esp_modem_scheduler_t *sched, uint8_t transfer_class, esp_modem_scheduler_stats_t *stats);
+
+/**
+ * @brief Stop the scheduler task and free the scheduler, pending transfers are dropped
+ *
+ * @param sched scheduler object
+ * @return ESP_OK on success
+ */
+esp_err_t esp_modem_scheduler_destroy(esp_modem_scheduler_t *sched);
+
+#ifdef __cplusplus
+}
+#endif
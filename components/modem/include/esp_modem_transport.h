@@ -0,0 +1,165 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_types.h"
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+typedef struct esp_modem_transport esp_modem_transport_t;
+struct esp_modem_dte_config;
+
+/**
+ * @brief Receive mode of a transport
+ *
+ */
+typedef enum {
+    ESP_MODEM_TRANSPORT_MODE_LINE = 0,  /*!< Command mode, report complete lines if the transport can detect them */
+    ESP_MODEM_TRANSPORT_MODE_DATA,      /*!< Data/CMUX mode, report any received data */
+    ESP_MODEM_TRANSPORT_MODE_PAUSED     /*!< Report nothing, the DTE reads directly */
+} esp_modem_transport_mode_t;
+
+/**
+ * @brief Event returned by the wait method of a transport
+ *
+ */
+typedef enum {
+    ESP_MODEM_TRANSPORT_EVENT_NONE = 0, /*!< Timeout, nothing happened */
+    ESP_MODEM_TRANSPORT_EVENT_DATA,     /*!< Data available, length is the number of buffered bytes */
+    ESP_MODEM_TRANSPORT_EVENT_LINE,     /*!< One line available (line mode only), length includes the '\n' */
+    ESP_MODEM_TRANSPORT_EVENT_OVERFLOW, /*!< Received data was lost and the input was flushed */
+    ESP_MODEM_TRANSPORT_EVENT_ERROR,    /*!< Line error such as break, parity or framing error */
+    ESP_MODEM_TRANSPORT_EVENT_WAKEUP    /*!< The wait was interrupted by the wakeup method */
+} esp_modem_transport_event_t;
+
+/**
+ * @brief Peak usage of the receive path of a transport
+ *
+ */
+typedef struct {
+    size_t rx_buffer;           /*!< Most received bytes waiting to be read */
+    size_t tx_write;            /*!< Largest single write */
+    size_t event_queue;         /*!< Most events waiting in the event queue */
+    size_t pattern_queue;       /*!< Most detected lines waiting */
+    uint32_t overflows;         /*!< Times received data was lost */
+} esp_modem_transport_watermarks_t;
+
+/**
+ * @brief Transport under the DTE
+ *
+ * A transport which never reports ESP_MODEM_TRANSPORT_EVENT_LINE is fine, the
+ * DTE then splits lines itself.
+ */
+struct esp_modem_transport {
+    esp_err_t (*open)(esp_modem_transport_t *transport, const struct esp_modem_dte_config *config);   /*!< Open the link, in line mode */
+    int (*read)(esp_modem_transport_t *transport, uint8_t *data, size_t len, uint32_t timeout_ms);    /*!< Read up to len bytes */
+    int (*write)(esp_modem_transport_t *transport, const void *data, size_t len);                     /*!< Write, returns the length written or -1 */
+    esp_modem_transport_event_t (*wait)(esp_modem_transport_t *transport, size_t *len,
+                                        uint32_t timeout_ms);                                         /*!< Wait for the next receive event */
+    esp_err_t (*wakeup)(esp_modem_transport_t *transport);                                            /*!< Make a pending wait return ESP_MODEM_TRANSPORT_EVENT_WAKEUP */
+    esp_err_t (*flush)(esp_modem_transport_t *transport);                                             /*!< Discard received data */
+    esp_err_t (*set_mode)(esp_modem_transport_t *transport, esp_modem_transport_mode_t mode);         /*!< Switch receive mode */
+    esp_err_t (*set_baud)(esp_modem_transport_t *transport, uint32_t baud_rate);                      /*!< Change the link speed */
+    bool (*tx_idle)(esp_modem_transport_t *transport);                                                /*!< All written data has left, optional */
+    esp_err_t (*set_rx_moderation)(esp_modem_transport_t *transport, uint8_t fifo_threshold,
+                                   uint8_t timeout);                                                  /*!< Set RX FIFO full threshold (bytes) and idle timeout (symbols), optional */
+    esp_err_t (*get_watermarks)(esp_modem_transport_t *transport,
+                                esp_modem_transport_watermarks_t *watermarks);                        /*!< Peak buffer and queue usage since open, optional */
+    esp_err_t (*set_rx_throttle)(esp_modem_transport_t *transport, bool throttle);                    /*!< Stop or resume the peer out of band (RTS), optional */
+    esp_err_t (*set_rx_paced)(esp_modem_transport_t *transport, bool paced);                          /*!< The DTE paces the peer in band (CMUX flow control) in data mode, optional */
+    esp_err_t (*deinit)(esp_modem_transport_t *transport);                                            /*!< Close the link and free the transport */
+};
+
+/**
+ * @brief Create the UART transport, configured from the DTE configuration on open
+ *
+ * This is the transport used when the DTE configuration does not name one.
+ *
+ * @return esp_modem_transport_t*
+ *      - Transport object on success
+ *      - NULL on error
+ */
+esp_modem_transport_t *esp_modem_transport_uart_create(void);
+
+#if CONFIG_COMPONENT_MODEM_TRANSPORT_SOCKET
+/**
+ * @brief Create a transport over a TCP connection, e.g. to a ser2net style bridge
+ *
+ * @param host host name or address of the bridge
+ * @param port TCP port of the bridge
+ * @return esp_modem_transport_t*
+ *      - Transport object on success
+ *      - NULL on error
+ */
+esp_modem_transport_t *esp_modem_transport_tcp_create(const char *host, uint16_t port);
+
+/**
+ * @brief Create a transport over a tty or pty device, e.g. /dev/ttyUSB2 on a Linux host
+ *
+ * @param path device path
+ * @return esp_modem_transport_t*
+ *      - Transport object on success
+ *      - NULL on error
+ */
+esp_modem_transport_t *esp_modem_transport_tty_create(const char *path);
+#endif
+
+#if CONFIG_COMPONENT_MODEM_TRANSPORT_USB
+/**
+ * @brief USB CDC-ACM Transport Configuration
+ *
+ */
+typedef struct {
+    uint16_t vid;                   /*!< USB vendor ID of the modem */
+    uint16_t pid;                   /*!< USB product ID of the modem */
+    uint8_t interface_idx;          /*!< Interface of the AT/PPP port */
+    uint32_t connection_timeout_ms; /*!< Time to wait for the modem to enumerate */
+    size_t rx_buffer_size;          /*!< Receive stream buffer size */
+    size_t tx_buffer_size;          /*!< USB OUT transfer size */
+    uint32_t tx_timeout_ms;         /*!< Timeout of one write */
+} esp_modem_transport_usb_config_t;
+
+/**
+ * @brief USB CDC-ACM Transport Default Configuration (BG96 modem port)
+ *
+ */
+#define ESP_MODEM_TRANSPORT_USB_DEFAULT_CONFIG()    \
+    {                                               \
+        .vid = 0x2C7C,                              \
+        .pid = 0x0296,                              \
+        .interface_idx = 3,                         \
+        .connection_timeout_ms = 10000,             \
+        .rx_buffer_size = 16384,                    \
+        .tx_buffer_size = 4096,                     \
+        .tx_timeout_ms = 1000,                      \
+    }
+
+/**
+ * @brief Create a transport over the USB CDC-ACM port of the modem
+ *
+ * @param config USB transport configuration
+ * @return esp_modem_transport_t*
+ *      - Transport object on success
+ *      - NULL on error
+ */
+esp_modem_transport_t *esp_modem_transport_usb_create(const esp_modem_transport_usb_config_t *config);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
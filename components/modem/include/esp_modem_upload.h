@@ -0,0 +1,85 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_partition.h"
+#include "esp_modem_dce.h"
+
+/**
+ * @brief Partition upload configuration
+ *
+ */
+typedef struct {
+    const char *command;                                            /*!< Upload command with the length, e.g. "AT+CFTRANRX=\"c:/fw.bin\",4096\r" */
+    const char *prompt;                                             /*!< Prompt after which the modem takes the data */
+    uint32_t prompt_timeout_ms;                                     /*!< Time to wait for the prompt */
+    uint32_t result_timeout_ms;                                     /*!< Time to wait for the final response after the last byte */
+    esp_err_t (*handle_result)(modem_dce_t *dce, const char *line); /*!< Handler of the final response, NULL for OK/ERROR */
+    size_t window_size;                                             /*!< Bytes of flash mapped at a time, multiple of the MMU page */
+} esp_modem_upload_config_t;
+
+/**
+ * @brief Partition upload default configuration
+ *
+ */
+#define ESP_MODEM_UPLOAD_DEFAULT_CONFIG()   \
+    {                                       \
+        .command = NULL,                    \
+        .prompt = "CONNECT",                \
+        .prompt_timeout_ms = 5000,          \
+        .result_timeout_ms = 30000,         \
+        .handle_result = NULL,              \
+        .window_size = 0x10000,             \
+    }
+
+/**
+ * @brief Partition upload metrics
+ *
+ */
+typedef struct {
+    size_t bytes;               /*!< Bytes handed to the transport */
+    uint32_t windows;           /*!< Flash windows mapped */
+    uint32_t duration_ms;       /*!< Time from the command to the final response */
+    uint32_t bytes_per_sec;     /*!< Throughput over duration_ms */
+} esp_modem_upload_stats_t;
+
+/**
+ * @brief Upload a range of a flash partition to the modem without copying it to RAM
+ *
+ * The partition is memory-mapped one window at a time and the mapped flash is
+ * written straight to the transport. Without CMUX the DCE must be in command mode.
+ *
+ * @param dce Modem DCE object
+ * @param partition partition to read
+ * @param offset start of the range in the partition
+ * @param length length of the range, 0 for the rest of the partition
+ * @param config upload configuration
+ * @param stats output metrics, may be NULL
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid range or configuration
+ *      - ESP_ERR_INVALID_STATE if the DCE is in PPP mode without CMUX
+ *      - ESP_ERR_TIMEOUT if the prompt or the final response did not come in time
+ *      - ESP_FAIL or the esp_partition_mmap() error otherwise
+ */
+esp_err_t esp_modem_upload_partition(modem_dce_t *dce, const esp_partition_t *partition, size_t offset, size_t length,
+                                     const esp_modem_upload_config_t *config, esp_modem_upload_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -35,3 +35,13 @@ typedef struct {
     void *priv_resource; /*!< Private resource */
     modem_dce_t parent;  /*!< DCE parent class */
 } bg96_modem_dce_t;
+
+/**
+ * @brief Resource of a pending modem-native DNS lookup
+ *
+ */
+typedef struct {
+    char *ip;           /*!< Output buffer for the first address */
+    size_t ip_len;      /*!< Size of the output buffer */
+    int remaining;      /*!< Address lines still expected from the DCE */
+} bg96_dns_resource_t;
@@ -0,0 +1,81 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Max information field length of a basic option CMUX frame */
+#define CMUX_N1 (127)
+/* Flag, address, control, length and FCS, flag */
+#define CMUX_FRAME_OVERHEAD (6)
+/* DLCI carrying PPP, and the AT responses up to CONNECT */
+#define CMUX_DLCI_DATA (1)
+/* DLCI carrying AT commands */
+#define CMUX_DLCI_AT (2)
+
+/**
+ * @brief Result of esp_modem_cmux_parse()
+ *
+ */
+typedef enum {
+    ESP_MODEM_CMUX_FRAME_COMPLETE = 0,  /*!< A valid frame */
+    ESP_MODEM_CMUX_FRAME_INCOMPLETE,    /*!< The frame is not received whole yet */
+    ESP_MODEM_CMUX_FRAME_INVALID,       /*!< No frame: missing flags or two byte length */
+    ESP_MODEM_CMUX_FRAME_BAD_FCS,       /*!< A whole frame with a wrong FCS */
+} esp_modem_cmux_parse_result_t;
+
+/**
+ * @brief Write a CMUX frame
+ *
+ * @param frame buffer of the frame
+ * @param size size of the buffer
+ * @param address address field
+ * @param control control field
+ * @param payload information field
+ * @param length length of the information field, at most CMUX_N1
+ * @return length of the frame, 0 if the payload is too long or the buffer too small
+ */
+size_t esp_modem_cmux_encode(uint8_t *frame, size_t size, uint8_t address, uint8_t control,
+                             const void *payload, size_t length);
+
+/**
+ * @brief Write a UIH frame sent by the DTE, with a precomputed FCS on the control, data and AT DLCIs
+ *
+ * @param frame buffer of the frame
+ * @param size size of the buffer
+ * @param dlci DLCI
+ * @param payload information field
+ * @param length length of the information field, at most CMUX_N1
+ * @return length of the frame, 0 if the payload is too long or the buffer too small
+ */
+size_t esp_modem_cmux_encode_uih(uint8_t *frame, size_t size, uint8_t dlci, const void *payload, size_t length);
+
+/**
+ * @brief Parse the CMUX frame at the start of a buffer
+ *
+ * @param data received bytes, starting with the opening flag
+ * @param length number of bytes
+ * @param frame_length length of the frame, set with complete and bad FCS results
+ * @return parse result
+ */
+esp_modem_cmux_parse_result_t esp_modem_cmux_parse(const uint8_t *data, size_t length, size_t *frame_length);
+
+#ifdef __cplusplus
+}
+#endif
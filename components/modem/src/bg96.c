@@ -13,6 +13,7 @@
 // limitations under the License.
 #include <stdlib.h>
 #include <string.h>
+#include <sys/param.h>
 #include "esp_log.h"
 #include "bg96.h"
 #include "bg96_private.h"
@@ -20,6 +21,11 @@
 
 #define MODEM_RESULT_CODE_POWERDOWN "POWERED DOWN"
 
+/* PDP context used by PPP (ATD*99***1#), also used by the modem-native probes */
+#define BG96_CONTEXT_ID (1)
+/* +QPING result of one echo request that timed out */
+#define BG96_QPING_TIMEOUT (569)
+
 #ifdef CONFIG_COMPONENT_MODEM_PIN
     #define MODEM_AT_CPIN  "AT+CPIN=" CONFIG_COMPONENT_MODEM_PIN "\r"
 #endif 
@@ -265,6 +271,141 @@ err:
     return ESP_FAIL;
 }
 
+/**
+ * @brief Handle response from AT+QPING
+ */
+static esp_err_t bg96_handle_qping(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    bg96_modem_dce_t *bg96_dce = __containerof(dce, bg96_modem_dce_t, parent);
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        /* results follow as URCs */
+        err = ESP_OK;
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+QPING", strlen("+QPING"))) {
+        modem_ping_stats_t *stats = bg96_dce->priv_resource;
+        int result = 0, sent = 0, rcvd = 0, lost = 0, min = 0, max = 0, avg = 0;
+        /* +QPING: <finresult>,<sent>,<rcvd>,<lost>,<min>,<max>,<avg> */
+        int n = sscanf(line, "+QPING: %d,%d,%d,%d,%d,%d,%d", &result, &sent, &rcvd, &lost, &min, &max, &avg);
+        if (n == 7) {
+            stats->sent = sent;
+            stats->received = rcvd;
+            stats->rtt_min_ms = min;
+            stats->rtt_max_ms = max;
+            stats->rtt_avg_ms = avg;
+            err = esp_modem_process_command_done(dce, result == 0 ? MODEM_STATE_SUCCESS : MODEM_STATE_FAIL);
+        } else if (n == 1 && result != 0 && result != BG96_QPING_TIMEOUT) {
+            /* +QPING: <err>, e.g. DNS failure, no summary follows */
+            err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+        } else {
+            /* +QPING: <result>[,<IP_address>,<bytes>,<time>,<ttl>] of one echo request */
+            err = ESP_OK;
+        }
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+QIDNSGIP
+ */
+static esp_err_t bg96_handle_qidnsgip(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    bg96_modem_dce_t *bg96_dce = __containerof(dce, bg96_modem_dce_t, parent);
+    bg96_dns_resource_t *dns = bg96_dce->priv_resource;
+    char addr[64];
+    int result = 0, count = 0;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        /* results follow as URCs */
+        err = ESP_OK;
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (sscanf(line, "+QIURC: \"dnsgip\",%d,%d", &result, &count) == 2) {
+        /* +QIURC: "dnsgip",<err>,<IP_count>,<DNS_ttl> */
+        dns->remaining = count;
+        if (result != 0 || count == 0) {
+            err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+        } else {
+            err = ESP_OK;
+        }
+    } else if (sscanf(line, "+QIURC: \"dnsgip\",\"%63[^\"]\"", addr) == 1) {
+        /* +QIURC: "dnsgip","<IP_addr>", keep the first one */
+        if (dns->ip[0] == '\0') {
+            snprintf(dns->ip, dns->ip_len, "%s", addr);
+        }
+        /* wait for the remaining addresses, so they do not reach the next command */
+        if (--dns->remaining <= 0) {
+            err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+        } else {
+            err = ESP_OK;
+        }
+    }
+    return err;
+}
+
+/**
+ * @brief Ping a host from the modem's own IP stack
+ *
+ * @param dce Modem DCE object
+ * @param host host name or IP address
+ * @param count number of echo requests (1 .. 10)
+ * @param timeout_ms timeout of one echo request
+ * @param stats ping statistics
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t bg96_ping(modem_dce_t *dce, const char *host, uint32_t count, uint32_t timeout_ms, modem_ping_stats_t *stats)
+{
+    modem_dte_t *dte = dce->dte;
+    bg96_modem_dce_t *bg96_dce = __containerof(dce, bg96_modem_dce_t, parent);
+    char command[96];
+    uint32_t timeout_s = MIN(MAX((timeout_ms + 999) / 1000, 1), 255);
+    count = MIN(MAX(count, 1), 10);
+    memset(stats, 0, sizeof(modem_ping_stats_t));
+    int len = snprintf(command, sizeof(command), "AT+QPING=%d,\"%s\",%d,%d\r", BG96_CONTEXT_ID, host, timeout_s, count);
+    DCE_CHECK(len < sizeof(command), "host name too long", err);
+    bg96_dce->priv_resource = stats;
+    dce->handle_line = bg96_handle_qping;
+    DCE_CHECK(dte->send_cmd(dte, command, count * timeout_s * 1000 + MODEM_COMMAND_TIMEOUT_DNS) == ESP_OK, "send command failed", err);
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "ping %s failed", err, host);
+    ESP_LOGD(DCE_TAG, "ping ok, %d/%d replies", stats->received, stats->sent);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Resolve a host name from the modem's own IP stack
+ *
+ * @param dce Modem DCE object
+ * @param host host name
+ * @param ip output buffer for the first address
+ * @param ip_len size of the output buffer
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t bg96_resolve(modem_dce_t *dce, const char *host, char *ip, size_t ip_len)
+{
+    modem_dte_t *dte = dce->dte;
+    bg96_modem_dce_t *bg96_dce = __containerof(dce, bg96_modem_dce_t, parent);
+    char command[96];
+    bg96_dns_resource_t dns = { .ip = ip, .ip_len = ip_len, .remaining = 0 };
+    ip[0] = '\0';
+    int len = snprintf(command, sizeof(command), "AT+QIDNSGIP=%d,\"%s\"\r", BG96_CONTEXT_ID, host);
+    DCE_CHECK(len < sizeof(command), "host name too long", err);
+    bg96_dce->priv_resource = &dns;
+    dce->handle_line = bg96_handle_qidnsgip;
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DNS) == ESP_OK, "send command failed", err);
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "resolve %s failed", err, host);
+    ESP_LOGD(DCE_TAG, "resolve ok, %s", ip);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
 /**
 + * @brief Handle response from AT+CMUX=0
 + */
@@ -533,10 +674,13 @@ modem_dce_t *bg96_init(modem_dte_t *dte)
     bg96_dce->parent.set_working_mode = bg96_set_working_mode;
 //    esp_dte->parent.change_mode = esp_modem_dte_change_mode;
     bg96_dce->parent.power_down = bg96_power_down;
+    bg96_dce->parent.ping = bg96_ping;
+    bg96_dce->parent.resolve = bg96_resolve;
     bg96_dce->parent.needpin = false;
     bg96_dce->parent.deinit = bg96_deinit;
     /* Sync between DTE and DCE */
     DCE_CHECK(esp_modem_dce_sync(&(bg96_dce->parent)) == ESP_OK, "sync failed", err_io);
+    esp_modem_mark_phase(dte, ESP_MODEM_PHASE_SYNC);
 
     /* CMUX */
     if (bg96_dce->parent.dte->cmux) {
@@ -557,7 +701,7 @@ modem_dce_t *bg96_init(modem_dte_t *dte)
     DCE_CHECK(bg96_get_imsi_number(bg96_dce) == ESP_OK, "get imsi failed", err_io);
     /* Get operator name */
     DCE_CHECK(bg96_get_operator_name(bg96_dce) == ESP_OK, "get operator name failed", err_io);
-
+    esp_modem_mark_phase(dte, ESP_MODEM_PHASE_IDENTITY);
 
     return &(bg96_dce->parent);
 err_io:
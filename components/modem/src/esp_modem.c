@@ -17,16 +17,64 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/message_buffer.h"
 #include "esp_modem.h"
+#include "esp_modem_dce_service.h"
+#include "esp_modem_cmux.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_idf_version.h"
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#include "esp_memory_utils.h"
+#else
+#include "soc/soc_memory_layout.h"
+#endif
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "driver/gpio.h"
+#include "nvs.h"
+#include "esp_netif.h"
 #include "sdkconfig.h"
 
 #define ESP_MODEM_LINE_BUFFER_SIZE (CONFIG_UART_RX_BUFFER_SIZE / 2)
 #define ESP_MODEM_EVENT_QUEUE_SIZE (16)
 
-#define MIN_PATTERN_INTERVAL (9)
-#define MIN_POST_IDLE (0)
-#define MIN_PRE_IDLE (0)
+#define ESP_MODEM_DTE_RESET_TIMEOUT_MS (1000)
+#define ESP_MODEM_RESUME_SYNC_RETRIES (5)
+#define ESP_MODEM_RESUME_SYNC_DELAY_MS (500)
+#define ESP_MODEM_ESCAPE_GUARD_MS (1000)
+
+#define ESP_MODEM_NVS_NAMESPACE "esp_modem"
+#define ESP_MODEM_NVS_BUFFER_SIZES_KEY "buf_sizes"
+/* Smallest sizes recommended, the UART driver needs buffers above the FIFO length */
+#define ESP_MODEM_MIN_UART_BUFFER_SIZE (UART_FIFO_LEN * 2)
+#define ESP_MODEM_MIN_EVENT_QUEUE_SIZE (8)
+#define ESP_MODEM_MIN_PATTERN_QUEUE_SIZE (4)
+#define ESP_MODEM_MIN_LINE_BUFFER_SIZE (256)
+
+/* DLCIs with their own line reassembly, indexed by DLCI */
+#define CMUX_LINE_DLCIS (3)
+/* HDLC flag delimiting PPP frames */
+#define PPP_FLAG (0x7E)
+/* Software flow control characters */
+#define SW_FLOW_XON (0x11)
+#define SW_FLOW_XOFF (0x13)
+
+#if CONFIG_COMPONENT_MODEM_RX_MODERATION
+/**
+ * @brief RX interrupt moderation levels, from interactive to bulk traffic
+ *
+ */
+static const struct {
+    uint8_t fifo_threshold;     /*!< RX FIFO full threshold, bytes */
+    uint8_t timeout;            /*!< RX idle timeout, symbols */
+} s_rx_moderation_levels[] = {
+    { 64, 1 },
+    { 96, 4 },
+    { 120, 10 },
+};
+#define RX_MODERATION_LEVELS (sizeof(s_rx_moderation_levels) / sizeof(s_rx_moderation_levels[0]))
+#endif
 
 /**
  * @brief Macro defined for error checking
@@ -45,23 +93,91 @@ static const char *MODEM_TAG = "esp-modem";
 
 ESP_EVENT_DEFINE_BASE(ESP_MODEM_EVENT);
 
+/**
+ * @brief Kind of a record passed from the receive side to the handlers
+ *
+ */
+typedef enum {
+    ESP_DTE_RX_LINE = 0,    /*!< AT response line */
+    ESP_DTE_RX_FRAME,       /*!< Complete CMUX frame */
+    ESP_DTE_RX_PPP,         /*!< PPP data received without CMUX */
+    ESP_DTE_RX_RESET        /*!< Receive side was reset by esp_modem_dte_reset() */
+} esp_dte_rx_item_t;
+
+/**
+ * @brief Line reassembly of one DLCI
+ *
+ */
+typedef struct {
+    uint8_t *buffer;    /*!< Start of the line received so far */
+    size_t len;         /*!< Bytes in buffer */
+} esp_dte_dlci_line_t;
+
 /**
  * @brief ESP32 Modem DTE
  *
  */
 typedef struct {
-    uart_port_t uart_port;                  /*!< UART port */
+    esp_modem_transport_t *transport;       /*!< Transport to the DCE (UART, USB, socket) */
     uint8_t *buffer;                        /*!< Internal buffer to store response lines/data from DCE */
     uint16_t buffer_len;
-    QueueHandle_t event_queue;              /*!< UART event queue handle */
     esp_event_loop_handle_t event_loop_hdl; /*!< Event loop handle */
-    TaskHandle_t uart_event_task_hdl;       /*!< UART event task handle */
+    TaskHandle_t uart_event_task_hdl;       /*!< Receive event task handle */
+    TaskHandle_t rx_task_hdl;               /*!< RX task handle, NULL without the RX pipeline */
+    MessageBufferHandle_t rx_queue;         /*!< Decoded lines and frames from the RX task to the event task */
+    StaticMessageBuffer_t rx_queue_struct;  /*!< Control block of rx_queue */
+    uint8_t *rx_queue_storage;              /*!< Storage of rx_queue, bulk memory */
+    uint8_t *rx_item;                       /*!< Record being queued by the RX task */
+    uint8_t *rx_handle_buffer;              /*!< Record being handled by the event task */
     SemaphoreHandle_t process_sem;          /*!< Semaphore used for indicating processing status */
+    SemaphoreHandle_t reset_sem;            /*!< Semaphore given by the event task when a reset is done */
+    volatile bool reset_requested;          /*!< esp_modem_dte_reset() is waiting for the event task */
     modem_dte_t parent;                     /*!< DTE interface that should extend */
     esp_modem_on_receive receive_cb;        /*!< ptr to data reception */
     void *receive_cb_ctx;                   /*!< ptr to rx fn context data */
     int line_buffer_size;                   /*!< line buffer size in commnad mode */
-    int pattern_queue_size;                 /*!< UART pattern queue size */
+    esp_modem_transport_mode_t mode;        /*!< Receive mode of the transport */
+    uint32_t baud_rate;                     /*!< Line speed, used to estimate TX drain time */
+    SemaphoreHandle_t tx_lock;              /*!< Protects the CMUX TX frame and staging buffers */
+    uint8_t tx_frame[CMUX_N1 + CMUX_FRAME_OVERHEAD];    /*!< Frame being sent on the data DLCI */
+    uint8_t tx_stage[CMUX_N1];              /*!< Small packets waiting to share one frame */
+    size_t tx_stage_len;                    /*!< Bytes in tx_stage */
+    esp_timer_handle_t tx_flush_timer;      /*!< Sends tx_stage once the transport has drained */
+    esp_modem_cmux_tx_stats_t tx_stats;     /*!< CMUX TX statistics */
+    esp_modem_rx_stats_t rx_stats;          /*!< RX statistics and moderation state */
+    esp_dte_dlci_line_t dlci_lines[CMUX_LINE_DLCIS];    /*!< Line reassembly of the CMUX channels, DLCI 0 is unused */
+    esp_modem_buffer_sizes_t buffer_sizes;  /*!< Configured buffer and queue sizes */
+    size_t line_peak;                       /*!< Longest line or most parser bytes seen */
+    uint32_t line_overflows;                /*!< Lines or frames dropped because the line buffer was full */
+    bool rx_throttled;                      /*!< The DCE was asked to stop sending */
+    size_t rx_throttle_high;                /*!< Buffered bytes to stop the DCE at */
+    size_t rx_throttle_low;                 /*!< Buffered bytes to resume the DCE at */
+    esp_modem_timeline_t timeline;          /*!< Startup timeline */
+    uint32_t mem_caps[ESP_MODEM_MEM_CLASSES];   /*!< Heap capabilities of each memory class */
+    portMUX_TYPE mem_lock;                  /*!< Protects mem_report */
+    esp_modem_mem_report_t mem_report;      /*!< Bytes allocated per class and region */
+    const char *raw_prompt;                 /*!< Prompt of the raw transfer waiting for it in CMUX mode */
+    bool wake_enabled;                      /*!< A wakeup source is configured, light sleep is managed */
+    int ri_io_num;                          /*!< Ring indicator pin, UART_PIN_NO_CHANGE if not connected */
+    uint32_t wake_hold_ms;                  /*!< Time light sleep stays blocked after activity */
+    bool awake;                             /*!< The receiving task holds pm_lock */
+    int64_t awake_until;                    /*!< Light sleep stays blocked until then, us */
+    int64_t wake_window_until;              /*!< Lines until then count as woken up for, us */
+    volatile bool ri_pending;               /*!< RI asserted, the interrupt holds pm_lock once */
+    bool ri_masked;                         /*!< RI interrupt disabled until RI is released */
+    esp_modem_wake_stats_t wake_stats;      /*!< Wakeup statistics */
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_handle_t pm_lock;           /*!< Blocks light sleep, NULL without wakeup sources */
+#endif
+#if CONFIG_COMPONENT_MODEM_RX_MODERATION
+    int64_t rx_window_start;                /*!< Start of the moderation measuring window, us */
+    uint32_t rx_window_events;              /*!< Data events in the measuring window */
+    uint32_t rx_window_bytes;               /*!< Bytes in the measuring window */
+#endif
+#if CONFIG_COMPONENT_MODEM_PPP_REASSEMBLY
+    uint8_t *ppp_buffer;                    /*!< PPP data from the data DLCI not yet delivered */
+    size_t ppp_len;                         /*!< Bytes in ppp_buffer */
+#endif
 } esp_modem_dte_t;
 
 /**
@@ -80,40 +196,15 @@ static inline bool is_only_cr_lf(const char *str, uint32_t len)
     return true;
 }
 
-uint8_t crc8(const char *src, size_t len, uint8_t polynomial, uint8_t initial_value,
-	  bool reversed)
-{
-	uint8_t crc = initial_value;
-	size_t i, j;
-
-	for (i = 0; i < len; i++) {
-		crc ^= src[i];
-
-		for (j = 0; j < 8; j++) {
-			if (reversed) {
-				if (crc & 0x01) {
-					crc = (crc >> 1) ^ polynomial;
-				} else {
-					crc >>= 1;
-				}
-			} else {
-				if (crc & 0x80) {
-					crc = (crc << 1) ^ polynomial;
-				} else {
-					crc <<= 1;
-				}
-			}
-		}
-	}
-
-	return crc;
-}
-
 esp_err_t esp_modem_set_rx_cb(modem_dte_t *dte, esp_modem_on_receive receive_cb, void *receive_cb_ctx)
 {
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
     esp_dte->receive_cb_ctx = receive_cb_ctx;
     esp_dte->receive_cb = receive_cb;
+#if CONFIG_COMPONENT_MODEM_PPP_REASSEMBLY
+    /* Do not hand data of a previous session to the new receiver */
+    esp_dte->ppp_len = 0;
+#endif
     return ESP_OK;
 }
 
@@ -122,15 +213,15 @@ esp_err_t esp_modem_set_rx_cb(modem_dte_t *dte, esp_modem_on_receive receive_cb,
  * @brief Handle one line in DTE
  *
  * @param esp_dte ESP modem DTE object
+ * @param line '\0' terminated line
  * @return esp_err_t
  *      - ESP_OK on success
  *      - ESP_FAIL on error
  */
-static esp_err_t esp_dte_handle_line(esp_modem_dte_t *esp_dte)
+static esp_err_t esp_dte_handle_line(esp_modem_dte_t *esp_dte, const char *line)
 {
     modem_dce_t *dce = esp_dte->parent.dce;
     MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
-    const char *line = (const char *)(esp_dte->buffer);
     size_t len = strlen(line);
     /* Skip pure "\r\n" lines */
     if (len > 2 && !is_only_cr_lf(line, len)) {
@@ -139,32 +230,135 @@ static esp_err_t esp_dte_handle_line(esp_modem_dte_t *esp_dte)
     }
     return ESP_OK;
 err_handle:
-    /* Send ESP_MODEM_EVENT_UNKNOWN signal to event loop */
-    esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_UNKNOWN,
-                      (void *)line, strlen(line) + 1, pdMS_TO_TICKS(100));
+    esp_dte->rx_stats.unknown_lines++;
+    /* Send ESP_MODEM_EVENT_UNKNOWN signal to event loop, which is run by this task, so waiting for room would not help */
+    if (esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_UNKNOWN,
+                          (void *)line, strlen(line) + 1, 0) != ESP_OK) {
+        esp_dte->rx_stats.unknown_dropped++;
+    }
 err:
     return ESP_FAIL;
 }
 
 /**
- * @brief Handle one line in DTE
+ * @brief Pass PPP data received on the data DLCI to the reception callback
+ *
+ * With reassembly enabled, data is collected across mux frames and only
+ * delivered up to the last PPP flag, so the callback mostly sees whole
+ * HDLC-framed PPP packets in a single call.
+ *
+ * @param esp_dte ESP modem DTE object
+ * @param data payload of one mux frame
+ * @param length payload length
+ */
+static void esp_dte_receive_ppp(esp_modem_dte_t *esp_dte, const uint8_t *data, size_t length)
+{
+#if CONFIG_COMPONENT_MODEM_PPP_REASSEMBLY
+    while (length) {
+        size_t chunk = MIN(length, CONFIG_COMPONENT_MODEM_PPP_REASSEMBLY_SIZE - esp_dte->ppp_len);
+        memcpy(&esp_dte->ppp_buffer[esp_dte->ppp_len], data, chunk);
+        size_t start = esp_dte->ppp_len;
+        esp_dte->ppp_len += chunk;
+        data += chunk;
+        length -= chunk;
+        /* Deliver up to and including the last flag of the new data */
+        size_t end = esp_dte->ppp_len;
+        while (end > start && esp_dte->ppp_buffer[end - 1] != PPP_FLAG) {
+            end--;
+        }
+        if (end == start && esp_dte->ppp_len == CONFIG_COMPONENT_MODEM_PPP_REASSEMBLY_SIZE) {
+            /* No flag in a full buffer, deliver it as is */
+            end = esp_dte->ppp_len;
+        }
+        if (end > start) {
+            esp_dte->receive_cb(esp_dte->ppp_buffer, end, esp_dte->receive_cb_ctx);
+            esp_dte->ppp_len -= end;
+            memmove(esp_dte->ppp_buffer, &esp_dte->ppp_buffer[end], esp_dte->ppp_len);
+        }
+    }
+#else
+    esp_dte->receive_cb((void *)data, length, esp_dte->receive_cb_ctx);
+#endif
+}
+
+/**
+ * @brief Split the payload of the frames of one DLCI into lines
+ *
+ * Modems split long responses across frames and pack several lines into one,
+ * so the bytes of each DLCI are collected and every complete line is handled
+ * just like in command mode. The prompt of a raw transfer has no line end and
+ * is handled as soon as the incomplete line contains it.
+ *
+ * @param esp_dte ESP modem DTE object
+ * @param dlci DLCI the payload was received on
+ * @param data payload of one frame
+ * @param length payload length
+ * @param[out] used if not NULL, stop after the first line which is not empty and store the bytes used
+ * @return true if stopped after a line
+ */
+static bool esp_dte_handle_dlci_lines(esp_modem_dte_t *esp_dte, uint8_t dlci, const uint8_t *data, size_t length,
+                                      size_t *used)
+{
+    esp_dte_dlci_line_t *line = &esp_dte->dlci_lines[dlci];
+    size_t pos = 0;
+    bool stopped = false;
+    while (pos < length && !stopped) {
+        const uint8_t *end = memchr(&data[pos], '\n', length - pos);
+        size_t chunk = end ? end - &data[pos] + 1 : length - pos;
+        if (line->len + chunk >= esp_dte->line_buffer_size) {
+            ESP_LOGW(MODEM_TAG, "ESP Modem Line buffer too small");
+            esp_dte->line_overflows++;
+            line->len = 0;
+            pos += chunk;
+            continue;
+        }
+        memcpy(&line->buffer[line->len], &data[pos], chunk);
+        line->len += chunk;
+        pos += chunk;
+        esp_dte->line_peak = MAX(esp_dte->line_peak, line->len + 1);
+        /* make sure the line is a standard string */
+        line->buffer[line->len] = '\0';
+        if (!end) {
+            const char *prompt = esp_dte->raw_prompt;
+            if (prompt && strstr((const char *)line->buffer, prompt)) {
+                line->len = 0;
+                ESP_LOGD(MODEM_TAG, "< DLCI %d prompt: %s", dlci, line->buffer);
+                esp_dte_handle_line(esp_dte, (const char *)line->buffer);
+                stopped = used != NULL;
+            }
+            break;
+        }
+        bool empty = line->len <= 2 || is_only_cr_lf((const char *)line->buffer, line->len);
+        line->len = 0;
+        ESP_LOGD(MODEM_TAG, "< DLCI %d line: %s", dlci, line->buffer);
+        esp_dte_handle_line(esp_dte, (const char *)line->buffer);
+        stopped = used && !empty;
+    }
+    if (used) {
+        *used = pos;
+    }
+    return stopped;
+}
+
+/**
+ * @brief Handle one CMUX frame in DTE
  *
  * @param esp_dte ESP modem DTE object
+ * @param frame complete frame, from the opening to the closing flag
  * @return esp_err_t
  *      - ESP_OK on success
  *      - ESP_FAIL on error
  */
-static esp_err_t esp_dte_handle_cmux_frame(esp_modem_dte_t *esp_dte)
+static esp_err_t esp_dte_handle_cmux_frame(esp_modem_dte_t *esp_dte, char *frame)
 {
     modem_dce_t *dce = esp_dte->parent.dce;
-    char *frame = (char *)(esp_dte->buffer);
 
     MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
     uint8_t dlci = frame[1] >> 2;
     uint8_t type = frame[2];
     uint8_t length = frame[3] >> 1;
     
-    ESP_LOGD(MODEM_TAG, "CMUX FR: A:%02x T:%02x L:%d Buf:%d", dlci, type, length, esp_dte->buffer_len);
+    ESP_LOGD(MODEM_TAG, "CMUX FR: A:%02x T:%02x L:%d", dlci, type, length);
 //    printf("buffer >>> ");
 //	for (uint16_t i = 0; i < length; i++)
 //	    printf("%02x ", frame[i]);
@@ -173,32 +367,28 @@ static esp_err_t esp_dte_handle_cmux_frame(esp_modem_dte_t *esp_dte)
     if (dce->handle_cmux_frame != NULL) {
             MODEM_CHECK(dce->handle_cmux_frame(dce, frame) == ESP_OK, "handle cmux frame failed", err_handle);
     }
-    else if ((type == FT_UIH || type == (FT_UIH | PF)) && dlci == 1 && dce->handle_line != NULL 
-             && strlen(&frame[6]) > 2)
+    else if ((type == FT_UIH || type == (FT_UIH | PF)) && dlci == CMUX_DLCI_DATA && dce->handle_line != NULL
+             && dce->mode != MODEM_PPP_MODE)
     {
-        // Handle CONNECT message on DLCI 1
-        ESP_LOGI(MODEM_TAG, "Handle Line: %s for DLCI 1", &frame[6]);
-        MODEM_CHECK(dce->handle_line, "no handler for line", err_handle);
-        MODEM_CHECK(dce->handle_line(dce, &frame[6]) == ESP_OK, "handle line failed", err_handle);
-        dce->handle_line = NULL;
+        /* Response to ATD, after CONNECT the channel carries PPP */
+        size_t used = 0;
+        if (esp_dte_handle_dlci_lines(esp_dte, dlci, (const uint8_t *)&frame[4], length, &used)) {
+            ESP_LOGI(MODEM_TAG, "Handled response on DLCI 1");
+            dce->handle_line = NULL;
+        }
+        if (used < length && esp_dte->receive_cb != NULL) {
+            esp_dte_receive_ppp(esp_dte, (const uint8_t *)&frame[4 + used], length - used);
+        }
     }
-    else if ((type == FT_UIH || type == (FT_UIH | PF)) && dlci == 2 && dce->handle_line != NULL)
+    else if ((type == FT_UIH || type == (FT_UIH | PF)) && dlci == CMUX_DLCI_AT)
     {
-        ESP_LOGD(MODEM_TAG, "Handle line from DLCI 2");
-        frame[4 + length] = '\0';
-        /* Skipping first two \r\n */
-        if (strlen(&frame[6]) > 2)
-        {
-            ESP_LOGD(MODEM_TAG, "Line: %s", &frame[6]);
-            MODEM_CHECK(dce->handle_line, "no handler for line", err_handle);
-            MODEM_CHECK(dce->handle_line(dce, &frame[6]) == ESP_OK, "handle line failed", err_handle);
-        }
+        esp_dte_handle_dlci_lines(esp_dte, dlci, (const uint8_t *)&frame[4], length, NULL);
     }
-    else if ((type == FT_UIH || type == (FT_UIH | PF)) && length && dlci == 1 && esp_dte->receive_cb != NULL)
+    else if ((type == FT_UIH || type == (FT_UIH | PF)) && length && dlci == CMUX_DLCI_DATA && esp_dte->receive_cb != NULL)
     {
         // Handle DCLI 1
         ESP_LOGD(MODEM_TAG, "Pass data with length %d from DLCI: %d to receive_cb", length, dlci);
-        esp_dte->receive_cb(&esp_dte->buffer[4], length, esp_dte->receive_cb_ctx);
+        esp_dte_receive_ppp(esp_dte, (const uint8_t *)&frame[4], length);
     }
     else if (dlci != 0)
     {
@@ -207,84 +397,157 @@ static esp_err_t esp_dte_handle_cmux_frame(esp_modem_dte_t *esp_dte)
     return ESP_OK;
 
 err_handle:
+    esp_dte->rx_stats.unknown_lines++;
     /* Send ESP_MODEM_EVENT_UNKNOWN signal to event loop */
-    esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_UNKNOWN,
-                      "cmux frame invalid", 4, pdMS_TO_TICKS(100));
+    if (esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_UNKNOWN,
+                          "cmux frame invalid", 4, 0) != ESP_OK) {
+        esp_dte->rx_stats.unknown_dropped++;
+    }
 
 err:
     return ESP_FAIL;
 }
 
+static void esp_dte_reset_handlers(esp_modem_dte_t *esp_dte);
+
 /**
- * @brief Handle when a pattern has been detected by UART
+ * @brief Run the handlers for one record from the receive side
  *
  * @param esp_dte ESP32 Modem DTE object
+ * @param type kind of record
+ * @param data line or frame, lines are '\0' terminated
+ * @param len length of data, without the terminator
  */
-static void esp_handle_uart_pattern(esp_modem_dte_t *esp_dte)
+static void esp_dte_handle_rx_item(esp_modem_dte_t *esp_dte, esp_dte_rx_item_t type, uint8_t *data, size_t len)
 {
-    int pos = uart_pattern_pop_pos(esp_dte->uart_port);
-    int read_len = 0;
-    if (pos != -1) {
-        if (pos < esp_dte->line_buffer_size - 1) {
-            /* read one line(include '\n') */
-            read_len = pos + 1;
-        } else {
-            ESP_LOGW(MODEM_TAG, "ESP Modem Line buffer too small");
-            read_len = esp_dte->line_buffer_size - 1;
-        }
-        read_len = uart_read_bytes(esp_dte->uart_port, esp_dte->buffer, read_len, pdMS_TO_TICKS(100));
-        if (read_len) {
-            /* make sure the line is a standard string */
-            esp_dte->buffer[read_len] = '\0';
-            ESP_LOGD(MODEM_TAG, "< line: %s", esp_dte->buffer);
-            /* Send new line to handle */
-            esp_dte_handle_line(esp_dte);
-        } else {
-            ESP_LOGE(MODEM_TAG, "uart read bytes failed");
+    int64_t start = esp_timer_get_time();
+    switch (type) {
+    case ESP_DTE_RX_LINE:
+        esp_dte_handle_line(esp_dte, (const char *)data);
+        break;
+    case ESP_DTE_RX_FRAME:
+        esp_dte_handle_cmux_frame(esp_dte, (char *)data);
+        break;
+    case ESP_DTE_RX_PPP:
+        if (esp_dte->receive_cb) {
+            esp_dte_receive_ppp(esp_dte, data, len);
         }
-    } else {
-        ESP_LOGW(MODEM_TAG, "Pattern Queue Size too small");
-        uart_flush(esp_dte->uart_port);
+        break;
+    case ESP_DTE_RX_RESET:
+        esp_dte_reset_handlers(esp_dte);
+        xSemaphoreGive(esp_dte->reset_sem);
+        break;
     }
+    esp_dte->rx_stats.handler_busy_us += esp_timer_get_time() - start;
 }
 
-static void esp_handle_uart_frame(esp_modem_dte_t *esp_dte)
+/**
+ * @brief Pass a line or frame found by the receive side to the handlers
+ *
+ * Without the RX pipeline the handlers run right away. With it, the record is
+ * copied to the queue and handled later by the event task, so slow handlers do
+ * not hold up reading the transport.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param type kind of record
+ * @param data line or frame, lines are '\0' terminated
+ * @param len length of data, without the terminator
+ */
+static void esp_dte_deliver_rx_item(esp_modem_dte_t *esp_dte, esp_dte_rx_item_t type, uint8_t *data, size_t len)
 {
-    
-    uint16_t fl, frame_length_full;
-
-    handle:
-
-    fl = esp_dte->buffer[3] >> 1;
-    frame_length_full = fl + 6;
-    ESP_LOGD(MODEM_TAG, "Check frame with buffer length: %d, frame length: %d", esp_dte->buffer_len, frame_length_full);
-
-    if (esp_dte->buffer_len < 5) {
-        return; 
+    if (!esp_dte->rx_queue) {
+        esp_dte_handle_rx_item(esp_dte, type, data, len);
+        return;
     }
+    esp_dte->rx_item[0] = type;
+    memcpy(&esp_dte->rx_item[1], data, len);
+    /* When the event task falls behind, block here and let the transport buffer the input */
+    xMessageBufferSend(esp_dte->rx_queue, esp_dte->rx_item, len + 1, portMAX_DELAY);
+}
 
-    if (esp_dte->buffer[0] != SOF_MARKER) {
-        ESP_LOGW(MODEM_TAG, "Missing start SOF"); 
-        return; 
+/**
+ * @brief Handle when the transport has detected a line
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param len length of the line, including '\n'
+ */
+static void esp_handle_uart_pattern(esp_modem_dte_t *esp_dte, size_t len)
+{
+    int read_len = 0;
+    if (len < esp_dte->line_buffer_size - 1) {
+        /* read one line(include '\n') */
+        read_len = len;
+    } else {
+        ESP_LOGW(MODEM_TAG, "ESP Modem Line buffer too small");
+        esp_dte->line_overflows++;
+        read_len = esp_dte->line_buffer_size - 1;
+    }
+    esp_dte->line_peak = MAX(esp_dte->line_peak, len + 1);
+    read_len = esp_dte->transport->read(esp_dte->transport, esp_dte->buffer, read_len, 100);
+    if (read_len > 0) {
+        /* make sure the line is a standard string */
+        esp_dte->buffer[read_len] = '\0';
+        ESP_LOGD(MODEM_TAG, "< line: %s", esp_dte->buffer);
+        /* Send new line to handle */
+        esp_dte_deliver_rx_item(esp_dte, ESP_DTE_RX_LINE, esp_dte->buffer, read_len);
+    } else {
+        ESP_LOGE(MODEM_TAG, "uart read bytes failed");
     }
+}
 
-    if (esp_dte->buffer_len < frame_length_full) {
-        // Frame incomplete
-        return;
+/**
+ * @brief Split lines in software, for transports which cannot detect them
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ */
+static void esp_handle_uart_lines(esp_modem_dte_t *esp_dte)
+{
+    uint8_t *end;
+    while ((end = memchr(esp_dte->buffer, '\n', esp_dte->buffer_len)) != NULL) {
+        size_t line_len = end - esp_dte->buffer + 1;
+        /* make sure the line is a standard string */
+        uint8_t next = esp_dte->buffer[line_len];
+        esp_dte->buffer[line_len] = '\0';
+        ESP_LOGD(MODEM_TAG, "< line: %s", esp_dte->buffer);
+        esp_dte_deliver_rx_item(esp_dte, ESP_DTE_RX_LINE, esp_dte->buffer, line_len);
+        esp_dte->buffer[line_len] = next;
+        esp_dte->buffer_len -= line_len;
+        memmove(esp_dte->buffer, &esp_dte->buffer[line_len], esp_dte->buffer_len);
+    }
+    if (esp_dte->buffer_len >= esp_dte->line_buffer_size - 1) {
+        ESP_LOGW(MODEM_TAG, "ESP Modem Line buffer too small");
+        esp_dte->line_overflows++;
+        esp_dte->buffer_len = 0;
     }
+}
+
+static void esp_handle_uart_frame(esp_modem_dte_t *esp_dte)
+{
+    size_t frame_length_full = 0;
 
-    if (esp_dte->buffer[frame_length_full-1] != SOF_MARKER) {
-        ESP_LOGW(MODEM_TAG, "Missing end SOF");
-        return; 
+    handle:
+
+    switch (esp_modem_cmux_parse(esp_dte->buffer, esp_dte->buffer_len, &frame_length_full)) {
+    case ESP_MODEM_CMUX_FRAME_INCOMPLETE:
+        return;
+    case ESP_MODEM_CMUX_FRAME_INVALID:
+        ESP_LOGW(MODEM_TAG, "Missing SOF");
+        return;
+    case ESP_MODEM_CMUX_FRAME_BAD_FCS:
+        ESP_LOGW(MODEM_TAG, "Dropping frame with bad FCS");
+        esp_dte->rx_stats.fcs_errors++;
+        break;
+    default:
+        ESP_LOGD(MODEM_TAG, "Check frame with buffer length: %d, frame length: %d", esp_dte->buffer_len, frame_length_full);
+        // handle one complete frame
+        esp_dte_deliver_rx_item(esp_dte, ESP_DTE_RX_FRAME, esp_dte->buffer, frame_length_full);
+        break;
     }
-    
-    // handle one complete frame
-    esp_dte_handle_cmux_frame(esp_dte);
 
     // check if there is data from next frame
     if (esp_dte->buffer_len > frame_length_full)
     {
-        uint16_t frame_length_next = esp_dte->buffer_len - frame_length_full;
+        size_t frame_length_next = esp_dte->buffer_len - frame_length_full;
         ESP_LOGD(MODEM_TAG, "Copy %d from next frame to beginning of the buffer", frame_length_next);
 //        printf("copy >>> ");
 //        for (uint16_t i = 0; i < esp_dte->buffer_len; i++)
@@ -313,14 +576,36 @@ static void esp_handle_uart_frame(esp_modem_dte_t *esp_dte)
  * @brief Handle when new data received by UART
  *
  * @param esp_dte ESP32 Modem DTE object
+ * @param length number of bytes available
+ * @return number of bytes read from the transport
  */
-static void esp_handle_uart_data(esp_modem_dte_t *esp_dte)
+static size_t esp_handle_uart_data(esp_modem_dte_t *esp_dte, size_t length)
 {
-    size_t length = 0;
-    length = MIN(esp_dte->line_buffer_size, length);
-    uart_get_buffered_data_len(esp_dte->uart_port, &length);
-    length = uart_read_bytes(esp_dte->uart_port, &esp_dte->buffer[esp_dte->buffer_len], length, portMAX_DELAY);
-    esp_dte->buffer_len += length;
+    /* keep room for the string terminator of the line parser */
+    length = MIN(esp_dte->line_buffer_size - 1 - esp_dte->buffer_len, length);
+    if (length == 0 && esp_dte->buffer_len) {
+        ESP_LOGW(MODEM_TAG, "ESP Modem Line buffer full, dropping %d bytes", esp_dte->buffer_len);
+        esp_dte->line_overflows++;
+        esp_dte->buffer_len = 0;
+        return 0;
+    }
+    int read_len = esp_dte->transport->read(esp_dte->transport, &esp_dte->buffer[esp_dte->buffer_len], length, portMAX_DELAY);
+    if (read_len <= 0) {
+        return 0;
+    }
+    esp_dte->buffer_len += read_len;
+    /* plus the string terminator */
+    esp_dte->line_peak = MAX(esp_dte->line_peak, esp_dte->buffer_len + 1);
+    if (esp_dte->mode == ESP_MODEM_TRANSPORT_MODE_LINE) {
+        esp_handle_uart_lines(esp_dte);
+        return read_len;
+    }
+    if (!esp_dte->parent.cmux) {
+        /* Plain PPP, the data needs no framing by the DTE */
+        esp_dte_deliver_rx_item(esp_dte, ESP_DTE_RX_PPP, esp_dte->buffer, esp_dte->buffer_len);
+        esp_dte->buffer_len = 0;
+        return read_len;
+    }
 //        printf("received < ");
 //	    for (uint16_t i = 0; i < length; i++)
 //	        printf("%02x ", buffer[i]);
@@ -341,241 +626,700 @@ static void esp_handle_uart_data(esp_modem_dte_t *esp_dte)
 //            goto handle;
         }
     }
+    return read_len;
 }
 
+#if CONFIG_COMPONENT_MODEM_RX_MODERATION
 /**
- * @brief UART Event Task Entry
+ * @brief Apply an RX interrupt moderation level to the transport
  *
- * @param param task parameter
+ * @param esp_dte ESP32 Modem DTE object
+ * @param level new level
  */
-static void uart_event_task_entry(void *param)
+static void esp_dte_set_rx_moderation(esp_modem_dte_t *esp_dte, uint8_t level)
 {
-    esp_modem_dte_t *esp_dte = (esp_modem_dte_t *)param;
-    uart_event_t event;
-    while (1) {
-        if (xQueueReceive(esp_dte->event_queue, &event, pdMS_TO_TICKS(100))) {
-            switch (event.type) {
-            case UART_DATA:
-                esp_handle_uart_data(esp_dte);
-                break;
-            case UART_FIFO_OVF:
-                ESP_LOGW(MODEM_TAG, "HW FIFO Overflow");
-                uart_flush_input(esp_dte->uart_port);
-                xQueueReset(esp_dte->event_queue);
-                break;
-            case UART_BUFFER_FULL:
-                ESP_LOGW(MODEM_TAG, "Ring Buffer Full");
-                uart_flush_input(esp_dte->uart_port);
-                xQueueReset(esp_dte->event_queue);
-                break;
-            case UART_BREAK:
-                ESP_LOGW(MODEM_TAG, "Rx Break");
-                break;
-            case UART_PARITY_ERR:
-                ESP_LOGE(MODEM_TAG, "Parity Error");
-                break;
-            case UART_FRAME_ERR:
-                ESP_LOGE(MODEM_TAG, "Frame Error");
-                break;
-            case UART_PATTERN_DET:
-                esp_handle_uart_pattern(esp_dte);
-                break;
-            default:
-                ESP_LOGW(MODEM_TAG, "unknown uart event type: %d", event.type);
-                break;
-            }
-        }
-        /* Drive the event loop */
-        esp_event_loop_run(esp_dte->event_loop_hdl, pdMS_TO_TICKS(50));
+    esp_modem_transport_t *transport = esp_dte->transport;
+    if (transport->set_rx_moderation &&
+            transport->set_rx_moderation(transport, s_rx_moderation_levels[level].fifo_threshold,
+                                         s_rx_moderation_levels[level].timeout) == ESP_OK) {
+        ESP_LOGD(MODEM_TAG, "RX moderation level %d", level);
+        esp_dte->rx_stats.moderation_level = level;
     }
-    vTaskDelete(NULL);
 }
 
 /**
- * @brief Send command to DCE
+ * @brief Check whether the RX timeout of a moderation level keeps within the latency target
  *
- * @param dte Modem DTE object
- * @param command command string
- * @param timeout timeout value, unit: ms
- * @return esp_err_t
- *      - ESP_OK on success
- *      - ESP_FAIL on error
+ * @param esp_dte ESP32 Modem DTE object
+ * @param level level to check
  */
-static esp_err_t esp_modem_dte_send_cmd(modem_dte_t *dte, const char *command, uint32_t timeout)
+static bool esp_dte_rx_moderation_allowed(esp_modem_dte_t *esp_dte, uint8_t level)
 {
-    esp_err_t ret = ESP_FAIL;
-    modem_dce_t *dce = dte->dce;
-    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
-    MODEM_CHECK(command, "command is NULL", err);
-    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
-    /* Calculate timeout clock tick */
-    /* Reset runtime information */
-    dce->state = MODEM_STATE_PROCESSING;
-    /* Send command via UART */
-    uart_write_bytes(esp_dte->uart_port, command, strlen(command));
-    /* Check timeout */
-    MODEM_CHECK(xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(timeout)) == pdTRUE, "process command timeout", err);
-    ret = ESP_OK;
-err:
-    dce->handle_line = NULL;
-    return ret;
+    /* a symbol is 10 bits with 8N1 */
+    uint64_t timeout_us = (uint64_t)s_rx_moderation_levels[level].timeout * 10 * 1000000 / esp_dte->baud_rate;
+    return timeout_us <= CONFIG_COMPONENT_MODEM_RX_MODERATION_MAX_LATENCY_US;
 }
 
-static esp_err_t esp_modem_dte_send_sabm(modem_dte_t *dte, uint8_t dlci, uint32_t timeout)
+/**
+ * @brief Account one data event and adapt the moderation level at the end of a measuring window
+ *
+ * Many small data events mean the FIFO threshold and timeout fire long before
+ * the FIFO fills, so the level is raised; a low event rate means interactive
+ * traffic, so it is lowered again.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param len bytes announced by the event
+ */
+static void esp_dte_update_rx_moderation(esp_modem_dte_t *esp_dte, size_t len)
 {
-  esp_err_t ret = ESP_FAIL;
-  modem_dce_t *dce = dte->dce;
-  MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
-  esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
-  char frame[6];
-  frame[0] = SOF_MARKER;
-  frame[1] = (dlci << 2) | 0x3;
-  frame[2] = FT_SABM | PF;
-  frame[3] = 1;
-  frame[4] = 0xFF - crc8(&frame[1], 3, FCS_POLYNOMIAL, FCS_INIT_VALUE, true);
-  frame[5] = SOF_MARKER;
-	/*printf("sabm > ");
-  for (uint8_t i = 0; i < 6; i++)
-    printf("%02x ", frame[i]);
-  printf("\n");*/
-  /* Calculate timeout clock tick */
-  /* Reset runtime information */
-  dce->state = MODEM_STATE_PROCESSING;
-  /* Send command via UART */
-  uart_write_bytes(esp_dte->uart_port, frame, 6);
-  /* Check timeout */
-  MODEM_CHECK(xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(timeout)) == pdTRUE, "process command timeout", err);
-  ret = ESP_OK;
-err:
-  dce->handle_cmux_frame = NULL;
-  return ret;
-  //f9 03 2f 01 09 f9
+    int64_t now = esp_timer_get_time();
+    esp_dte->rx_window_events++;
+    esp_dte->rx_window_bytes += len;
+    int64_t elapsed = now - esp_dte->rx_window_start;
+    if (elapsed < CONFIG_COMPONENT_MODEM_RX_MODERATION_WINDOW_MS * 1000) {
+        return;
+    }
+    uint32_t rate = (uint64_t)esp_dte->rx_window_events * 1000000 / elapsed;
+    uint32_t bytes_per_event = esp_dte->rx_window_bytes / esp_dte->rx_window_events;
+    uint8_t level = esp_dte->rx_stats.moderation_level;
+    esp_dte->rx_stats.last_event_rate = rate;
+    if (rate >= CONFIG_COMPONENT_MODEM_RX_MODERATION_HIGH_RATE && level + 1 < RX_MODERATION_LEVELS &&
+            bytes_per_event < s_rx_moderation_levels[level + 1].fifo_threshold &&
+            esp_dte_rx_moderation_allowed(esp_dte, level + 1)) {
+        esp_dte_set_rx_moderation(esp_dte, level + 1);
+        esp_dte->rx_stats.moderation_raises++;
+    } else if (rate <= CONFIG_COMPONENT_MODEM_RX_MODERATION_LOW_RATE && level > 0) {
+        esp_dte_set_rx_moderation(esp_dte, level - 1);
+        esp_dte->rx_stats.moderation_lowers++;
+    }
+    esp_dte->rx_window_start = now;
+    esp_dte->rx_window_events = 0;
+    esp_dte->rx_window_bytes = 0;
 }
+#endif
+
+static esp_err_t esp_modem_dte_send_cmd(modem_dte_t *dte, const char *command, uint32_t timeout);
+static int esp_modem_dte_send_data(modem_dte_t *dte, const char *data, uint32_t length);
 
 /**
- * @brief Send command to DCE
+ * @brief Switch the receive mode of the transport
  *
- * @param dte Modem DTE object
- * @param command command string
- * @param timeout timeout value, unit: ms
- * @return esp_err_t
- *      - ESP_OK on success
- *      - ESP_FAIL on error
+ * @param esp_dte ESP32 Modem DTE object
+ * @param mode new receive mode
  */
-static esp_err_t esp_modem_dte_send_cmux_cmd(modem_dte_t *dte, const char *command, uint32_t timeout)
+static void esp_dte_set_mode(esp_modem_dte_t *esp_dte, esp_modem_transport_mode_t mode)
 {
-    esp_err_t ret = ESP_FAIL;
-    modem_dce_t *dce = dte->dce;
-    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
-    MODEM_CHECK(command, "command is NULL", err);
-    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
-    char *frame;
-		frame = (char *) malloc(6 + strlen(command));
-		if (strcmp(command, "ATD*99***1#\r") == 0)
-		{
-			ESP_LOGI(MODEM_TAG, "Got ATD");
-			frame[1] = (0x1 << 2) + 1;
-		}
-		else
-		{
-			frame[1] = (0x2 << 2) + 1;
-		}
-    frame[0] = SOF_MARKER;
-    frame[2] = FT_UIH;
-    frame[3] = (strlen(command) << 1) + 1;
-    memcpy(&frame[4], command, strlen(command));
-    frame[4 + strlen(command)] = 0xFF - crc8(&frame[1], 3, FCS_POLYNOMIAL, FCS_INIT_VALUE, true);
-    frame[5 + strlen(command)] = SOF_MARKER;
-    ESP_LOGD(MODEM_TAG, "> %s", command);
-    //printf("cmd > ");
-    //for (uint8_t i = 0; i < 6 + strlen(command); i++)
-    //  printf("%02x ", frame[i]);
-    //printf("\n");
-
-    /* Calculate timeout clock tick */
-    /* Reset runtime information */
-    dce->state = MODEM_STATE_PROCESSING;
-    /* Send command via UART */
-    uart_write_bytes(esp_dte->uart_port, frame, 6 + strlen(command));
-	vTaskDelay(100 / portTICK_PERIOD_MS);
-    /* Check timeout */
-    MODEM_CHECK(xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(timeout)) == pdTRUE, "process command timeout", err);
-    ret = ESP_OK;
-		free(frame);
-err:
-    dce->handle_cmux_frame = NULL;
-    return ret;
+    esp_dte->mode = mode;
+    esp_dte->transport->set_mode(esp_dte->transport, mode);
+    if (mode == ESP_MODEM_TRANSPORT_MODE_DATA && esp_dte->transport->set_rx_paced) {
+        /* Software flow control only reaches the DCE through CMUX in data mode */
+        esp_dte->transport->set_rx_paced(esp_dte->transport,
+                                         esp_dte->parent.flow_ctrl == MODEM_FLOW_CONTROL_SW && esp_dte->parent.cmux);
+    }
+#if CONFIG_COMPONENT_MODEM_RX_MODERATION
+    /* Every mode starts out interactive */
+    if (esp_dte->rx_stats.moderation_level != 0) {
+        esp_dte_set_rx_moderation(esp_dte, 0);
+    }
+    esp_dte->rx_window_start = esp_timer_get_time();
+    esp_dte->rx_window_events = 0;
+    esp_dte->rx_window_bytes = 0;
+#endif
 }
 
 /**
- * @brief Send data to DCE
+ * @brief Reset the transport and the line/CMUX parser back to command mode, called from the receiving task
  *
- * @param dte Modem DTE object
- * @param data data buffer
- * @param length length of data to send
- * @return int actual length of data that has been send out
+ * @param esp_dte ESP32 Modem DTE object
  */
-static int esp_modem_dte_send_data(modem_dte_t *dte, const char *data, uint32_t length)
+static void esp_dte_reset_rx(esp_modem_dte_t *esp_dte)
 {
-    MODEM_CHECK(data, "data is NULL", err);
-    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
-		/*printf("> ");
-		for (uint8_t i = 0; i < length; i++)
-			printf("%02x ", data[i]);
-		printf("\n");*/
-    return uart_write_bytes(esp_dte->uart_port, data, length);
-err:
-    return -1;
+    /* Back to line mode, as after init */
+    esp_dte_set_mode(esp_dte, ESP_MODEM_TRANSPORT_MODE_PAUSED);
+    esp_dte->transport->flush(esp_dte->transport);
+    esp_dte_set_mode(esp_dte, ESP_MODEM_TRANSPORT_MODE_LINE);
+    /* Reset the line and CMUX frame parser */
+    esp_dte->buffer_len = 0;
+    esp_dte->buffer[0] = '\0';
 }
 
 /**
- * @brief Send CMUX data to DCE
+ * @brief Reset the DTE and DCE state back to command mode, called from the handling task
  *
- * @param dte Modem DTE object
- * @param data data buffer
- * @param length length of data to send
- * @return int actual length of data that has been send out
+ * @param esp_dte ESP32 Modem DTE object
  */
-static int esp_modem_dte_send_cmux_data(modem_dte_t *dte, const char *data, uint32_t length)
+static void esp_dte_reset_handlers(esp_modem_dte_t *esp_dte)
 {
-    MODEM_CHECK(data, "data is NULL", err);
-    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
-    uint32_t length_to_transmit = length;
-    while (length_to_transmit > 0)
-    {
-        uint8_t current_frame_length = length_to_transmit;
-        if (length_to_transmit > 127)
-            current_frame_length = 127;
-
-        char *frame;
-        frame = (char *)malloc(6 + current_frame_length);
-        frame[0] = SOF_MARKER;
-        frame[1] = (0x1 << 2) + 1;
-        frame[2] = FT_UIH;
-        frame[3] = (current_frame_length << 1) + 1;
-        memcpy(&frame[4], &data[length - length_to_transmit], current_frame_length);
-        frame[4 + current_frame_length] = 0xFF - crc8(&frame[1], 3, FCS_POLYNOMIAL, FCS_INIT_VALUE, true);
-        frame[5 + current_frame_length] = SOF_MARKER;
-        /* Calculate timeout clock tick */
-        /* Reset runtime information */
-        uart_write_bytes(esp_dte->uart_port, frame, 6 + current_frame_length);
-        ESP_LOGD(MODEM_TAG, ">>>> Send %d", current_frame_length);
-        free(frame);
-        length_to_transmit -= current_frame_length;
+    modem_dce_t *dce = esp_dte->parent.dce;
+#if CONFIG_COMPONENT_MODEM_PPP_REASSEMBLY
+    esp_dte->ppp_len = 0;
+#endif
+    for (int i = 0; i < CMUX_LINE_DLCIS; i++) {
+        esp_dte->dlci_lines[i].len = 0;
+    }
+    /* Undo the channel switch done by CMUX setup */
+    esp_dte->parent.send_cmd = esp_modem_dte_send_cmd;
+    esp_dte->parent.send_data = esp_modem_dte_send_data;
+    /* Drop a completion which nobody waits for any more */
+    xSemaphoreTake(esp_dte->process_sem, 0);
+    if (dce) {
+        dce->handle_line = NULL;
+        dce->handle_cmux_frame = NULL;
+        dce->state = MODEM_STATE_FAIL;
+        dce->mode = MODEM_COMMAND_MODE;
     }
-    return length;
-err:
-    return -1;
 }
 
 /**
- * @brief Send data and wait for prompt from DCE
+ * @brief Send a multiplexer flow control command on the control channel
  *
- * @param dte Modem DTE object
- * @param data data buffer
- * @param length length of data to send
- * @param prompt pointer of specific prompt
- * @param timeout timeout value (unit: ms)
+ * @param esp_dte ESP32 Modem DTE object
+ * @param throttle true for FCoff, false for FCon
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_dte_send_cmux_flow_ctrl(esp_modem_dte_t *esp_dte, bool throttle)
+{
+    const uint8_t command[] = { ((throttle ? CMD_FCOFF : CMD_FCON) << 1) | CR | EA, (0 << 1) | EA };
+    uint8_t frame[sizeof(command) + CMUX_FRAME_OVERHEAD];
+    size_t len = esp_modem_cmux_encode(frame, sizeof(frame), (0 << 2) | CR | EA, FT_UIH, command, sizeof(command));
+    return esp_dte->transport->write(esp_dte->transport, frame, len) == len ? ESP_OK : ESP_FAIL;
+}
+
+/**
+ * @brief Stop or resume the DCE depending on how full the receive buffer is
+ *
+ * Hardware flow control drives RTS from the receive buffer level, not only from
+ * the FIFO. Software flow control sends XOFF/XON in command mode and the CMUX
+ * FCoff/FCon commands in CMUX mode, where XON/XOFF bytes are part of the data.
+ * Raw PPP may carry XON/XOFF as data too, so it is not throttled in band.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param throttle true to stop the DCE, false to resume it
+ */
+static void esp_dte_set_rx_throttle(esp_modem_dte_t *esp_dte, bool throttle)
+{
+    esp_modem_transport_t *transport = esp_dte->transport;
+    esp_err_t err = ESP_ERR_NOT_SUPPORTED;
+    if (esp_dte->rx_throttled == throttle) {
+        return;
+    }
+    if (esp_dte->parent.flow_ctrl == MODEM_FLOW_CONTROL_HW) {
+        if (transport->set_rx_throttle) {
+            err = transport->set_rx_throttle(transport, throttle);
+        }
+    } else if (esp_dte->parent.flow_ctrl == MODEM_FLOW_CONTROL_SW) {
+        if (esp_dte->mode == ESP_MODEM_TRANSPORT_MODE_LINE) {
+            char c = throttle ? SW_FLOW_XOFF : SW_FLOW_XON;
+            err = transport->write(transport, &c, 1) == 1 ? ESP_OK : ESP_FAIL;
+        } else if (esp_dte->parent.cmux) {
+            err = esp_dte_send_cmux_flow_ctrl(esp_dte, throttle);
+        }
+    }
+    if (err == ESP_OK) {
+        ESP_LOGD(MODEM_TAG, "RX %s", throttle ? "throttled" : "resumed");
+        esp_dte->rx_throttled = throttle;
+        if (throttle) {
+            esp_dte->rx_stats.throttles++;
+        }
+    }
+}
+
+static inline void esp_dte_pm_acquire(esp_modem_dte_t *esp_dte)
+{
+#if CONFIG_PM_ENABLE
+    if (esp_dte->pm_lock) {
+        esp_pm_lock_acquire(esp_dte->pm_lock);
+    }
+#endif
+}
+
+static inline void esp_dte_pm_release(esp_modem_dte_t *esp_dte)
+{
+#if CONFIG_PM_ENABLE
+    if (esp_dte->pm_lock) {
+        esp_pm_lock_release(esp_dte->pm_lock);
+    }
+#endif
+}
+
+/**
+ * @brief Ring indicator interrupt, keeps the chip awake for the URC which follows
+ *
+ * @param arg ESP32 Modem DTE object
+ */
+static void IRAM_ATTR esp_dte_ri_isr(void *arg)
+{
+    esp_modem_dte_t *esp_dte = (esp_modem_dte_t *)arg;
+    /* Level triggered as the light sleep wakeup needs, masked until RI is released */
+    gpio_intr_disable(esp_dte->ri_io_num);
+    if (!esp_dte->ri_pending) {
+        esp_dte_pm_acquire(esp_dte);
+        esp_dte->ri_pending = true;
+    }
+}
+
+/**
+ * @brief Block or allow light sleep after a transport event, called from the receiving task
+ *
+ * Light sleep is blocked in data and CMUX mode, while a command waits for its
+ * response and for wake_hold_ms after a wakeup or received data.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param event transport event just processed
+ */
+static void esp_dte_update_sleep(esp_modem_dte_t *esp_dte, esp_modem_transport_event_t event)
+{
+    modem_dce_t *dce = esp_dte->parent.dce;
+    int64_t now = esp_timer_get_time();
+    int64_t hold_us = (int64_t)esp_dte->wake_hold_ms * 1000;
+    bool rx = event == ESP_MODEM_TRANSPORT_EVENT_DATA || event == ESP_MODEM_TRANSPORT_EVENT_LINE;
+    if (esp_dte->ri_pending) {
+        /* Take over the hold of the interrupt */
+        if (!esp_dte->awake) {
+            esp_dte_pm_acquire(esp_dte);
+            esp_dte->awake = true;
+        }
+        esp_dte->ri_pending = false;
+        esp_dte_pm_release(esp_dte);
+        esp_dte->ri_masked = true;
+        esp_dte->wake_stats.ri_wakeups++;
+        esp_dte->wake_window_until = now + hold_us;
+    } else if (rx && !esp_dte->awake) {
+        /* First data since sleep was allowed, the UART kept receiving if it woke the chip */
+        if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_UART) {
+            esp_dte->wake_stats.uart_wakeups++;
+            esp_dte->wake_window_until = now + hold_us;
+        } else {
+            esp_dte->wake_stats.idle_rx++;
+        }
+        esp_dte_pm_acquire(esp_dte);
+        esp_dte->awake = true;
+    }
+    if (esp_dte->ri_masked && gpio_get_level(esp_dte->ri_io_num)) {
+        esp_dte->ri_masked = false;
+        gpio_intr_enable(esp_dte->ri_io_num);
+    }
+    if (event == ESP_MODEM_TRANSPORT_EVENT_LINE && now < esp_dte->wake_window_until) {
+        esp_dte->wake_stats.wake_lines++;
+    }
+    if (rx || esp_dte->mode != ESP_MODEM_TRANSPORT_MODE_LINE || (dce && dce->state == MODEM_STATE_PROCESSING)) {
+        esp_dte->awake_until = now + hold_us;
+    }
+    if (esp_dte->awake && now >= esp_dte->awake_until) {
+        esp_dte->awake = false;
+        esp_dte->wake_stats.sleep_allowed++;
+        esp_dte_pm_release(esp_dte);
+    }
+}
+
+/**
+ * @brief Wait for one transport event and process it
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ */
+static void esp_dte_poll_transport(esp_modem_dte_t *esp_dte)
+{
+    esp_modem_transport_t *transport = esp_dte->transport;
+    size_t len = 0;
+    esp_modem_transport_event_t event = transport->wait(transport, &len, 100);
+    int64_t start = esp_timer_get_time();
+    uint64_t handler_busy_us = esp_dte->rx_stats.handler_busy_us;
+    switch (event) {
+    case ESP_MODEM_TRANSPORT_EVENT_DATA:
+        esp_dte->rx_stats.data_events++;
+        esp_dte->rx_stats.data_bytes += len;
+#if CONFIG_COMPONENT_MODEM_RX_MODERATION
+        if (esp_dte->mode == ESP_MODEM_TRANSPORT_MODE_DATA) {
+            esp_dte_update_rx_moderation(esp_dte, len);
+        }
+#endif
+        if (esp_dte->parent.flow_ctrl != MODEM_FLOW_CONTROL_NONE && len >= esp_dte->rx_throttle_high) {
+            esp_dte_set_rx_throttle(esp_dte, true);
+        }
+        len -= MIN(len, esp_handle_uart_data(esp_dte, len));
+        if (esp_dte->rx_throttled && len <= esp_dte->rx_throttle_low) {
+            esp_dte_set_rx_throttle(esp_dte, false);
+        }
+        break;
+    case ESP_MODEM_TRANSPORT_EVENT_LINE:
+        esp_handle_uart_pattern(esp_dte, len);
+        break;
+    case ESP_MODEM_TRANSPORT_EVENT_WAKEUP:
+        if (esp_dte->reset_requested) {
+            esp_dte->reset_requested = false;
+            esp_dte_reset_rx(esp_dte);
+            /* Queued behind any record received before the reset */
+            esp_dte_deliver_rx_item(esp_dte, ESP_DTE_RX_RESET, NULL, 0);
+        }
+        break;
+    case ESP_MODEM_TRANSPORT_EVENT_NONE:
+        /* Nothing left to read */
+        if (esp_dte->rx_throttled) {
+            esp_dte_set_rx_throttle(esp_dte, false);
+        }
+        break;
+    default:
+        break;
+    }
+    if (esp_dte->wake_enabled) {
+        esp_dte_update_sleep(esp_dte, event);
+    }
+    uint64_t busy_us = esp_timer_get_time() - start;
+    /* Without the RX pipeline the handlers ran from here, keep their time apart */
+    if (!esp_dte->rx_queue) {
+        busy_us -= esp_dte->rx_stats.handler_busy_us - handler_busy_us;
+    }
+    esp_dte->rx_stats.rx_busy_us += busy_us;
+}
+
+/**
+ * @brief UART Event Task Entry
+ *
+ * @param param task parameter
+ */
+static void uart_event_task_entry(void *param)
+{
+    esp_modem_dte_t *esp_dte = (esp_modem_dte_t *)param;
+    while (1) {
+        if (esp_dte->rx_queue) {
+            /* The RX task reads the transport, only run the handlers here */
+            size_t len = xMessageBufferReceive(esp_dte->rx_queue, esp_dte->rx_handle_buffer,
+                                               esp_dte->line_buffer_size, pdMS_TO_TICKS(100));
+            if (len) {
+                esp_dte->rx_handle_buffer[len] = '\0';
+                esp_dte_handle_rx_item(esp_dte, esp_dte->rx_handle_buffer[0], &esp_dte->rx_handle_buffer[1], len - 1);
+            }
+            esp_event_loop_run(esp_dte->event_loop_hdl, 0);
+            continue;
+        }
+        esp_dte_poll_transport(esp_dte);
+        /* Drive the event loop */
+        esp_event_loop_run(esp_dte->event_loop_hdl, pdMS_TO_TICKS(50));
+    }
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief RX Task Entry, first stage of the RX pipeline
+ *
+ * @param param task parameter
+ */
+static void rx_task_entry(void *param)
+{
+    esp_modem_dte_t *esp_dte = (esp_modem_dte_t *)param;
+    while (1) {
+        esp_dte_poll_transport(esp_dte);
+    }
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Send command to DCE
+ *
+ * @param dte Modem DTE object
+ * @param command command string
+ * @param timeout timeout value, unit: ms
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_modem_dte_send_cmd(modem_dte_t *dte, const char *command, uint32_t timeout)
+{
+    esp_err_t ret = ESP_FAIL;
+    modem_dce_t *dce = dte->dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
+    MODEM_CHECK(command, "command is NULL", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    /* Calculate timeout clock tick */
+    /* Reset runtime information */
+    dce->state = MODEM_STATE_PROCESSING;
+    /* No light sleep before the response is in */
+    esp_dte_pm_acquire(esp_dte);
+    /* Send command via UART */
+    esp_dte->transport->write(esp_dte->transport, command, strlen(command));
+    /* Check timeout */
+    bool done = xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(timeout)) == pdTRUE;
+    esp_dte_pm_release(esp_dte);
+    MODEM_CHECK(done, "process command timeout", err);
+    ret = ESP_OK;
+err:
+    dce->handle_line = NULL;
+    return ret;
+}
+
+static esp_err_t esp_modem_dte_send_sabm(modem_dte_t *dte, uint8_t dlci, uint32_t timeout)
+{
+  esp_err_t ret = ESP_FAIL;
+  modem_dce_t *dce = dte->dce;
+  MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
+  esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+  uint8_t frame[CMUX_FRAME_OVERHEAD];
+  esp_modem_cmux_encode(frame, sizeof(frame), (dlci << 2) | CR | EA, FT_SABM | PF, NULL, 0);
+	/*printf("sabm > ");
+  for (uint8_t i = 0; i < 6; i++)
+    printf("%02x ", frame[i]);
+  printf("\n");*/
+  /* Calculate timeout clock tick */
+  /* Reset runtime information */
+  dce->state = MODEM_STATE_PROCESSING;
+  /* Send command via UART */
+  esp_dte->transport->write(esp_dte->transport, frame, sizeof(frame));
+  /* Check timeout */
+  MODEM_CHECK(xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(timeout)) == pdTRUE, "process command timeout", err);
+  ret = ESP_OK;
+err:
+  dce->handle_cmux_frame = NULL;
+  return ret;
+  //f9 03 2f 01 09 f9
+}
+
+/**
+ * @brief Send command to DCE
+ *
+ * @param dte Modem DTE object
+ * @param command command string
+ * @param timeout timeout value, unit: ms
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_modem_dte_send_cmux_cmd(modem_dte_t *dte, const char *command, uint32_t timeout)
+{
+    esp_err_t ret = ESP_FAIL;
+    modem_dce_t *dce = dte->dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
+    MODEM_CHECK(command, "command is NULL", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    /* On the stack, commands are sent all the time and must not fragment the heap */
+    uint8_t frame[CMUX_N1 + CMUX_FRAME_OVERHEAD];
+    uint8_t dlci = CMUX_DLCI_AT;
+		if (strcmp(command, "ATD*99***1#\r") == 0)
+		{
+			ESP_LOGI(MODEM_TAG, "Got ATD");
+			dlci = CMUX_DLCI_DATA;
+		}
+    size_t frame_len = esp_modem_cmux_encode_uih(frame, sizeof(frame), dlci, command, strlen(command));
+    MODEM_CHECK(frame_len, "command too long for one frame", err);
+    ESP_LOGD(MODEM_TAG, "> %s", command);
+    //printf("cmd > ");
+    //for (uint8_t i = 0; i < 6 + strlen(command); i++)
+    //  printf("%02x ", frame[i]);
+    //printf("\n");
+
+    /* Calculate timeout clock tick */
+    /* Reset runtime information */
+    dce->state = MODEM_STATE_PROCESSING;
+    /* No light sleep before the response is in */
+    esp_dte_pm_acquire(esp_dte);
+    /* Send command via UART */
+    esp_dte->transport->write(esp_dte->transport, frame, frame_len);
+	vTaskDelay(100 / portTICK_PERIOD_MS);
+    /* Check timeout */
+    bool done = xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(timeout)) == pdTRUE;
+    esp_dte_pm_release(esp_dte);
+    MODEM_CHECK(done, "process command timeout", err);
+    ret = ESP_OK;
+err:
+    dce->handle_cmux_frame = NULL;
+    return ret;
+}
+
+/**
+ * @brief Send data to DCE
+ *
+ * @param dte Modem DTE object
+ * @param data data buffer
+ * @param length length of data to send
+ * @return int actual length of data that has been send out
+ */
+static int esp_modem_dte_send_data(modem_dte_t *dte, const char *data, uint32_t length)
+{
+    MODEM_CHECK(data, "data is NULL", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+		/*printf("> ");
+		for (uint8_t i = 0; i < length; i++)
+			printf("%02x ", data[i]);
+		printf("\n");*/
+    return esp_dte->transport->write(esp_dte->transport, data, length);
+err:
+    return -1;
+}
+
+/**
+ * @brief Send one UIH frame on the data DLCI, must be called with tx_lock held
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param data payload
+ * @param length payload length, at most CMUX_N1
+ */
+static void esp_dte_send_cmux_frame(esp_modem_dte_t *esp_dte, const uint8_t *data, size_t length)
+{
+    size_t frame_len = esp_modem_cmux_encode_uih(esp_dte->tx_frame, sizeof(esp_dte->tx_frame), CMUX_DLCI_DATA,
+                       data, length);
+    esp_dte->transport->write(esp_dte->transport, esp_dte->tx_frame, frame_len);
+    ESP_LOGD(MODEM_TAG, ">>>> Send %d", length);
+    esp_dte->tx_stats.frames++;
+    esp_dte->tx_stats.payload_bytes += length;
+    esp_dte->tx_stats.overhead_bytes += CMUX_FRAME_OVERHEAD;
+}
+
+/**
+ * @brief Send the staged packets, must be called with tx_lock held
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ */
+static void esp_dte_flush_cmux_stage(esp_modem_dte_t *esp_dte)
+{
+    if (esp_dte->tx_stage_len) {
+        esp_dte_send_cmux_frame(esp_dte, esp_dte->tx_stage, esp_dte->tx_stage_len);
+        esp_dte->tx_stage_len = 0;
+    }
+    esp_timer_stop(esp_dte->tx_flush_timer);
+}
+
+static void esp_dte_tx_flush_timer_cb(void *arg)
+{
+    esp_modem_dte_t *esp_dte = (esp_modem_dte_t *)arg;
+    xSemaphoreTake(esp_dte->tx_lock, portMAX_DELAY);
+    esp_dte_flush_cmux_stage(esp_dte);
+    xSemaphoreGive(esp_dte->tx_lock);
+}
+
+/**
+ * @brief Send CMUX data to DCE
+ *
+ * A packet smaller than N1 is staged instead of sent when the transport is
+ * still busy with earlier data (or others are already staged), so that
+ * consecutive small packets share one frame. The stage is sent when it would
+ * overflow, when a large packet follows, or once the transport has had time
+ * to drain. A packet on an idle line is sent at once.
+ *
+ * @param dte Modem DTE object
+ * @param data data buffer
+ * @param length length of data to send
+ * @return int actual length of data that has been send out
+ */
+static int esp_modem_dte_send_cmux_data(modem_dte_t *dte, const char *data, uint32_t length)
+{
+    MODEM_CHECK(data, "data is NULL", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    esp_modem_transport_t *transport = esp_dte->transport;
+    xSemaphoreTake(esp_dte->tx_lock, portMAX_DELAY);
+    esp_dte->tx_stats.packets++;
+    if (esp_dte->tx_stage_len + length > CMUX_N1) {
+        esp_dte_flush_cmux_stage(esp_dte);
+    }
+#if CONFIG_COMPONENT_MODEM_CMUX_TX_COALESCE
+    if (length < CMUX_N1 && (esp_dte->tx_stage_len || (transport->tx_idle && !transport->tx_idle(transport)))) {
+        if (esp_dte->tx_stage_len) {
+            esp_dte->tx_stats.coalesced_packets++;
+        } else {
+            /* time to send one full frame, by then the transport has room again */
+            uint64_t drain_us = (uint64_t)(CMUX_N1 + CMUX_FRAME_OVERHEAD) * 10 * 1000000 / esp_dte->baud_rate;
+            esp_timer_start_once(esp_dte->tx_flush_timer, drain_us);
+        }
+        memcpy(&esp_dte->tx_stage[esp_dte->tx_stage_len], data, length);
+        esp_dte->tx_stage_len += length;
+        xSemaphoreGive(esp_dte->tx_lock);
+        return length;
+    }
+#endif
+    esp_dte_flush_cmux_stage(esp_dte);
+    for (uint32_t offset = 0; offset < length; offset += CMUX_N1) {
+        esp_dte_send_cmux_frame(esp_dte, (const uint8_t *)&data[offset], MIN(length - offset, CMUX_N1));
+    }
+    xSemaphoreGive(esp_dte->tx_lock);
+    return length;
+err:
+    return -1;
+}
+
+/**
+ * @brief Account an allocation of the DTE in the memory report
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param mem_class memory class
+ * @param ptr memory allocated or about to be freed
+ * @param add true on allocation, false on free
+ */
+static void esp_dte_mem_account(esp_modem_dte_t *esp_dte, esp_modem_mem_class_t mem_class, void *ptr, bool add)
+{
+    esp_modem_mem_report_t *report = &esp_dte->mem_report;
+    size_t size = heap_caps_get_allocated_size(ptr);
+    bool external = esp_ptr_external_ram(ptr);
+    size_t *bytes = external ? &report->external_bytes[mem_class] : &report->internal_bytes[mem_class];
+    size_t *peak = external ? &report->external_peak : &report->internal_peak;
+    size_t *region = external ? report->external_bytes : report->internal_bytes;
+    portENTER_CRITICAL(&esp_dte->mem_lock);
+    if (add) {
+        *bytes += size;
+        size_t total = 0;
+        for (int i = 0; i < ESP_MODEM_MEM_CLASSES; i++) {
+            total += region[i];
+        }
+        *peak = MAX(*peak, total);
+    } else {
+        *bytes -= size;
+    }
+    portEXIT_CRITICAL(&esp_dte->mem_lock);
+}
+
+/**
+ * @brief Allocate memory of a class
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param mem_class memory class
+ * @param size bytes to allocate
+ * @return pointer to the memory, NULL on failure
+ */
+static void *esp_dte_malloc(esp_modem_dte_t *esp_dte, esp_modem_mem_class_t mem_class, size_t size)
+{
+    uint32_t caps = esp_dte->mem_caps[mem_class];
+    void *ptr = heap_caps_malloc(size, caps);
+    if (!ptr && (caps & MALLOC_CAP_SPIRAM)) {
+        /* No PSRAM on this board, or it is full: the buffer works from internal RAM too */
+        ptr = heap_caps_malloc(size, ESP_MODEM_MEM_CAPS_INTERNAL);
+        if (ptr) {
+            portENTER_CRITICAL(&esp_dte->mem_lock);
+            esp_dte->mem_report.fallbacks++;
+            portEXIT_CRITICAL(&esp_dte->mem_lock);
+        }
+    }
+    if (!ptr) {
+        portENTER_CRITICAL(&esp_dte->mem_lock);
+        esp_dte->mem_report.failures++;
+        portEXIT_CRITICAL(&esp_dte->mem_lock);
+        return NULL;
+    }
+    esp_dte_mem_account(esp_dte, mem_class, ptr, true);
+    return ptr;
+}
+
+/**
+ * @brief Free memory allocated by esp_dte_malloc()
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param mem_class memory class given to esp_dte_malloc()
+ * @param ptr memory to free, may be NULL
+ */
+static void esp_dte_free(esp_modem_dte_t *esp_dte, esp_modem_mem_class_t mem_class, void *ptr)
+{
+    if (ptr) {
+        esp_dte_mem_account(esp_dte, mem_class, ptr, false);
+        heap_caps_free(ptr);
+    }
+}
+
+/**
+ * @brief Send data and wait for prompt from DCE
+ *
+ * @param dte Modem DTE object
+ * @param data data buffer
+ * @param length length of data to send
+ * @param prompt pointer of specific prompt
+ * @param timeout timeout value (unit: ms)
  * @return esp_err_t
  *      ESP_OK on success
  *      ESP_FAIL on error
@@ -587,21 +1331,22 @@ static esp_err_t esp_modem_dte_send_wait(modem_dte_t *dte, const char *data, uin
     MODEM_CHECK(prompt, "prompt is NULL", err_param);
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
     // We'd better disable pattern detection here for a moment in case prompt string contains the pattern character
-    uart_disable_pattern_det_intr(esp_dte->uart_port);
-    // uart_disable_rx_intr(esp_dte->uart_port);
-    MODEM_CHECK(uart_write_bytes(esp_dte->uart_port, data, length) >= 0, "uart write bytes failed", err_write);
+    esp_dte_set_mode(esp_dte, ESP_MODEM_TRANSPORT_MODE_PAUSED);
+    MODEM_CHECK(esp_dte->transport->write(esp_dte->transport, data, length) >= 0, "uart write bytes failed", err_write);
     uint32_t len = strlen(prompt);
-    uint8_t *buffer = calloc(len + 1, sizeof(uint8_t));
-    int res = uart_read_bytes(esp_dte->uart_port, buffer, len, pdMS_TO_TICKS(timeout));
+    uint8_t *buffer = esp_dte_malloc(esp_dte, ESP_MODEM_MEM_TX, len + 1);
+    MODEM_CHECK(buffer, "malloc prompt buffer failed", err_write);
+    memset(buffer, 0, len + 1);
+    int res = esp_dte->transport->read(esp_dte->transport, buffer, len, timeout);
     MODEM_CHECK(res >= len, "wait prompt [%s] timeout", err, prompt);
     MODEM_CHECK(!strncmp(prompt, (const char *)buffer, len), "get wrong prompt: %s", err, buffer);
-    free(buffer);
-    uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
+    esp_dte_free(esp_dte, ESP_MODEM_MEM_TX, buffer);
+    esp_dte_set_mode(esp_dte, ESP_MODEM_TRANSPORT_MODE_LINE);
     return ESP_OK;
 err:
-    free(buffer);
+    esp_dte_free(esp_dte, ESP_MODEM_MEM_TX, buffer);
 err_write:
-    uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
+    esp_dte_set_mode(esp_dte, ESP_MODEM_TRANSPORT_MODE_LINE);
 err_param:
     return ESP_FAIL;
 }
@@ -625,20 +1370,20 @@ static esp_err_t esp_modem_dte_change_mode(modem_dte_t *dte, modem_mode_t new_mo
     case MODEM_PPP_MODE:
         ESP_LOGI(MODEM_TAG, "PPP MODE");
         MODEM_CHECK(dce->set_working_mode(dce, new_mode) == ESP_OK, "set new working mode:%d failed", err, new_mode);
-        uart_disable_pattern_det_intr(esp_dte->uart_port);
-        uart_enable_rx_intr(esp_dte->uart_port);
+        esp_modem_mark_phase(dte, ESP_MODEM_PHASE_DIAL);
+        esp_dte_set_mode(esp_dte, ESP_MODEM_TRANSPORT_MODE_DATA);
         break;
     case MODEM_COMMAND_MODE:
-        uart_disable_rx_intr(esp_dte->uart_port);
-        uart_flush(esp_dte->uart_port);
-        uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
-//        uart_pattern_queue_reset(esp_dte->uart_port, esp_dte->pattern_queue_size);
+        esp_dte_set_mode(esp_dte, ESP_MODEM_TRANSPORT_MODE_PAUSED);
+        esp_dte->transport->flush(esp_dte->transport);
+        esp_dte->buffer_len = 0;
+        esp_dte_set_mode(esp_dte, ESP_MODEM_TRANSPORT_MODE_LINE);
         MODEM_CHECK(dce->set_working_mode(dce, new_mode) == ESP_OK, "set new working mode:%d failed", err, new_mode);
         break;
     case MODEM_CMUX_MODE:
         MODEM_CHECK(dce->set_working_mode(dce, new_mode) == ESP_OK, "set new working mode:%d failed", err, new_mode);
-        uart_disable_pattern_det_intr(esp_dte->uart_port);
-        uart_enable_rx_intr(esp_dte->uart_port);
+        esp_modem_mark_phase(dte, ESP_MODEM_PHASE_CMUX_MODE);
+        esp_dte_set_mode(esp_dte, ESP_MODEM_TRANSPORT_MODE_DATA);
         dce->setup_cmux(dce);
          break;
     default:
@@ -655,6 +1400,98 @@ static esp_err_t esp_modem_dte_process_cmd_done(modem_dte_t *dte)
     return xSemaphoreGive(esp_dte->process_sem) == pdTRUE ? ESP_OK : ESP_FAIL;
 }
 
+/**
+ * @brief Mark the end of PPP negotiation in the timeline
+ *
+ */
+static void esp_dte_ip_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    esp_modem_dte_t *esp_dte = arg;
+    esp_modem_mark_phase(&esp_dte->parent, ESP_MODEM_PHASE_PPP_GOT_IP);
+}
+
+/**
+ * @brief Set up the ring indicator wakeup and the lock against light sleep
+ *
+ * The UART wakeup is set up by the transport.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param config DTE configuration
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_dte_wake_init(esp_modem_dte_t *esp_dte, const esp_modem_dte_config_t *config)
+{
+    esp_dte->ri_io_num = config->ri_io_num;
+    esp_dte->wake_hold_ms = config->wake_hold_ms;
+#if CONFIG_PM_ENABLE
+    MODEM_CHECK(esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "modem_rx", &esp_dte->pm_lock) == ESP_OK,
+                "create pm lock failed", err);
+#endif
+    /* Awake until the receiving task finds the line idle */
+    esp_dte_pm_acquire(esp_dte);
+    esp_dte->awake = true;
+    esp_dte->awake_until = esp_timer_get_time() + (int64_t)config->wake_hold_ms * 1000;
+    if (config->ri_io_num != UART_PIN_NO_CHANGE) {
+        gpio_config_t io_config = {
+            .pin_bit_mask = 1ULL << config->ri_io_num,
+            .mode = GPIO_MODE_INPUT,
+            .pull_up_en = GPIO_PULLUP_ENABLE,
+            .pull_down_en = GPIO_PULLDOWN_DISABLE,
+            .intr_type = GPIO_INTR_LOW_LEVEL,
+        };
+        MODEM_CHECK(gpio_config(&io_config) == ESP_OK, "config ri gpio failed", err_gpio);
+        /* Already installed by the application is fine */
+        esp_err_t res = gpio_install_isr_service(0);
+        MODEM_CHECK(res == ESP_OK || res == ESP_ERR_INVALID_STATE, "install gpio isr service failed", err_gpio);
+        MODEM_CHECK(gpio_isr_handler_add(config->ri_io_num, esp_dte_ri_isr, esp_dte) == ESP_OK,
+                    "add ri isr handler failed", err_gpio);
+        MODEM_CHECK(gpio_wakeup_enable(config->ri_io_num, GPIO_INTR_LOW_LEVEL) == ESP_OK &&
+                    esp_sleep_enable_gpio_wakeup() == ESP_OK, "enable ri wakeup failed", err_wakeup);
+    }
+    esp_dte->wake_enabled = true;
+    return ESP_OK;
+err_wakeup:
+    gpio_isr_handler_remove(config->ri_io_num);
+err_gpio:
+    esp_dte_pm_release(esp_dte);
+    esp_dte->awake = false;
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_delete(esp_dte->pm_lock);
+    esp_dte->pm_lock = NULL;
+err:
+#endif
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Remove the ring indicator wakeup and the lock against light sleep, the receiving tasks are gone
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ */
+static void esp_dte_wake_deinit(esp_modem_dte_t *esp_dte)
+{
+    if (!esp_dte->wake_enabled) {
+        return;
+    }
+    if (esp_dte->ri_io_num != UART_PIN_NO_CHANGE) {
+        gpio_wakeup_disable(esp_dte->ri_io_num);
+        gpio_isr_handler_remove(esp_dte->ri_io_num);
+    }
+    if (esp_dte->ri_pending) {
+        esp_dte_pm_release(esp_dte);
+    }
+    if (esp_dte->awake) {
+        esp_dte_pm_release(esp_dte);
+    }
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_delete(esp_dte->pm_lock);
+    esp_dte->pm_lock = NULL;
+#endif
+    esp_dte->wake_enabled = false;
+}
+
 /**
  * @brief Deinitialize a Modem DTE object
  *
@@ -666,16 +1503,35 @@ static esp_err_t esp_modem_dte_process_cmd_done(modem_dte_t *dte)
 static esp_err_t esp_modem_dte_deinit(modem_dte_t *dte)
 {
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    esp_event_handler_unregister(IP_EVENT, IP_EVENT_PPP_GOT_IP, esp_dte_ip_event_handler);
     /* Delete UART event task */
     vTaskDelete(esp_dte->uart_event_task_hdl);
+    if (esp_dte->rx_task_hdl) {
+        vTaskDelete(esp_dte->rx_task_hdl);
+        vMessageBufferDelete(esp_dte->rx_queue);
+        esp_dte_free(esp_dte, ESP_MODEM_MEM_BULK, esp_dte->rx_queue_storage);
+    }
+    esp_dte_wake_deinit(esp_dte);
     /* Delete semaphore */
     vSemaphoreDelete(esp_dte->process_sem);
+    vSemaphoreDelete(esp_dte->reset_sem);
+    esp_timer_stop(esp_dte->tx_flush_timer);
+    esp_timer_delete(esp_dte->tx_flush_timer);
+    vSemaphoreDelete(esp_dte->tx_lock);
     /* Delete event loop */
     esp_event_loop_delete(esp_dte->event_loop_hdl);
-    /* Uninstall UART Driver */
-    uart_driver_delete(esp_dte->uart_port);
+    /* Close the transport (uninstalls the UART driver) */
+    esp_dte->transport->deinit(esp_dte->transport);
     /* Free memory */
-    free(esp_dte->buffer);
+#if CONFIG_COMPONENT_MODEM_PPP_REASSEMBLY
+    esp_dte_free(esp_dte, ESP_MODEM_MEM_RX, esp_dte->ppp_buffer);
+#endif
+    for (int i = 0; i < CMUX_LINE_DLCIS; i++) {
+        esp_dte_free(esp_dte, ESP_MODEM_MEM_RX, esp_dte->dlci_lines[i].buffer);
+    }
+    esp_dte_free(esp_dte, ESP_MODEM_MEM_RX, esp_dte->buffer);
+    esp_dte_free(esp_dte, ESP_MODEM_MEM_RX, esp_dte->rx_item);
+    esp_dte_free(esp_dte, ESP_MODEM_MEM_RX, esp_dte->rx_handle_buffer);
     if (dte->dce) {
         dte->dce->dte = NULL;
     }
@@ -685,21 +1541,96 @@ static esp_err_t esp_modem_dte_deinit(modem_dte_t *dte)
 
 
 
+/**
+ * @brief Get the DCE out of PPP and CMUX mode, whatever state it is in
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ */
+static void esp_dte_leave_data_mode(esp_modem_dte_t *esp_dte)
+{
+    /* The escape sequence only counts with silence on both sides (S12) */
+    vTaskDelay(pdMS_TO_TICKS(ESP_MODEM_ESCAPE_GUARD_MS));
+    esp_dte->transport->write(esp_dte->transport, "+++", 3);
+    vTaskDelay(pdMS_TO_TICKS(ESP_MODEM_ESCAPE_GUARD_MS));
+    /* CMUX close down on DLCI 0 */
+    char cmd_cld[8] = {0xf9, 0x03, 0xef, 0x05, 0xc3, 0x01, 0xf2, 0xf9};
+    esp_dte->transport->write(esp_dte->transport, cmd_cld, 8);
+}
+
+/**
+ * @brief Apply the buffer sizes saved by esp_modem_save_buffer_sizes() to a copy of the configuration
+ *
+ * @param config configuration passed to init
+ * @param saved_config copy with the saved sizes
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - error code of the NVS API if nothing was saved
+ */
+static esp_err_t esp_dte_load_buffer_sizes(const esp_modem_dte_config_t *config, esp_modem_dte_config_t *saved_config)
+{
+    nvs_handle_t nvs;
+    esp_modem_buffer_sizes_t sizes;
+    size_t size = sizeof(sizes);
+    esp_err_t err = nvs_open(ESP_MODEM_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_get_blob(nvs, ESP_MODEM_NVS_BUFFER_SIZES_KEY, &sizes, &size);
+    nvs_close(nvs);
+    if (err != ESP_OK || size != sizeof(sizes)) {
+        return err != ESP_OK ? err : ESP_ERR_INVALID_SIZE;
+    }
+    *saved_config = *config;
+    saved_config->rx_buffer_size = sizes.rx_buffer_size;
+    saved_config->tx_buffer_size = sizes.tx_buffer_size;
+    saved_config->event_queue_size = sizes.event_queue_size;
+    saved_config->pattern_queue_size = sizes.pattern_queue_size;
+    saved_config->line_buffer_size = sizes.line_buffer_size;
+    ESP_LOGI(MODEM_TAG, "Saved buffer sizes: rx %d, tx %d, events %d, patterns %d, line %d",
+             sizes.rx_buffer_size, sizes.tx_buffer_size, sizes.event_queue_size,
+             sizes.pattern_queue_size, sizes.line_buffer_size);
+    return ESP_OK;
+}
+
 modem_dte_t *esp_modem_dte_init(const esp_modem_dte_config_t *config)
 {
-    esp_err_t res;
+    int64_t start_us = esp_timer_get_time();
+    esp_modem_dte_config_t saved_config;
+    if (config->use_saved_buffer_sizes && esp_dte_load_buffer_sizes(config, &saved_config) == ESP_OK) {
+        config = &saved_config;
+    }
     /* malloc memory for esp_dte object */
     esp_modem_dte_t *esp_dte = calloc(1, sizeof(esp_modem_dte_t));
     MODEM_CHECK(esp_dte, "calloc esp_dte failed", err_dte_mem);
+    esp_dte->timeline.start_us = start_us;
+    portMUX_TYPE mem_lock = portMUX_INITIALIZER_UNLOCKED;
+    esp_dte->mem_lock = mem_lock;
+    memcpy(esp_dte->mem_caps, config->mem_caps, sizeof(esp_dte->mem_caps));
+    esp_dte->buffer_sizes.rx_buffer_size = config->rx_buffer_size;
+    esp_dte->buffer_sizes.tx_buffer_size = config->tx_buffer_size;
+    esp_dte->buffer_sizes.event_queue_size = config->event_queue_size;
+    esp_dte->buffer_sizes.pattern_queue_size = config->pattern_queue_size;
+    esp_dte->buffer_sizes.line_buffer_size = config->line_buffer_size;
+    esp_dte->rx_throttle_high = config->rx_buffer_size * CONFIG_COMPONENT_MODEM_RX_THROTTLE_HIGH_PERCENT / 100;
+    esp_dte->rx_throttle_low = config->rx_buffer_size * CONFIG_COMPONENT_MODEM_RX_THROTTLE_LOW_PERCENT / 100;
     /* malloc memory to storing lines from modem dce */
     esp_dte->line_buffer_size = config->line_buffer_size;
-    esp_dte->buffer = calloc(1, config->line_buffer_size);
-    MODEM_CHECK(esp_dte->buffer, "calloc line memory failed", err_line_mem);
+    esp_dte->buffer = esp_dte_malloc(esp_dte, ESP_MODEM_MEM_RX, config->line_buffer_size);
+    MODEM_CHECK(esp_dte->buffer, "malloc line memory failed", err_line_mem);
+    memset(esp_dte->buffer, 0, config->line_buffer_size);
+#if CONFIG_COMPONENT_MODEM_PPP_REASSEMBLY
+    esp_dte->ppp_buffer = esp_dte_malloc(esp_dte, ESP_MODEM_MEM_RX, CONFIG_COMPONENT_MODEM_PPP_REASSEMBLY_SIZE);
+    MODEM_CHECK(esp_dte->ppp_buffer, "malloc ppp reassembly buffer failed", err_uart_config);
+#endif
+    for (int i = CMUX_DLCI_DATA; i < CMUX_LINE_DLCIS; i++) {
+        esp_dte->dlci_lines[i].buffer = esp_dte_malloc(esp_dte, ESP_MODEM_MEM_RX, config->line_buffer_size);
+        MODEM_CHECK(esp_dte->dlci_lines[i].buffer, "malloc dlci line memory failed", err_uart_config);
+    }
 
     esp_dte->buffer_len = 0;
 
     /* Set attributes */
-    esp_dte->uart_port = config->port_num;
+    esp_dte->baud_rate = config->baud_rate;
     esp_dte->parent.flow_ctrl = config->flow_control;
     /* Bind methods */
     esp_dte->parent.send_cmd = esp_modem_dte_send_cmd;
@@ -713,47 +1644,15 @@ modem_dte_t *esp_modem_dte_init(const esp_modem_dte_config_t *config)
     esp_dte->parent.deinit = esp_modem_dte_deinit;
     esp_dte->parent.cmux = config->cmux;
 
-    /* Config UART */
-    uart_config_t uart_config = {
-        .baud_rate = config->baud_rate,
-        .data_bits = config->data_bits,
-        .parity = config->parity,
-        .stop_bits = config->stop_bits,
-        .source_clk = UART_SCLK_REF_TICK,
-        .flow_ctrl = (config->flow_control == MODEM_FLOW_CONTROL_HW) ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE
-    };
-    MODEM_CHECK(uart_param_config(esp_dte->uart_port, &uart_config) == ESP_OK, "config uart parameter failed", err_uart_config);
-    if (config->flow_control == MODEM_FLOW_CONTROL_HW) {
-        res = uart_set_pin(esp_dte->uart_port, config->tx_io_num, config->rx_io_num,
-                           config->rts_io_num, config->cts_io_num);
-    } else {
-        res = uart_set_pin(esp_dte->uart_port, config->tx_io_num, config->rx_io_num,
-                           UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
-    }
-    MODEM_CHECK(res == ESP_OK, "config uart gpio failed", err_uart_config);
-    /* Set flow control threshold */
-    if (config->flow_control == MODEM_FLOW_CONTROL_HW) {
-        res = uart_set_hw_flow_ctrl(esp_dte->uart_port, UART_HW_FLOWCTRL_CTS_RTS, UART_FIFO_LEN - 8);
-    } else if (config->flow_control == MODEM_FLOW_CONTROL_SW) {
-        res = uart_set_sw_flow_ctrl(esp_dte->uart_port, true, 8, UART_FIFO_LEN - 8);
-    }
-    MODEM_CHECK(res == ESP_OK, "config uart flow control failed", err_uart_config);
-    /* Install UART driver and get event queue used inside driver */
-    res = uart_driver_install(esp_dte->uart_port, config->rx_buffer_size, config->tx_buffer_size,
-                              config->event_queue_size, &(esp_dte->event_queue), 0);
-    MODEM_CHECK(res == ESP_OK, "install uart driver failed", err_uart_config);
-    res = uart_set_rx_timeout(esp_dte->uart_port, 1);
-    MODEM_CHECK(res == ESP_OK, "set rx timeout failed", err_uart_config);
-
-    /* Set pattern interrupt, used to detect the end of a line. */
-    res = uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
-    /* Set pattern queue size */
-    esp_dte->pattern_queue_size = config->pattern_queue_size;
-    res |= uart_pattern_queue_reset(esp_dte->uart_port, config->pattern_queue_size);
-    /* Starting in command mode -> explicitly disable RX interrupt */
-    uart_disable_rx_intr(esp_dte->uart_port);
-
-    MODEM_CHECK(res == ESP_OK, "config uart pattern failed", err_uart_pattern);
+    /* Open the transport, the UART described by the configuration by default */
+    esp_dte->transport = config->transport ? config->transport : esp_modem_transport_uart_create();
+    MODEM_CHECK(esp_dte->transport, "create transport failed", err_uart_config);
+    MODEM_CHECK(esp_dte->transport->open(esp_dte->transport, config) == ESP_OK, "open transport failed", err_uart_pattern);
+    esp_dte->mode = ESP_MODEM_TRANSPORT_MODE_LINE;
+#if CONFIG_COMPONENT_MODEM_RX_MODERATION
+    esp_dte_set_rx_moderation(esp_dte, 0);
+    esp_dte->rx_window_start = esp_timer_get_time();
+#endif
     /* Create Event loop */
     esp_event_loop_args_t loop_args = {
         .queue_size = ESP_MODEM_EVENT_QUEUE_SIZE,
@@ -763,30 +1662,89 @@ modem_dte_t *esp_modem_dte_init(const esp_modem_dte_config_t *config)
     /* Create semaphore */
     esp_dte->process_sem = xSemaphoreCreateBinary();
     MODEM_CHECK(esp_dte->process_sem, "create process semaphore failed", err_sem);
+    esp_dte->reset_sem = xSemaphoreCreateBinary();
+    MODEM_CHECK(esp_dte->reset_sem, "create reset semaphore failed", err_reset_sem);
+    esp_dte->tx_lock = xSemaphoreCreateMutex();
+    MODEM_CHECK(esp_dte->tx_lock, "create tx lock failed", err_tx_lock);
+    esp_timer_create_args_t timer_args = {
+        .callback = esp_dte_tx_flush_timer_cb,
+        .arg = esp_dte,
+        .name = "modem_tx_flush"
+    };
+    MODEM_CHECK(esp_timer_create(&timer_args, &esp_dte->tx_flush_timer) == ESP_OK, "create tx flush timer failed", err_tx_timer);
+    if (config->rx_pipeline) {
+        esp_dte->rx_item = esp_dte_malloc(esp_dte, ESP_MODEM_MEM_RX, config->line_buffer_size);
+        esp_dte->rx_handle_buffer = esp_dte_malloc(esp_dte, ESP_MODEM_MEM_RX, config->line_buffer_size + 1);
+        MODEM_CHECK(esp_dte->rx_item && esp_dte->rx_handle_buffer, "malloc rx pipeline buffers failed", err_rx_mem);
+        /* The longest line must fit, together with the length word of the message buffer */
+        MODEM_CHECK(config->rx_queue_size >= config->line_buffer_size + sizeof(size_t),
+                    "rx queue size smaller than the line buffer", err_rx_mem);
+        /* FreeRTOS needs one byte more than the capacity */
+        esp_dte->rx_queue_storage = esp_dte_malloc(esp_dte, ESP_MODEM_MEM_BULK, config->rx_queue_size + 1);
+        MODEM_CHECK(esp_dte->rx_queue_storage, "malloc rx queue failed", err_rx_mem);
+        esp_dte->rx_queue = xMessageBufferCreateStatic(config->rx_queue_size, esp_dte->rx_queue_storage,
+                            &esp_dte->rx_queue_struct);
+    }
+    if (config->ri_io_num != UART_PIN_NO_CHANGE || config->uart_wakeup_threshold > 0) {
+        MODEM_CHECK(esp_dte_wake_init(esp_dte, config) == ESP_OK, "init wakeup sources failed", err_wake);
+    }
     /* Create UART Event task */
-    BaseType_t ret = xTaskCreate(uart_event_task_entry,             //Task Entry
-                                 "uart_event",              //Task Name
-                                 config->event_task_stack_size,           //Task Stack Size(Bytes)
-                                 esp_dte,                           //Task Parameter
-                                 config->event_task_priority,             //Task Priority
-                                 & (esp_dte->uart_event_task_hdl)   //Task Handler
-                                );
+    BaseType_t ret = xTaskCreatePinnedToCore(uart_event_task_entry,             //Task Entry
+                                             "uart_event",              //Task Name
+                                             config->event_task_stack_size,           //Task Stack Size(Bytes)
+                                             esp_dte,                           //Task Parameter
+                                             config->event_task_priority,             //Task Priority
+                                             & (esp_dte->uart_event_task_hdl),  //Task Handler
+                                             config->event_task_core            //Core
+                                            );
     MODEM_CHECK(ret == pdTRUE, "create uart event task failed", err_tsk_create);
-    uart_write_bytes(esp_dte->uart_port, "+++", 3);
-    char cmd_cld[8] = {0xf9, 0x03, 0xef, 0x05, 0xc3, 0x01, 0xf2, 0xf9};
-    uart_write_bytes(esp_dte->uart_port, cmd_cld, 8);
+    if (config->rx_pipeline) {
+        /* Create RX task, it only reads the transport and decodes lines and frames */
+        ret = xTaskCreatePinnedToCore(rx_task_entry, "modem_rx", config->rx_task_stack_size, esp_dte,
+                                      config->rx_task_priority, &esp_dte->rx_task_hdl, config->rx_task_core);
+        MODEM_CHECK(ret == pdTRUE, "create rx task failed", err_rx_tsk_create);
+    }
+    esp_modem_mark_phase(&esp_dte->parent, ESP_MODEM_PHASE_DTE_INIT);
+    /* Needs the default event loop, the timeline then just lacks the last phase */
+    if (esp_event_handler_register(IP_EVENT, IP_EVENT_PPP_GOT_IP, esp_dte_ip_event_handler, esp_dte) != ESP_OK) {
+        ESP_LOGD(MODEM_TAG, "no default event loop, PPP got IP is not timed");
+    }
+    esp_dte_leave_data_mode(esp_dte);
+    esp_modem_mark_phase(&esp_dte->parent, ESP_MODEM_PHASE_LEAVE_DATA);
     return &(esp_dte->parent);
     /* Error handling */
+err_rx_tsk_create:
+    vTaskDelete(esp_dte->uart_event_task_hdl);
 err_tsk_create:
+    esp_dte_wake_deinit(esp_dte);
+err_wake:
+    if (esp_dte->rx_queue) {
+        vMessageBufferDelete(esp_dte->rx_queue);
+    }
+err_rx_mem:
+    esp_dte_free(esp_dte, ESP_MODEM_MEM_BULK, esp_dte->rx_queue_storage);
+    esp_dte_free(esp_dte, ESP_MODEM_MEM_RX, esp_dte->rx_item);
+    esp_dte_free(esp_dte, ESP_MODEM_MEM_RX, esp_dte->rx_handle_buffer);
+    esp_timer_delete(esp_dte->tx_flush_timer);
+err_tx_timer:
+    vSemaphoreDelete(esp_dte->tx_lock);
+err_tx_lock:
+    vSemaphoreDelete(esp_dte->reset_sem);
+err_reset_sem:
     vSemaphoreDelete(esp_dte->process_sem);
 err_sem:
     esp_event_loop_delete(esp_dte->event_loop_hdl);
 err_eloop:
-    uart_disable_pattern_det_intr(esp_dte->uart_port);
 err_uart_pattern:
-    uart_driver_delete(esp_dte->uart_port);
+    esp_dte->transport->deinit(esp_dte->transport);
 err_uart_config:
-    free(esp_dte->buffer);
+#if CONFIG_COMPONENT_MODEM_PPP_REASSEMBLY
+    esp_dte_free(esp_dte, ESP_MODEM_MEM_RX, esp_dte->ppp_buffer);
+#endif
+    for (int i = 0; i < CMUX_LINE_DLCIS; i++) {
+        esp_dte_free(esp_dte, ESP_MODEM_MEM_RX, esp_dte->dlci_lines[i].buffer);
+    }
+    esp_dte_free(esp_dte, ESP_MODEM_MEM_RX, esp_dte->buffer);
 err_line_mem:
     free(esp_dte);
 err_dte_mem:
@@ -805,16 +1763,39 @@ esp_err_t esp_modem_remove_event_handler(modem_dte_t *dte, esp_event_handler_t h
     return esp_event_handler_unregister_with(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_EVENT_ANY_ID, handler);
 }
 
-esp_err_t esp_modem_start_ppp(modem_dte_t *dte)
+esp_err_t esp_modem_remove_event_handler_id(modem_dte_t *dte, esp_event_handler_t handler, int32_t event_id)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    return esp_event_handler_unregister_with(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, event_id, handler);
+}
+
+/**
+ * @brief Set the PDP context and dial
+ *
+ * @param dte Modem DTE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_dte_dial(modem_dte_t *dte)
 {
     modem_dce_t *dce = dte->dce;
     MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
-    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
     /* Set PDP Context */
     ESP_LOGI(MODEM_TAG, "APN: %s", CONFIG_COMPONENT_MODEM_APN);
     MODEM_CHECK(dce->define_pdp_context(dce, 1, "IP", CONFIG_COMPONENT_MODEM_APN) == ESP_OK, "set MODEM APN failed", err);
+    esp_modem_mark_phase(dte, ESP_MODEM_PHASE_PDP_CONTEXT);
     /* Enter PPP mode */
     MODEM_CHECK(dte->change_mode(dte, MODEM_PPP_MODE) == ESP_OK, "enter ppp mode failed", err);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_start_ppp(modem_dte_t *dte)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    MODEM_CHECK(esp_dte_dial(dte) == ESP_OK, "dial failed", err);
 
     /* post PPP mode started event */
     esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_PPP_START, NULL, 0, 0);
@@ -852,3 +1833,393 @@ esp_err_t esp_modem_stop_ppp(modem_dte_t *dte)
 err:
     return ESP_FAIL;
 }
+
+/**
+ * @brief Restart the protocol state of a DTE
+ *
+ * @param dte Modem DTE object
+ * @param stop_ppp post ESP_MODEM_EVENT_PPP_STOP if a PPP session was active
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_dte_reset(modem_dte_t *dte, bool stop_ppp)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    bool ppp_active = stop_ppp && dte->dce && dte->dce->mode == MODEM_PPP_MODE;
+    /* The parser state belongs to the event task, let it do the reset */
+    esp_dte->reset_requested = true;
+    MODEM_CHECK(esp_dte->transport->wakeup(esp_dte->transport) == ESP_OK, "wake up event task failed", err);
+    MODEM_CHECK(xSemaphoreTake(esp_dte->reset_sem, pdMS_TO_TICKS(ESP_MODEM_DTE_RESET_TIMEOUT_MS)) == pdTRUE,
+                "reset timeout", err);
+    if (ppp_active) {
+        esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_PPP_STOP, NULL, 0, 0);
+    }
+    esp_dte_leave_data_mode(esp_dte);
+    ESP_LOGI(MODEM_TAG, "DTE reset");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_dte_reset(modem_dte_t *dte)
+{
+    return esp_dte_reset(dte, true);
+}
+
+/**
+ * @brief Wait until the DCE answers commands after leaving data and CMUX mode
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL if the DCE did not answer
+ */
+static esp_err_t esp_dte_sync_after_reset(modem_dce_t *dce)
+{
+    esp_err_t ret = ESP_FAIL;
+    /* Give the DCE the time to get out of data and CMUX mode */
+    for (int i = 0; i < ESP_MODEM_RESUME_SYNC_RETRIES && ret != ESP_OK; i++) {
+        vTaskDelay(pdMS_TO_TICKS(ESP_MODEM_RESUME_SYNC_DELAY_MS));
+        ret = dce->sync(dce);
+    }
+    return ret;
+}
+
+esp_err_t esp_modem_suspend_ppp(modem_dte_t *dte)
+{
+    modem_dce_t *dce = dte->dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
+    /* Already in command mode when an earlier attempt failed to hang up */
+    if (dce->mode != MODEM_COMMAND_MODE) {
+        MODEM_CHECK(esp_dte_reset(dte, false) == ESP_OK, "reset failed", err);
+    }
+    MODEM_CHECK(esp_dte_sync_after_reset(dce) == ESP_OK, "sync failed", err);
+    /* Leaving data mode keeps the call, release it as esp_modem_stop_ppp() does */
+    MODEM_CHECK(dce->hang_up(dce) == ESP_OK, "hang up failed", err);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_resume_ppp(modem_dte_t *dte)
+{
+    modem_dce_t *dce = dte->dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
+    MODEM_CHECK(esp_dte_sync_after_reset(dce) == ESP_OK, "sync failed", err);
+    if (dte->cmux) {
+        MODEM_CHECK(esp_modem_start_cmux(dte) == ESP_OK, "start cmux failed", err);
+    }
+    MODEM_CHECK(esp_dte_dial(dte) == ESP_OK, "dial failed", err);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Handle the response to the command of a raw transfer in CMUX mode
+ */
+static esp_err_t esp_dte_handle_raw_prompt(modem_dce_t *dce, const char *line)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dce->dte, esp_modem_dte_t, parent);
+    const char *prompt = esp_dte->raw_prompt;
+    esp_err_t err = ESP_FAIL;
+    if (prompt && strstr(line, prompt)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    }
+    return err;
+}
+
+/**
+ * @brief Read the raw input until the prompt, without CMUX
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param prompt prompt to wait for
+ * @param timeout_ms timeout
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_TIMEOUT if the prompt did not come in time
+ *      - ESP_FAIL if the DCE answered ERROR
+ */
+static esp_err_t esp_dte_wait_raw_prompt(esp_modem_dte_t *esp_dte, const char *prompt, uint32_t timeout_ms)
+{
+    static const char error[] = MODEM_RESULT_CODE_ERROR;
+    size_t len = strlen(prompt);
+    size_t matched = 0;
+    size_t error_matched = 0;
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    while (matched < len) {
+        int64_t left_us = deadline - esp_timer_get_time();
+        uint8_t c;
+        if (left_us <= 0) {
+            return ESP_ERR_TIMEOUT;
+        }
+        if (esp_dte->transport->read(esp_dte->transport, &c, 1, left_us / 1000 + 1) != 1) {
+            continue;
+        }
+        matched = c == prompt[matched] ? matched + 1 : c == prompt[0];
+        error_matched = c == error[error_matched] ? error_matched + 1 : c == error[0];
+        if (error_matched == sizeof(error) - 1) {
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Send raw data on the AT channel, split into UIH frames
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param data data to send
+ * @param length length of data
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_dte_send_cmux_raw(esp_modem_dte_t *esp_dte, const uint8_t *data, size_t length)
+{
+    /* On the stack, a frame reaches the transport in one write so other frames cannot interleave */
+    uint8_t frame[CMUX_N1 + CMUX_FRAME_OVERHEAD];
+    while (length) {
+        size_t chunk = MIN(length, CMUX_N1);
+        size_t frame_len = esp_modem_cmux_encode_uih(frame, sizeof(frame), CMUX_DLCI_AT, data, chunk);
+        if (esp_dte->transport->write(esp_dte->transport, frame, frame_len) < 0) {
+            return ESP_FAIL;
+        }
+        data += chunk;
+        length -= chunk;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_send_raw(modem_dte_t *dte, const esp_modem_raw_transfer_t *transfer, size_t *sent)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    modem_dce_t *dce = dte->dce;
+    bool cmux = dte->send_cmd == dte->send_cmux_cmd;
+    esp_err_t err = ESP_FAIL;
+    size_t total = 0;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err_param);
+    MODEM_CHECK(transfer && transfer->command && transfer->prompt && transfer->next, "invalid transfer", err_param);
+    if (dce->mode == MODEM_PPP_MODE && !cmux) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_dte_pm_acquire(esp_dte);
+    if (cmux) {
+        esp_dte->raw_prompt = transfer->prompt;
+        dce->handle_line = esp_dte_handle_raw_prompt;
+        err = dte->send_cmd(dte, transfer->command, transfer->prompt_timeout_ms);
+        esp_dte->raw_prompt = NULL;
+        MODEM_CHECK(err == ESP_OK && dce->state == MODEM_STATE_SUCCESS, "no prompt [%s]", err_prompt, transfer->prompt);
+    } else {
+        /* The prompt may lack a line end, and the data must not reach the line handlers */
+        esp_dte_set_mode(esp_dte, ESP_MODEM_TRANSPORT_MODE_PAUSED);
+        MODEM_CHECK(esp_dte->transport->write(esp_dte->transport, transfer->command, strlen(transfer->command)) >= 0,
+                    "write command failed", err_prompt);
+        err = esp_dte_wait_raw_prompt(esp_dte, transfer->prompt, transfer->prompt_timeout_ms);
+        MODEM_CHECK(err == ESP_OK, "no prompt [%s]", err_prompt, transfer->prompt);
+    }
+    /* Installed before the last byte leaves, the response may follow at once */
+    dce->handle_line = transfer->handle_result ? transfer->handle_result : esp_modem_dce_handle_response_default;
+    dce->state = MODEM_STATE_PROCESSING;
+    while (1) {
+        const void *data = NULL;
+        size_t len = 0;
+        err = transfer->next(transfer->ctx, &data, &len);
+        MODEM_CHECK(err == ESP_OK, "read source failed", err_data);
+        if (len == 0) {
+            break;
+        }
+        if (cmux) {
+            err = esp_dte_send_cmux_raw(esp_dte, data, len);
+        } else {
+            err = esp_dte->transport->write(esp_dte->transport, data, len) == len ? ESP_OK : ESP_FAIL;
+        }
+        MODEM_CHECK(err == ESP_OK, "write data failed", err_data);
+        total += len;
+    }
+    if (!cmux) {
+        esp_dte_set_mode(esp_dte, ESP_MODEM_TRANSPORT_MODE_LINE);
+    }
+    err = ESP_ERR_TIMEOUT;
+    MODEM_CHECK(xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(transfer->result_timeout_ms)) == pdTRUE,
+                "no response after %d bytes", err_result, total);
+    err = dce->state == MODEM_STATE_SUCCESS ? ESP_OK : ESP_FAIL;
+err_result:
+    dce->handle_line = NULL;
+    esp_dte_pm_release(esp_dte);
+    if (sent) {
+        *sent = total;
+    }
+    return err;
+err_data:
+    err = ESP_FAIL;
+err_prompt:
+    if (!cmux) {
+        esp_dte_set_mode(esp_dte, ESP_MODEM_TRANSPORT_MODE_LINE);
+    }
+    dce->handle_line = NULL;
+    esp_dte_pm_release(esp_dte);
+    if (sent) {
+        *sent = total;
+    }
+    return err == ESP_OK ? ESP_FAIL : err;
+err_param:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Size recommended for a buffer or queue from its peak usage
+ *
+ * @param configured size in use
+ * @param peak peak usage, 0 if unknown
+ * @param overflowed data was lost because it was too small
+ * @param min smallest size to recommend
+ */
+static int esp_dte_recommend_size(int configured, size_t peak, bool overflowed, int min)
+{
+    if (overflowed) {
+        return MAX(configured * 2, min);
+    }
+    if (peak == 0) {
+        return configured;
+    }
+    int size = peak + peak * CONFIG_COMPONENT_MODEM_BUFFER_MARGIN_PERCENT / 100;
+    /* round up to a multiple of 16 */
+    return MAX((size + 15) & ~15, min);
+}
+
+esp_err_t esp_modem_get_buffer_report(modem_dte_t *dte, esp_modem_buffer_report_t *report)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    esp_modem_transport_t *transport = esp_dte->transport;
+    esp_modem_transport_watermarks_t watermarks = { 0 };
+    if (transport->get_watermarks) {
+        transport->get_watermarks(transport, &watermarks);
+    }
+    report->configured = esp_dte->buffer_sizes;
+    report->peak.rx_buffer_size = watermarks.rx_buffer;
+    report->peak.tx_buffer_size = watermarks.tx_write;
+    report->peak.event_queue_size = watermarks.event_queue;
+    report->peak.pattern_queue_size = watermarks.pattern_queue;
+    report->peak.line_buffer_size = esp_dte->line_peak;
+    report->rx_overflows = watermarks.overflows;
+    report->line_overflows = esp_dte->line_overflows;
+    bool rx_lost = watermarks.overflows > 0;
+    report->recommended.rx_buffer_size = esp_dte_recommend_size(report->configured.rx_buffer_size,
+                                         watermarks.rx_buffer, rx_lost, ESP_MODEM_MIN_UART_BUFFER_SIZE);
+    /* 0 is valid for TX and means blocking writes, keep it */
+    report->recommended.tx_buffer_size = report->configured.tx_buffer_size == 0 ? 0 :
+                                         esp_dte_recommend_size(report->configured.tx_buffer_size,
+                                                 watermarks.tx_write, false, ESP_MODEM_MIN_UART_BUFFER_SIZE);
+    report->recommended.event_queue_size = esp_dte_recommend_size(report->configured.event_queue_size,
+                                           watermarks.event_queue, rx_lost, ESP_MODEM_MIN_EVENT_QUEUE_SIZE);
+    report->recommended.pattern_queue_size = esp_dte_recommend_size(report->configured.pattern_queue_size,
+            watermarks.pattern_queue, rx_lost, ESP_MODEM_MIN_PATTERN_QUEUE_SIZE);
+    report->recommended.line_buffer_size = esp_dte_recommend_size(report->configured.line_buffer_size,
+                                           esp_dte->line_peak, esp_dte->line_overflows > 0, ESP_MODEM_MIN_LINE_BUFFER_SIZE);
+    return ESP_OK;
+}
+
+void *esp_modem_dte_malloc(modem_dte_t *dte, esp_modem_mem_class_t mem_class, size_t size)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    MODEM_CHECK(mem_class < ESP_MODEM_MEM_CLASSES, "invalid memory class", err);
+    return esp_dte_malloc(esp_dte, mem_class, size);
+err:
+    return NULL;
+}
+
+void esp_modem_dte_free(modem_dte_t *dte, esp_modem_mem_class_t mem_class, void *ptr)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    esp_dte_free(esp_dte, mem_class, ptr);
+}
+
+esp_err_t esp_modem_get_mem_report(modem_dte_t *dte, esp_modem_mem_report_t *report)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    portENTER_CRITICAL(&esp_dte->mem_lock);
+    *report = esp_dte->mem_report;
+    portEXIT_CRITICAL(&esp_dte->mem_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_save_buffer_sizes(modem_dte_t *dte)
+{
+    esp_modem_buffer_report_t report;
+    esp_modem_get_buffer_report(dte, &report);
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(ESP_MODEM_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        ESP_LOGE(MODEM_TAG, "nvs_open failed with: %d", err);
+        return err;
+    }
+    err = nvs_set_blob(nvs, ESP_MODEM_NVS_BUFFER_SIZES_KEY, &report.recommended, sizeof(report.recommended));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+void esp_modem_mark_phase(modem_dte_t *dte, esp_modem_phase_t phase)
+{
+    static const char *const phase_names[ESP_MODEM_PHASE_MAX] = {
+        "dte", "leave_data", "sync", "identity", "cmux", "dlci0", "dlci1", "dlci2", "pdp", "dial", "got_ip"
+    };
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    esp_modem_timeline_t *timeline = &esp_dte->timeline;
+    if (phase >= ESP_MODEM_PHASE_MAX || timeline->end_ms[phase]) {
+        return;
+    }
+    /* 0 means not reached, a phase done within the first millisecond counts as 1 */
+    timeline->end_ms[phase] = MAX(1, (esp_timer_get_time() - timeline->start_us) / 1000);
+    if (phase == ESP_MODEM_PHASE_PPP_GOT_IP) {
+        char line[256];
+        int len = 0;
+        for (int i = 0; i < ESP_MODEM_PHASE_MAX && len < sizeof(line); i++) {
+            if (timeline->end_ms[i]) {
+                len += snprintf(&line[len], sizeof(line) - len, " %s=%u", phase_names[i], timeline->end_ms[i]);
+            }
+        }
+        ESP_LOGI(MODEM_TAG, "Startup timeline (ms):%s", line);
+    }
+}
+
+esp_err_t esp_modem_get_timeline(modem_dte_t *dte, esp_modem_timeline_t *timeline)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    *timeline = esp_dte->timeline;
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_get_rx_stats(modem_dte_t *dte, esp_modem_rx_stats_t *stats)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    /* Updated by the receiving task only, a torn read of a counter is harmless */
+    *stats = esp_dte->rx_stats;
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_get_cmux_tx_stats(modem_dte_t *dte, esp_modem_cmux_tx_stats_t *stats)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    xSemaphoreTake(esp_dte->tx_lock, portMAX_DELAY);
+    *stats = esp_dte->tx_stats;
+    xSemaphoreGive(esp_dte->tx_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_get_wake_stats(modem_dte_t *dte, esp_modem_wake_stats_t *stats)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    if (!esp_dte->wake_enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    /* Updated by the receiving task only, a torn read of a counter is harmless */
+    *stats = esp_dte->wake_stats;
+    return ESP_OK;
+}
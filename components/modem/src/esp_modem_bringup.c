@@ -0,0 +1,110 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_modem_dte.h"
+#include "esp_modem_bringup.h"
+
+static const char *TAG = "esp-modem-bringup";
+
+/**
+ * @brief Steps on the way to dialing: the dial steps and everything they require
+ *
+ * Requirements only point to lower indexes, so one pass from the top collects them.
+ */
+static uint32_t bringup_critical_steps(const esp_modem_bringup_step_t *steps, size_t count, bool cmux)
+{
+    uint32_t dial = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (steps[i].dial) {
+            dial |= ESP_MODEM_BRINGUP_STEP(i);
+        }
+    }
+    if (!cmux && dial) {
+        /* PPP takes the only channel, everything else has to run before */
+        return count >= ESP_MODEM_BRINGUP_MAX_STEPS ? UINT32_MAX : ESP_MODEM_BRINGUP_STEP(count) - 1;
+    }
+    uint32_t critical = dial;
+    for (size_t i = count; i-- > 0;) {
+        if (critical & ESP_MODEM_BRINGUP_STEP(i)) {
+            critical |= steps[i].requires;
+        }
+    }
+    return critical;
+}
+
+/**
+ * @brief Run one step if its requirements succeeded
+ *
+ * @return false if a mandatory step failed or was skipped
+ */
+static bool bringup_run_step(modem_dce_t *dce, const esp_modem_bringup_step_t *step, size_t index,
+                             uint32_t *done, int64_t start, esp_modem_bringup_result_t *result)
+{
+    int64_t step_start = esp_timer_get_time();
+    result->start_ms = (step_start - start) / 1000;
+    if ((step->requires & *done) != step->requires) {
+        ESP_LOGW(TAG, "%s skipped", step->name);
+        result->state = ESP_MODEM_BRINGUP_SKIPPED;
+        return step->optional;
+    }
+    esp_err_t err = step->run(dce, step->arg);
+    result->duration_ms = (esp_timer_get_time() - step_start) / 1000;
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "%s failed after %d ms", step->name, (int)result->duration_ms);
+        result->state = ESP_MODEM_BRINGUP_FAILED;
+        return step->optional;
+    }
+    ESP_LOGD(TAG, "%s done in %d ms", step->name, (int)result->duration_ms);
+    result->state = ESP_MODEM_BRINGUP_DONE;
+    *done |= ESP_MODEM_BRINGUP_STEP(index);
+    return true;
+}
+
+esp_err_t esp_modem_bringup(modem_dce_t *dce, const esp_modem_bringup_step_t *steps, size_t count,
+                            esp_modem_bringup_result_t *results)
+{
+    esp_modem_bringup_result_t local_results[ESP_MODEM_BRINGUP_MAX_STEPS];
+    if (count > ESP_MODEM_BRINGUP_MAX_STEPS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (steps[i].requires >> i) {
+            ESP_LOGE(TAG, "%s requires a later step", steps[i].name);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    if (results == NULL) {
+        results = local_results;
+    }
+    memset(results, 0, count * sizeof(esp_modem_bringup_result_t));
+    uint32_t critical = bringup_critical_steps(steps, count, dce->dte->cmux);
+    uint32_t done = 0;
+    int64_t start = esp_timer_get_time();
+    /* First the way to PPP, then the rest while PPP negotiates */
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < count; i++) {
+            bool on_critical_path = critical & ESP_MODEM_BRINGUP_STEP(i);
+            if (on_critical_path != (pass == 0)) {
+                continue;
+            }
+            if (!bringup_run_step(dce, &steps[i], i, &done, start, &results[i])) {
+                return ESP_FAIL;
+            }
+        }
+    }
+    ESP_LOGI(TAG, "Bring-up done in %d ms", (int)((esp_timer_get_time() - start) / 1000));
+    return ESP_OK;
+}
@@ -0,0 +1,414 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "esp_modem_dce_service.h"
+#include "esp_modem_caps.h"
+
+static const char *TAG = "esp-modem-caps";
+
+#define ESP_MODEM_CAPS_NVS_NAMESPACE "esp_modem"
+#define ESP_MODEM_CAPS_NVS_KEY "caps"
+#define ESP_MODEM_CAPS_STORE_VERSION (1)
+
+/**
+ * @brief Capabilities as persisted in NVS
+ *
+ */
+typedef struct {
+    uint32_t version;           /*!< ESP_MODEM_CAPS_STORE_VERSION, a new layout probes again */
+    esp_modem_caps_t caps;      /*!< Capabilities of caps.revision */
+} esp_modem_caps_store_t;
+
+/**
+ * @brief Values of one parameter of a test command response, e.g. "(0-2)" or "(300,600,115200)"
+ *
+ */
+typedef struct {
+    bool present;           /*!< At least one value was listed */
+    uint32_t mask;          /*!< Bit n set if value n is listed, values below 32 only */
+    uint32_t min;           /*!< Lowest value */
+    uint32_t max;           /*!< Highest value */
+    uint32_t *values;       /*!< Listed values and range bounds, NULL if not needed */
+    size_t max_values;      /*!< Capacity of values */
+    size_t value_count;     /*!< Entries of values */
+} caps_param_t;
+
+/**
+ * @brief Test command of one capability
+ *
+ */
+typedef struct {
+    const char *command;                                    /*!< Test command */
+    const char *prefix;                                     /*!< Prefix of the information response */
+    uint32_t capability;                                    /*!< ESP_MODEM_CAP_ bit set if the command is answered with OK */
+    void (*parse)(esp_modem_caps_t *caps, const char *line); /*!< Parser of the information response, NULL if not needed */
+} caps_command_t;
+
+/**
+ * @brief Command being probed, the response handler has no context argument
+ *
+ * Probes of several modems must not run at the same time.
+ */
+static struct {
+    const caps_command_t *command;
+    esp_modem_caps_t *caps;
+} s_probe;
+
+static void caps_param_add(caps_param_t *param, uint32_t low, uint32_t high)
+{
+    if (!param->present || low < param->min) {
+        param->min = low;
+    }
+    if (!param->present || high > param->max) {
+        param->max = high;
+    }
+    param->present = true;
+    for (uint32_t value = low; value <= high && value < 32; value++) {
+        param->mask |= 1UL << value;
+    }
+    if (param->values && param->value_count < param->max_values) {
+        param->values[param->value_count++] = low;
+    }
+    if (param->values && high != low && param->value_count < param->max_values) {
+        param->values[param->value_count++] = high;
+    }
+}
+
+/**
+ * @brief Parse one parameter, a parenthesized list of values and ranges; quoted values are skipped
+ *
+ * @return position of the separator after the parameter
+ */
+static const char *caps_parse_param(const char *p, caps_param_t *param)
+{
+    bool list = *p == '(';
+    bool quoted = false;
+    if (list) {
+        p++;
+    }
+    while (*p && (quoted || (list ? *p != ')' : *p != ','))) {
+        if (*p == '"') {
+            quoted = !quoted;
+            p++;
+        } else if (!quoted && list && isdigit((unsigned char)*p)) {
+            char *end;
+            uint32_t low = strtoul(p, &end, 10);
+            uint32_t high = low;
+            if (*end == '-' && isdigit((unsigned char)end[1])) {
+                high = strtoul(end + 1, &end, 10);
+            }
+            if (high >= low) {
+                caps_param_add(param, low, high);
+            }
+            p = end;
+        } else {
+            p++;
+        }
+    }
+    if (list && *p == ')') {
+        p++;
+    }
+    return p;
+}
+
+/**
+ * @brief Parse the parameters of an information response like "+CMUX: (0),(0),(1-5),(1-1509)"
+ *
+ * @param line response line
+ * @param params parsed parameters, initialized by the caller
+ * @param count number of parameters to parse
+ */
+static void caps_parse_params(const char *line, caps_param_t *params, size_t count)
+{
+    const char *p = strchr(line, ':');
+    if (!p) {
+        return;
+    }
+    p++;
+    for (size_t i = 0; i < count && *p; i++) {
+        while (*p == ' ') {
+            p++;
+        }
+        p = caps_parse_param(p, &params[i]);
+        if (*p != ',') {
+            break;
+        }
+        p++;
+    }
+}
+
+static void caps_parse_cmux(esp_modem_caps_t *caps, const char *line)
+{
+    caps_param_t params[4] = { 0 };
+    caps_parse_params(line, params, 4);
+    caps->cmux_modes = params[0].mask;
+    caps->cmux_subsets = params[1].mask;
+    caps->cmux_frame_size.min = params[3].min;
+    caps->cmux_frame_size.max = params[3].max;
+}
+
+static void caps_parse_ipr(esp_modem_caps_t *caps, const char *line)
+{
+    uint32_t values[2][ESP_MODEM_CAPS_MAX_BAUD_RATES];
+    caps_param_t params[2] = {
+        { .values = values[0], .max_values = ESP_MODEM_CAPS_MAX_BAUD_RATES },
+        { .values = values[1], .max_values = ESP_MODEM_CAPS_MAX_BAUD_RATES },
+    };
+    /* Some modems list fixed and auto-bauding rates separately, take both */
+    caps_parse_params(line, params, 2);
+    for (int i = 0; i < 2; i++) {
+        for (size_t j = 0; j < params[i].value_count; j++) {
+            uint32_t rate = params[i].values[j];
+            size_t pos = 0;
+            /* 0 is auto-bauding, not a rate */
+            if (rate == 0) {
+                continue;
+            }
+            while (pos < caps->baud_rate_count && caps->baud_rates[pos] < rate) {
+                pos++;
+            }
+            if ((pos < caps->baud_rate_count && caps->baud_rates[pos] == rate) ||
+                caps->baud_rate_count == ESP_MODEM_CAPS_MAX_BAUD_RATES) {
+                continue;
+            }
+            memmove(&caps->baud_rates[pos + 1], &caps->baud_rates[pos],
+                    (caps->baud_rate_count - pos) * sizeof(uint32_t));
+            caps->baud_rates[pos] = rate;
+            caps->baud_rate_count++;
+        }
+    }
+}
+
+static void caps_parse_ifc(esp_modem_caps_t *caps, const char *line)
+{
+    caps_param_t params[2] = { 0 };
+    caps_parse_params(line, params, 2);
+    caps->ifc_dce_by_dte = params[0].mask;
+    caps->ifc_dte_by_dce = params[1].mask;
+}
+
+static void caps_parse_cgdcont(esp_modem_caps_t *caps, const char *line)
+{
+    static const char *const types[] = { "\"IP\"", "\"IPV6\"", "\"IPV4V6\"", "\"PPP\"" };
+    caps_param_t params[1] = { 0 };
+    caps_parse_params(line, params, 1);
+    /* One line per PDP type, merge the cid ranges */
+    if (params[0].present) {
+        if (!caps->pdp_types || params[0].min < caps->pdp_cid.min) {
+            caps->pdp_cid.min = params[0].min;
+        }
+        if (params[0].max > caps->pdp_cid.max) {
+            caps->pdp_cid.max = params[0].max;
+        }
+    }
+    for (int i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        if (strstr(line, types[i])) {
+            caps->pdp_types |= 1 << i;
+        }
+    }
+}
+
+static void caps_parse_cedrxs(esp_modem_caps_t *caps, const char *line)
+{
+    caps_param_t params[2] = { 0 };
+    caps_parse_params(line, params, 2);
+    caps->edrx_act_types = params[1].mask;
+}
+
+static const caps_command_t s_caps_commands[] = {
+    { "AT+CMUX=?\r", "+CMUX:", ESP_MODEM_CAP_CMUX, caps_parse_cmux },
+    { "AT+IPR=?\r", "+IPR:", ESP_MODEM_CAP_IPR, caps_parse_ipr },
+    { "AT+IFC=?\r", "+IFC:", ESP_MODEM_CAP_IFC, caps_parse_ifc },
+    { "AT+CGDCONT=?\r", "+CGDCONT:", ESP_MODEM_CAP_CGDCONT, caps_parse_cgdcont },
+    { "AT+CPSMS=?\r", "+CPSMS:", ESP_MODEM_CAP_PSM, NULL },
+    { "AT+CEDRXS=?\r", "+CEDRXS:", ESP_MODEM_CAP_EDRX, caps_parse_cedrxs },
+};
+
+/**
+ * @brief Handle response from a test command
+ */
+static esp_err_t caps_handle_test(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    const caps_command_t *command = s_probe.command;
+    if (!strncmp(line, command->prefix, strlen(command->prefix))) {
+        if (command->parse) {
+            command->parse(s_probe.caps, line);
+        }
+        err = ESP_OK;
+    } else if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+CGMR
+ */
+static esp_err_t caps_handle_cgmr(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else {
+        /* "+CGMR: <revision>" on some modems, "Revision: <revision>" or the bare revision on others */
+        const char *revision = strchr(line, ':');
+        revision = revision ? revision + 1 : line;
+        while (*revision == ' ') {
+            revision++;
+        }
+        int len = snprintf(s_probe.caps->revision, ESP_MODEM_CAPS_REVISION_LENGTH, "%s", revision);
+        if (len > 2) {
+            /* Strip "\r\n" */
+            strip_cr_lf_tail(s_probe.caps->revision, len);
+            err = ESP_OK;
+        }
+    }
+    return err;
+}
+
+static esp_err_t caps_get_revision(modem_dce_t *dce, esp_modem_caps_t *caps)
+{
+    modem_dte_t *dte = dce->dte;
+    memset(caps, 0, sizeof(esp_modem_caps_t));
+    s_probe.caps = caps;
+    dce->handle_line = caps_handle_cgmr;
+    if (dte->send_cmd(dte, "AT+CGMR\r", MODEM_COMMAND_TIMEOUT_DEFAULT) != ESP_OK ||
+        dce->state != MODEM_STATE_SUCCESS || caps->revision[0] == '\0') {
+        ESP_LOGE(TAG, "get firmware revision failed");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static void caps_probe_commands(modem_dce_t *dce, esp_modem_caps_t *caps)
+{
+    modem_dte_t *dte = dce->dte;
+    s_probe.caps = caps;
+    for (int i = 0; i < sizeof(s_caps_commands) / sizeof(s_caps_commands[0]); i++) {
+        s_probe.command = &s_caps_commands[i];
+        dce->handle_line = caps_handle_test;
+        if (dte->send_cmd(dte, s_probe.command->command, MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK &&
+            dce->state == MODEM_STATE_SUCCESS) {
+            caps->commands |= s_probe.command->capability;
+        }
+    }
+    ESP_LOGI(TAG, "%s: commands 0x%x, %d baud rates, cmux frame %d-%d, pdp types 0x%x", caps->revision,
+             caps->commands, caps->baud_rate_count, caps->cmux_frame_size.min, caps->cmux_frame_size.max,
+             caps->pdp_types);
+}
+
+esp_err_t esp_modem_caps_probe(modem_dce_t *dce, esp_modem_caps_t *caps)
+{
+    if (caps_get_revision(dce, caps) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    caps_probe_commands(dce, caps);
+    return ESP_OK;
+}
+
+static bool caps_load(const char *revision, esp_modem_caps_t *caps)
+{
+    nvs_handle_t nvs;
+    esp_modem_caps_store_t store;
+    size_t size = sizeof(store);
+    if (nvs_open(ESP_MODEM_CAPS_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+    esp_err_t err = nvs_get_blob(nvs, ESP_MODEM_CAPS_NVS_KEY, &store, &size);
+    nvs_close(nvs);
+    if (err != ESP_OK || size != sizeof(store) || store.version != ESP_MODEM_CAPS_STORE_VERSION ||
+        strncmp(store.caps.revision, revision, ESP_MODEM_CAPS_REVISION_LENGTH)) {
+        return false;
+    }
+    memcpy(caps, &store.caps, sizeof(esp_modem_caps_t));
+    return true;
+}
+
+static esp_err_t caps_save(const esp_modem_caps_t *caps)
+{
+    nvs_handle_t nvs;
+    esp_modem_caps_store_t store = {
+        .version = ESP_MODEM_CAPS_STORE_VERSION,
+        .caps = *caps,
+    };
+    esp_err_t err = nvs_open(ESP_MODEM_CAPS_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "nvs_open failed with: %d", err);
+        return err;
+    }
+    err = nvs_set_blob(nvs, ESP_MODEM_CAPS_NVS_KEY, &store, sizeof(store));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+esp_err_t esp_modem_caps_get(modem_dce_t *dce, esp_modem_caps_t *caps, bool *cached)
+{
+    bool from_nvs = false;
+    if (caps_get_revision(dce, caps) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (caps_load(caps->revision, caps)) {
+        ESP_LOGD(TAG, "%s: cached", caps->revision);
+        from_nvs = true;
+    } else {
+        caps_probe_commands(dce, caps);
+        esp_err_t err = caps_save(caps);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "save capabilities failed with: %d", err);
+        }
+    }
+    if (cached) {
+        *cached = from_nvs;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_caps_clear(void)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(ESP_MODEM_CAPS_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_erase_key(nvs, ESP_MODEM_CAPS_NVS_KEY);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+        err = ESP_OK;
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+uint32_t esp_modem_caps_max_baud_rate(const esp_modem_caps_t *caps, uint32_t limit)
+{
+    for (int i = caps->baud_rate_count - 1; i >= 0; i--) {
+        if (caps->baud_rates[i] <= limit) {
+            return caps->baud_rates[i];
+        }
+    }
+    return 0;
+}
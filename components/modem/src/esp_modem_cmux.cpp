@@ -0,0 +1,60 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "esp_modem_cmux.hpp"
+#include "esp_modem_cmux.h"
+
+using namespace esp_modem;
+
+static_assert(cmux::max_payload == CMUX_N1, "CMUX_N1 differs from the codec");
+static_assert(cmux::overhead == CMUX_FRAME_OVERHEAD, "CMUX_FRAME_OVERHEAD differs from the codec");
+
+size_t esp_modem_cmux_encode(uint8_t *frame, size_t size, uint8_t address, uint8_t control,
+                             const void *payload, size_t length)
+{
+    return cmux::encode(cmux::span<uint8_t>(frame, size), address, control,
+                        static_cast<const uint8_t *>(payload), length);
+}
+
+size_t esp_modem_cmux_encode_uih(uint8_t *frame, size_t size, uint8_t dlci, const void *payload, size_t length)
+{
+    cmux::span<uint8_t> out(frame, size);
+    auto data = static_cast<const uint8_t *>(payload);
+    switch (dlci) {
+    case 0:
+        return cmux::encode_uih<0>(out, data, length);
+    case CMUX_DLCI_DATA:
+        return cmux::encode_uih<CMUX_DLCI_DATA>(out, data, length);
+    case CMUX_DLCI_AT:
+        return cmux::encode_uih<CMUX_DLCI_AT>(out, data, length);
+    default:
+        return cmux::encode(out, cmux::address(dlci, false), FT_UIH, data, length);
+    }
+}
+
+esp_modem_cmux_parse_result_t esp_modem_cmux_parse(const uint8_t *data, size_t length, size_t *frame_length)
+{
+    cmux::frame frame{};
+    switch (cmux::parse(cmux::span<const uint8_t>(data, length), frame)) {
+    case cmux::parse_result::complete:
+        *frame_length = frame.size;
+        return ESP_MODEM_CMUX_FRAME_COMPLETE;
+    case cmux::parse_result::bad_fcs:
+        *frame_length = frame.size;
+        return ESP_MODEM_CMUX_FRAME_BAD_FCS;
+    case cmux::parse_result::incomplete:
+        return ESP_MODEM_CMUX_FRAME_INCOMPLETE;
+    default:
+        return ESP_MODEM_CMUX_FRAME_INVALID;
+    }
+}
@@ -14,6 +14,7 @@
 #include <string.h>
 #include "esp_log.h"
 #include "esp_modem_dce_service.h"
+#include "esp_modem.h"
 
 /**
  * @brief Macro defined for error checking
@@ -124,6 +125,7 @@ esp_err_t esp_modem_dce_setup_cmux(modem_dce_t *dce)
     {
       dce->handle_cmux_frame = esp_modem_dce_handle_cmux_sabm;
       DCE_CHECK(dte->send_sabm(dte, i, MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
+      esp_modem_mark_phase(dte, ESP_MODEM_PHASE_DLCI0_OPEN + i);
       vTaskDelay(100 / portTICK_PERIOD_MS); // Waiting before open next DLC
     }
 
@@ -11,26 +11,611 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
+#include <string.h>
+#include <time.h>
+#include <sys/param.h>
 #include "esp_netif.h"
 #include "esp_modem.h"
+#include "esp_modem_netif.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 
 static const char *TAG = "esp-modem-netif";
 
+#define MODEM_NETIF_NVS_NAMESPACE "modem_netif"
+#define MODEM_NETIF_NVS_TRAFFIC_KEY "traffic"
+
+#define PPP_FLAG 0x7E
+#define PPP_ESCAPE 0x7D
+#define PPP_TRANS 0x20
+#define PPP_PROTO_IP 0x0021
+#define PPP_PROTO_IPV6 0x0057
+#define PPP_HEADER_DECODE_LEN (40)
+#define TRAFFIC_PERIOD_CHECK_US (60 * 1000 * 1000)
+#define DEMAND_CHECK_PERIOD_US (1000 * 1000)
+
+/**
+ * @brief Traffic counters as persisted in NVS
+ */
+typedef struct {
+    int32_t period;                                                         /*!< Calendar month of period_bytes */
+    esp_modem_traffic_counters_t counters[ESP_MODEM_NETIF_TRAFFIC_CLASSES]; /*!< Per-class counters */
+} esp_modem_traffic_store_t;
+
+/**
+ * @brief Traffic accounting state
+ */
+typedef struct {
+    esp_modem_traffic_config_t config;      /*!< Accounting configuration */
+    esp_modem_traffic_store_t store;        /*!< Counters */
+    uint32_t tokens[ESP_MODEM_NETIF_TRAFFIC_CLASSES]; /*!< Token bucket fill level */
+    int64_t refill_time;                    /*!< Last token bucket refill (us) */
+    uint8_t rx_class;                       /*!< Class of the frame currently being received */
+    int32_t period;                         /*!< Calendar month at the last check */
+    int64_t period_check_time;              /*!< Time of the last calendar month check (us) */
+    portMUX_TYPE lock;                      /*!< Protects counters and tokens */
+    esp_timer_handle_t persist_timer;       /*!< Periodic NVS save */
+} esp_modem_traffic_t;
+
+/**
+ * @brief State of the data call in dial on demand mode
+ */
+typedef enum {
+    DEMAND_IDLE = 0,        /*!< Call dropped, the PPP interface stays up */
+    DEMAND_DIALING,         /*!< Dialing, IP packets are queued */
+    DEMAND_NEGOTIATING,     /*!< Call up, PPP renegotiates, IP packets are still queued */
+    DEMAND_CONNECTED        /*!< Got an IP address, everything is sent */
+} esp_modem_demand_state_t;
+
+/**
+ * @brief Dial on demand state
+ */
+typedef struct {
+    esp_modem_demand_config_t config;       /*!< Dial on demand configuration */
+    esp_modem_demand_state_t state;         /*!< State of the data call */
+    bool hang_up;                           /*!< Idle or connect timeout, the task drops the call */
+    bool exit;                              /*!< Teardown, the task exits */
+    bool rx_ip;                             /*!< The frame currently being received is an IP packet */
+    uint8_t *queue;                         /*!< Outgoing frames held while dialing, each after its uint16_t length */
+    size_t queue_len;                       /*!< Bytes in queue */
+    uint32_t queue_packets;                 /*!< Frames in queue */
+    uint8_t *flush_buffer;                  /*!< Frames taken from the queue while sending them */
+    int64_t dial_start;                     /*!< First packet of the pending dial (us) */
+    int64_t connect_time;                   /*!< Start of the current session (us) */
+    int64_t last_activity;                  /*!< Last IP packet in either direction (us) */
+    esp_modem_demand_stats_t stats;         /*!< Session metrics */
+    portMUX_TYPE lock;                      /*!< Protects all of the above */
+    TaskHandle_t task;                      /*!< Dials and hangs up */
+    SemaphoreHandle_t exit_sem;             /*!< Given by the task when it exits */
+    esp_timer_handle_t check_timer;         /*!< Periodic idle and connect timeout check */
+} esp_modem_demand_t;
+
 /**
  * @brief ESP32 Modem handle to be used as netif IO object
  */
 typedef struct esp_modem_netif_driver_s {
     esp_netif_driver_base_t base;           /*!< base structure reserved as esp-netif driver */
     modem_dte_t            *dte;        /*!< ptr to the esp_modem objects (DTE) */
+    esp_modem_traffic_t    *traffic;    /*!< traffic accounting, NULL if disabled */
+    esp_modem_demand_t     *demand;     /*!< dial on demand, NULL if disabled */
 } esp_modem_netif_driver_t;
 
+/**
+ * @brief Returns the calendar month as a period number, -1 if the system time is not set
+ */
+static int32_t traffic_current_period(void)
+{
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    if (tm.tm_year < (2020 - 1900)) {
+        return -1;
+    }
+    return tm.tm_year * 12 + tm.tm_mon;
+}
+
+/**
+ * @brief Undo the HDLC-like framing (as produced by PPPoS) of the start of a PPP frame
+ *
+ * @param data frame data, starting at the flag or right after it
+ * @param len length of data
+ * @param hdr output, unescaped start of the frame
+ * @param size size of hdr
+ * @return number of bytes in hdr
+ */
+static size_t ppp_read_header(const uint8_t *data, size_t len, uint8_t *hdr, size_t size)
+{
+    size_t n = 0;
+    bool escaped = false;
+    for (size_t i = 0; i < len && n < size; i++) {
+        if (data[i] == PPP_FLAG) {
+            if (n) {
+                break;
+            }
+            continue;
+        }
+        if (data[i] == PPP_ESCAPE) {
+            escaped = true;
+            continue;
+        }
+        hdr[n++] = escaped ? data[i] ^ PPP_TRANS : data[i];
+        escaped = false;
+    }
+    return n;
+}
+
+/**
+ * @brief Skip address, control and protocol field of an unescaped PPP frame
+ *
+ * @param p in: start of the frame, out: start of the information field
+ * @param n in: bytes at p, out: bytes of the information field
+ * @return protocol number, -1 if the frame is too short
+ */
+static int32_t ppp_header_protocol(const uint8_t **p, size_t *n)
+{
+    const uint8_t *q = *p;
+    int32_t proto;
+    if (*n >= 2 && q[0] == 0xFF && q[1] == 0x03) {
+        /* Address and control field not compressed */
+        q += 2;
+        *n -= 2;
+    }
+    if (*n >= 1 && (q[0] & 0x01)) {
+        /* Compressed protocol field */
+        proto = q[0];
+        q += 1;
+        *n -= 1;
+    } else if (*n >= 2) {
+        proto = (q[0] << 8) | q[1];
+        q += 2;
+        *n -= 2;
+    } else {
+        return -1;
+    }
+    *p = q;
+    return proto;
+}
+
+/**
+ * @brief Decode the flow of a PPP frame
+ *
+ * @param data frame data, starting at the flag or right after it
+ * @param len length of data
+ * @param tx true for outgoing frames
+ * @param flow decoded flow
+ * @return true if the frame carries an IPv4 packet
+ */
+static bool traffic_decode_flow(const uint8_t *data, size_t len, bool tx, esp_modem_flow_t *flow)
+{
+    uint8_t hdr[PPP_HEADER_DECODE_LEN];
+    memset(flow, 0, sizeof(esp_modem_flow_t));
+    size_t n = ppp_read_header(data, len, hdr, sizeof(hdr));
+    const uint8_t *p = hdr;
+    if (ppp_header_protocol(&p, &n) != PPP_PROTO_IP || n < 20) {
+        return false;
+    }
+    size_t ihl = (p[0] & 0x0F) * 4;
+    uint32_t src, dst;
+    memcpy(&src, &p[12], sizeof(src));
+    memcpy(&dst, &p[16], sizeof(dst));
+    flow->protocol = p[9];
+    flow->local_addr = tx ? src : dst;
+    flow->remote_addr = tx ? dst : src;
+    bool first_fragment = ((p[6] & 0x1F) | p[7]) == 0;
+    if ((flow->protocol == 6 || flow->protocol == 17) && first_fragment && n >= ihl + 4) {
+        uint16_t sport = (p[ihl] << 8) | p[ihl + 1];
+        uint16_t dport = (p[ihl + 2] << 8) | p[ihl + 3];
+        flow->local_port = tx ? sport : dport;
+        flow->remote_port = tx ? dport : sport;
+    }
+    return true;
+}
+
+static inline bool traffic_port_match(uint16_t port, uint16_t min, uint16_t max)
+{
+    return (min == 0 && max == 0) || (port >= min && port <= max);
+}
+
+/**
+ * @brief Classifier and rules of the traffic configuration, copied under the lock
+ */
+typedef struct {
+    const esp_modem_traffic_rule_t *rules;
+    size_t rule_count;
+    esp_modem_traffic_classifier_t classifier;
+    void *classifier_ctx;
+} traffic_classifier_snapshot_t;
+
+/**
+ * @brief Classify a flow with the configured classifier or rules
+ *
+ * The classifier and rules are read under the lock, so that a concurrent esp_modem_netif_set_traffic_config()
+ * cannot pair a new classifier with an old context, and then called outside of it.
+ */
+static uint8_t traffic_classify(esp_modem_traffic_t *traffic, const esp_modem_flow_t *flow, bool tx)
+{
+    traffic_classifier_snapshot_t config;
+    portENTER_CRITICAL(&traffic->lock);
+    config.rules = traffic->config.rules;
+    config.rule_count = traffic->config.rule_count;
+    config.classifier = traffic->config.classifier;
+    config.classifier_ctx = traffic->config.classifier_ctx;
+    portEXIT_CRITICAL(&traffic->lock);
+    uint8_t traffic_class = 0;
+    if (config.classifier) {
+        traffic_class = config.classifier(flow, tx, config.classifier_ctx);
+    } else {
+        for (size_t i = 0; i < config.rule_count; i++) {
+            const esp_modem_traffic_rule_t *rule = &config.rules[i];
+            if ((rule->protocol == 0 || rule->protocol == flow->protocol) &&
+                ((flow->remote_addr ^ rule->remote_addr) & rule->remote_mask) == 0 &&
+                traffic_port_match(flow->remote_port, rule->remote_port_min, rule->remote_port_max) &&
+                traffic_port_match(flow->local_port, rule->local_port_min, rule->local_port_max)) {
+                traffic_class = rule->traffic_class;
+                break;
+            }
+        }
+    }
+    return traffic_class < ESP_MODEM_NETIF_TRAFFIC_CLASSES ? traffic_class : 0;
+}
+
+/**
+ * @brief Refresh the calendar month, at most once per TRAFFIC_PERIOD_CHECK_US to keep the data path cheap
+ */
+static void traffic_update_period(esp_modem_traffic_t *traffic, int64_t now)
+{
+    if (now - traffic->period_check_time > TRAFFIC_PERIOD_CHECK_US) {
+        traffic->period_check_time = now;
+        traffic->period = traffic_current_period();
+    }
+}
+
+/**
+ * @brief Start a new quota period if the calendar month changed, must be called with the lock held
+ */
+static void traffic_check_period(esp_modem_traffic_t *traffic)
+{
+    int32_t period = traffic->period;
+    if (period >= 0 && period != traffic->store.period) {
+        traffic->store.period = period;
+        for (int i = 0; i < ESP_MODEM_NETIF_TRAFFIC_CLASSES; i++) {
+            traffic->store.counters[i].period_bytes = 0;
+        }
+    }
+}
+
+/**
+ * @brief Account an outgoing frame and apply the limits of its class
+ *
+ * @return true if the frame may be sent
+ */
+static bool traffic_account_tx(esp_modem_traffic_t *traffic, const uint8_t *data, size_t len)
+{
+    esp_modem_flow_t flow;
+    bool ip = traffic_decode_flow(data, len, true, &flow);
+    uint8_t traffic_class = ip ? traffic_classify(traffic, &flow, true) : 0;
+    int64_t now = esp_timer_get_time();
+    bool pass = true;
+    traffic_update_period(traffic, now);
+    portENTER_CRITICAL(&traffic->lock);
+    const esp_modem_traffic_limit_t *limit = &traffic->config.limits[traffic_class];
+    esp_modem_traffic_counters_t *counters = &traffic->store.counters[traffic_class];
+    traffic_check_period(traffic);
+    /* Refill all token buckets */
+    int64_t elapsed_us = now - traffic->refill_time;
+    traffic->refill_time = now;
+    for (int i = 0; i < ESP_MODEM_NETIF_TRAFFIC_CLASSES; i++) {
+        const esp_modem_traffic_limit_t *l = &traffic->config.limits[i];
+        if (l->rate_bytes_per_sec) {
+            uint64_t tokens = traffic->tokens[i] + (uint64_t)elapsed_us * l->rate_bytes_per_sec / 1000000;
+            traffic->tokens[i] = MIN(tokens, l->burst_bytes);
+        }
+    }
+    /* Only IP packets are limited, dropping LCP/IPCP frames would tear the link down */
+    if (ip && limit->monthly_quota_bytes && counters->period_bytes + len > limit->monthly_quota_bytes) {
+        counters->tx_quota_drops++;
+        pass = false;
+    } else if (ip && limit->rate_bytes_per_sec) {
+        if (traffic->tokens[traffic_class] < len) {
+            counters->tx_rate_drops++;
+            pass = false;
+        } else {
+            traffic->tokens[traffic_class] -= len;
+        }
+    }
+    if (pass) {
+        counters->tx_bytes += len;
+        counters->tx_packets++;
+        counters->period_bytes += len;
+    }
+    portEXIT_CRITICAL(&traffic->lock);
+    return pass;
+}
+
+/**
+ * @brief Account incoming data
+ *
+ * Data may not be aligned to PPP frames, so the class is decoded when a frame
+ * starts in the buffer and continuation data is accounted to the same class.
+ */
+static void traffic_account_rx(esp_modem_traffic_t *traffic, const uint8_t *data, size_t len)
+{
+    esp_modem_flow_t flow;
+    bool frame_start = len > 1 && data[0] == PPP_FLAG;
+    if (frame_start) {
+        traffic->rx_class = traffic_decode_flow(data, len, false, &flow) ? traffic_classify(traffic, &flow, false) : 0;
+    }
+    traffic_update_period(traffic, esp_timer_get_time());
+    portENTER_CRITICAL(&traffic->lock);
+    esp_modem_traffic_counters_t *counters = &traffic->store.counters[traffic->rx_class];
+    traffic_check_period(traffic);
+    counters->rx_bytes += len;
+    counters->period_bytes += len;
+    if (frame_start) {
+        counters->rx_packets++;
+    }
+    portEXIT_CRITICAL(&traffic->lock);
+}
+
+static void traffic_persist_timer_cb(void *arg)
+{
+    esp_modem_netif_save_traffic_counters(arg);
+}
+
+/**
+ * @brief Whether a PPP frame carries an IPv4 or IPv6 packet, link control frames do not keep the call up
+ */
+static bool demand_frame_is_ip(const uint8_t *data, size_t len)
+{
+    uint8_t hdr[4];
+    size_t n = ppp_read_header(data, len, hdr, sizeof(hdr));
+    const uint8_t *p = hdr;
+    int32_t proto = ppp_header_protocol(&p, &n);
+    return proto == PPP_PROTO_IP || proto == PPP_PROTO_IPV6;
+}
+
+/**
+ * @brief Drop the queued frames, must be called with the lock held
+ */
+static void demand_drop_queue(esp_modem_demand_t *demand)
+{
+    demand->stats.queue_drops += demand->queue_packets;
+    demand->queue_len = 0;
+    demand->queue_packets = 0;
+}
+
+/**
+ * @brief Decide what happens to an outgoing frame, and start dialing on the first IP packet
+ *
+ * @param[out] queued true if the frame was kept to be sent once connected
+ * @return true if the frame goes out now
+ */
+static bool demand_tx(esp_modem_demand_t *demand, const uint8_t *data, size_t len, bool *queued)
+{
+    bool ip = demand_frame_is_ip(data, len);
+    bool send = false;
+    bool dial = false;
+    *queued = false;
+    portENTER_CRITICAL(&demand->lock);
+    if (demand->state == DEMAND_CONNECTED) {
+        send = true;
+        if (ip) {
+            demand->last_activity = esp_timer_get_time();
+        }
+    } else if (ip) {
+        if (demand->queue_len + sizeof(uint16_t) + len <= demand->config.queue_size) {
+            uint16_t frame_len = len;
+            memcpy(&demand->queue[demand->queue_len], &frame_len, sizeof(frame_len));
+            memcpy(&demand->queue[demand->queue_len + sizeof(frame_len)], data, len);
+            demand->queue_len += sizeof(frame_len) + len;
+            demand->queue_packets++;
+            *queued = true;
+        } else {
+            demand->stats.queue_drops++;
+        }
+        if (demand->state == DEMAND_IDLE) {
+            demand->state = DEMAND_DIALING;
+            demand->dial_start = esp_timer_get_time();
+            dial = true;
+        }
+    } else {
+        /* LCP and IPCP have to pass while the new session is negotiated */
+        send = demand->state == DEMAND_NEGOTIATING;
+    }
+    portEXIT_CRITICAL(&demand->lock);
+    if (dial) {
+        xTaskNotifyGive(demand->task);
+    }
+    return send;
+}
+
+/**
+ * @brief Note IP activity in received data
+ *
+ * Data may not be aligned to PPP frames, continuation data counts like the frame it belongs to.
+ */
+static void demand_rx(esp_modem_demand_t *demand, const uint8_t *data, size_t len)
+{
+    if (len > 1 && data[0] == PPP_FLAG) {
+        demand->rx_ip = demand_frame_is_ip(data, len);
+    }
+    if (demand->rx_ip) {
+        int64_t now = esp_timer_get_time();
+        portENTER_CRITICAL(&demand->lock);
+        demand->last_activity = now;
+        portEXIT_CRITICAL(&demand->lock);
+    }
+}
+
+/**
+ * @brief Send the frames queued while dialing, then let everything through
+ */
+static void demand_flush_queue(esp_modem_netif_driver_t *driver)
+{
+    esp_modem_demand_t *demand = driver->demand;
+    while (true) {
+        size_t len;
+        portENTER_CRITICAL(&demand->lock);
+        len = demand->queue_len;
+        if (len == 0) {
+            /* Frames sent meanwhile were queued behind, so the order is kept */
+            demand->state = DEMAND_CONNECTED;
+        } else {
+            memcpy(demand->flush_buffer, demand->queue, len);
+            demand->stats.queued_packets += demand->queue_packets;
+            demand->queue_len = 0;
+            demand->queue_packets = 0;
+        }
+        portEXIT_CRITICAL(&demand->lock);
+        if (len == 0) {
+            break;
+        }
+        for (size_t pos = 0; pos < len;) {
+            uint16_t frame_len;
+            memcpy(&frame_len, &demand->flush_buffer[pos], sizeof(frame_len));
+            pos += sizeof(frame_len);
+            driver->dte->send_data(driver->dte, (const char *)&demand->flush_buffer[pos], frame_len);
+            pos += frame_len;
+        }
+    }
+}
+
+/**
+ * @brief A session got its IP address
+ */
+static void demand_got_ip_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    esp_modem_netif_driver_t *driver = arg;
+    esp_modem_demand_t *demand = driver->demand;
+    const ip_event_got_ip_t *event = event_data;
+    if (event->esp_netif != driver->base.netif) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&demand->lock);
+    uint32_t setup_ms = (now - demand->dial_start) / 1000;
+    demand->stats.sessions++;
+    demand->stats.last_setup_ms = setup_ms;
+    demand->stats.max_setup_ms = MAX(demand->stats.max_setup_ms, setup_ms);
+    demand->stats.total_setup_ms += setup_ms;
+    demand->connect_time = now;
+    demand->last_activity = now;
+    portEXIT_CRITICAL(&demand->lock);
+    ESP_LOGI(TAG, "Demand session %d up in %d ms", demand->stats.sessions, setup_ms);
+    demand_flush_queue(driver);
+}
+
+/**
+ * @brief Periodic check for an idle call or a dial which takes too long
+ */
+static void demand_check_timer_cb(void *arg)
+{
+    esp_modem_demand_t *demand = arg;
+    int64_t now = esp_timer_get_time();
+    bool notify = false;
+    portENTER_CRITICAL(&demand->lock);
+    if (demand->state == DEMAND_CONNECTED) {
+        demand->hang_up = now - demand->last_activity > (int64_t)demand->config.idle_timeout_ms * 1000;
+    } else if (demand->state != DEMAND_IDLE) {
+        demand->hang_up = now - demand->dial_start > (int64_t)demand->config.connect_timeout_ms * 1000;
+    }
+    notify = demand->hang_up;
+    portEXIT_CRITICAL(&demand->lock);
+    if (notify) {
+        xTaskNotifyGive(demand->task);
+    }
+}
+
+/**
+ * @brief Dial on demand task, runs the blocking dial and hang up
+ */
+static void demand_task_entry(void *arg)
+{
+    esp_modem_netif_driver_t *driver = arg;
+    esp_modem_demand_t *demand = driver->demand;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (demand->exit) {
+            break;
+        }
+        portENTER_CRITICAL(&demand->lock);
+        esp_modem_demand_state_t state = demand->state;
+        bool hang_up = demand->hang_up;
+        portEXIT_CRITICAL(&demand->lock);
+        if (hang_up) {
+            ESP_LOGI(TAG, "%s, dropping the call", state == DEMAND_CONNECTED ? "Idle" : "Dial timeout");
+            esp_err_t err = esp_modem_suspend_ppp(driver->dte);
+            int64_t now = esp_timer_get_time();
+            portENTER_CRITICAL(&demand->lock);
+            demand->hang_up = false;
+            if (err != ESP_OK) {
+                /* The call may still be up, the next check tries again */
+                demand->stats.hang_up_failures++;
+                portEXIT_CRITICAL(&demand->lock);
+                ESP_LOGW(TAG, "Dropping the call failed");
+                continue;
+            }
+            if (state == DEMAND_CONNECTED) {
+                demand->stats.connected_ms += (now - demand->connect_time) / 1000;
+            } else {
+                demand->stats.dial_failures++;
+                demand_drop_queue(demand);
+            }
+            demand->state = DEMAND_IDLE;
+            portEXIT_CRITICAL(&demand->lock);
+        } else if (state == DEMAND_DIALING) {
+            ESP_LOGI(TAG, "Outgoing packet, dialing");
+            esp_err_t err = esp_modem_resume_ppp(driver->dte);
+            portENTER_CRITICAL(&demand->lock);
+            if (err == ESP_OK) {
+                demand->state = DEMAND_NEGOTIATING;
+            } else {
+                demand->stats.dial_failures++;
+                demand_drop_queue(demand);
+                demand->state = DEMAND_IDLE;
+            }
+            portEXIT_CRITICAL(&demand->lock);
+        }
+    }
+    xSemaphoreGive(demand->exit_sem);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Stop and free dial on demand
+ */
+static void demand_delete(esp_modem_netif_driver_t *driver)
+{
+    esp_modem_demand_t *demand = driver->demand;
+    esp_event_handler_unregister(IP_EVENT, IP_EVENT_PPP_GOT_IP, demand_got_ip_handler);
+    if (demand->check_timer) {
+        esp_timer_stop(demand->check_timer);
+        esp_timer_delete(demand->check_timer);
+    }
+    if (demand->task) {
+        demand->exit = true;
+        xTaskNotifyGive(demand->task);
+        xSemaphoreTake(demand->exit_sem, portMAX_DELAY);
+    }
+    if (demand->exit_sem) {
+        vSemaphoreDelete(demand->exit_sem);
+    }
+    esp_modem_dte_free(driver->dte, ESP_MODEM_MEM_BULK, demand->queue);
+    esp_modem_dte_free(driver->dte, ESP_MODEM_MEM_BULK, demand->flush_buffer);
+    free(demand);
+    driver->demand = NULL;
+}
+
 /**
  * @brief Transmit function called from esp_netif to output network stack data
  *
  * Note: This API has to conform to esp-netif transmit prototype
  *
- * @param h Opaque pointer representing esp-netif driver, esp_dte in this case of esp_modem
+ * @param h Opaque pointer representing esp-netif driver, modem-netif driver in this case of esp_modem
  * @param data data buffer
  * @param length length of data to send
  *
@@ -38,7 +623,15 @@ typedef struct esp_modem_netif_driver_s {
  */
 static esp_err_t esp_modem_dte_transmit(void *h, void *buffer, size_t len)
 {
-    modem_dte_t *dte = h;
+    esp_modem_netif_driver_t *driver = h;
+    modem_dte_t *dte = driver->dte;
+    if (driver->traffic && !traffic_account_tx(driver->traffic, buffer, len)) {
+        return ESP_FAIL;
+    }
+    bool queued = false;
+    if (driver->demand && !demand_tx(driver->demand, buffer, len, &queued)) {
+        return queued ? ESP_OK : ESP_FAIL;
+    }
     if (dte->send_data(dte, (const char *)buffer, len) > 0) {
         return ESP_OK;
     }
@@ -62,10 +655,15 @@ static esp_err_t esp_modem_post_attach_start(esp_netif_t * esp_netif, void * arg
     const esp_netif_driver_ifconfig_t driver_ifconfig = {
             .driver_free_rx_buffer = NULL,
             .transmit = esp_modem_dte_transmit,
-            .handle = dte
+            .handle = driver
     };
     driver->base.netif = esp_netif;
     ESP_ERROR_CHECK(esp_netif_set_driver_config(esp_netif, &driver_ifconfig));
+    if (driver->demand) {
+        /* The first session is dialed right away, on demand dialing starts after it went idle */
+        driver->demand->state = DEMAND_NEGOTIATING;
+        driver->demand->dial_start = esp_timer_get_time();
+    }
     esp_modem_start_ppp(dte);
     return ESP_OK;
 }
@@ -82,6 +680,12 @@ static esp_err_t esp_modem_post_attach_start(esp_netif_t * esp_netif, void * arg
 static esp_err_t modem_netif_receive_cb(void *buffer, size_t len, void *context)
 {
     esp_modem_netif_driver_t *driver = context;
+    if (driver->traffic) {
+        traffic_account_rx(driver->traffic, buffer, len);
+    }
+    if (driver->demand) {
+        demand_rx(driver->demand, buffer, len);
+    }
     esp_netif_receive(driver->base.netif, buffer, len, NULL);
     return ESP_OK;
 }
@@ -96,13 +700,15 @@ void *esp_modem_netif_setup(modem_dte_t *dte)
     esp_err_t err = esp_modem_set_rx_cb(dte, modem_netif_receive_cb, driver);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "esp_modem_set_rx_cb failed with: %d", err);
-        goto drv_create_failed;
+        goto rx_cb_failed;
     }
 
     driver->base.post_attach = esp_modem_post_attach_start;
     driver->dte = dte;
     return driver;
 
+rx_cb_failed:
+    free(driver);
 drv_create_failed:
     return NULL;
 }
@@ -110,6 +716,17 @@ drv_create_failed:
 void esp_modem_netif_teardown(void *h)
 {
     esp_modem_netif_driver_t *driver = h;
+    if (driver->demand) {
+        demand_delete(driver);
+    }
+    if (driver->traffic) {
+        if (driver->traffic->persist_timer) {
+            esp_timer_stop(driver->traffic->persist_timer);
+            esp_timer_delete(driver->traffic->persist_timer);
+            esp_modem_netif_save_traffic_counters(driver);
+        }
+        free(driver->traffic);
+    }
     free(driver);
 }
 
@@ -160,3 +777,189 @@ set_event_failed:
     esp_modem_netif_clear_default_handlers(driver);
     return ESP_FAIL;
 }
+
+esp_err_t esp_modem_netif_set_traffic_config(void *h, const esp_modem_traffic_config_t *config)
+{
+    esp_modem_netif_driver_t *driver = h;
+    esp_modem_traffic_t *traffic = driver->traffic;
+    for (int i = 0; i < ESP_MODEM_NETIF_TRAFFIC_CLASSES; i++) {
+        /* A bucket which cannot hold a single packet would drop all of them */
+        if (config->limits[i].rate_bytes_per_sec && config->limits[i].burst_bytes == 0) {
+            ESP_LOGE(TAG, "Traffic class %d has a rate limit but no burst", i);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    if (traffic == NULL) {
+        traffic = calloc(1, sizeof(esp_modem_traffic_t));
+        if (traffic == NULL) {
+            ESP_LOGE(TAG, "Cannot allocate traffic accounting");
+            return ESP_ERR_NO_MEM;
+        }
+        portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+        traffic->lock = lock;
+        traffic->period = traffic_current_period();
+        traffic->period_check_time = esp_timer_get_time();
+        traffic->store.period = traffic->period;
+    }
+    /* The transmit path reads the configuration under the lock */
+    portENTER_CRITICAL(&traffic->lock);
+    traffic->config = *config;
+    traffic->refill_time = esp_timer_get_time();
+    for (int i = 0; i < ESP_MODEM_NETIF_TRAFFIC_CLASSES; i++) {
+        traffic->tokens[i] = config->limits[i].burst_bytes;
+    }
+    portEXIT_CRITICAL(&traffic->lock);
+    if (config->persist_interval_ms && traffic->persist_timer == NULL) {
+        /* Restore counters of previous boots */
+        nvs_handle_t nvs;
+        if (nvs_open(MODEM_NETIF_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+            esp_modem_traffic_store_t store;
+            size_t size = sizeof(store);
+            if (nvs_get_blob(nvs, MODEM_NETIF_NVS_TRAFFIC_KEY, &store, &size) == ESP_OK && size == sizeof(store)) {
+                portENTER_CRITICAL(&traffic->lock);
+                traffic->store = store;
+                portEXIT_CRITICAL(&traffic->lock);
+            }
+            nvs_close(nvs);
+        }
+        const esp_timer_create_args_t timer_args = {
+            .callback = traffic_persist_timer_cb,
+            .arg = driver,
+            .name = "modem_traffic"
+        };
+        if (esp_timer_create(&timer_args, &traffic->persist_timer) != ESP_OK ||
+            esp_timer_start_periodic(traffic->persist_timer, (uint64_t)config->persist_interval_ms * 1000) != ESP_OK) {
+            ESP_LOGE(TAG, "Cannot start traffic persist timer");
+        }
+    }
+    driver->traffic = traffic;
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_netif_get_traffic_counters(void *h, uint8_t traffic_class, esp_modem_traffic_counters_t *counters)
+{
+    esp_modem_netif_driver_t *driver = h;
+    esp_modem_traffic_t *traffic = driver->traffic;
+    if (traffic == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (traffic_class >= ESP_MODEM_NETIF_TRAFFIC_CLASSES || counters == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&traffic->lock);
+    traffic_check_period(traffic);
+    *counters = traffic->store.counters[traffic_class];
+    portEXIT_CRITICAL(&traffic->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_netif_save_traffic_counters(void *h)
+{
+    esp_modem_netif_driver_t *driver = h;
+    esp_modem_traffic_t *traffic = driver->traffic;
+    if (traffic == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_modem_traffic_store_t store;
+    portENTER_CRITICAL(&traffic->lock);
+    store = traffic->store;
+    portEXIT_CRITICAL(&traffic->lock);
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(MODEM_NETIF_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "nvs_open failed with: %d", err);
+        return err;
+    }
+    err = nvs_set_blob(nvs, MODEM_NETIF_NVS_TRAFFIC_KEY, &store, sizeof(store));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+esp_err_t esp_modem_netif_reset_traffic_period(void *h)
+{
+    esp_modem_netif_driver_t *driver = h;
+    esp_modem_traffic_t *traffic = driver->traffic;
+    if (traffic == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    portENTER_CRITICAL(&traffic->lock);
+    for (int i = 0; i < ESP_MODEM_NETIF_TRAFFIC_CLASSES; i++) {
+        traffic->store.counters[i].period_bytes = 0;
+    }
+    portEXIT_CRITICAL(&traffic->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_netif_set_demand_config(void *h, const esp_modem_demand_config_t *config)
+{
+    esp_modem_netif_driver_t *driver = h;
+    if (driver->demand) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (config->idle_timeout_ms == 0 || config->queue_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_modem_demand_t *demand = calloc(1, sizeof(esp_modem_demand_t));
+    if (demand == NULL) {
+        ESP_LOGE(TAG, "Cannot allocate dial on demand");
+        return ESP_ERR_NO_MEM;
+    }
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+    demand->lock = lock;
+    demand->config = *config;
+    driver->demand = demand;
+    demand->queue = esp_modem_dte_malloc(driver->dte, ESP_MODEM_MEM_BULK, config->queue_size);
+    demand->flush_buffer = esp_modem_dte_malloc(driver->dte, ESP_MODEM_MEM_BULK, config->queue_size);
+    demand->exit_sem = xSemaphoreCreateBinary();
+    if (demand->queue == NULL || demand->flush_buffer == NULL || demand->exit_sem == NULL) {
+        ESP_LOGE(TAG, "Cannot allocate dial on demand queue");
+        goto err;
+    }
+    if (xTaskCreate(demand_task_entry, "modem_demand", config->task_stack_size, driver,
+                    config->task_priority, &demand->task) != pdTRUE) {
+        ESP_LOGE(TAG, "Cannot create dial on demand task");
+        demand->task = NULL;
+        goto err;
+    }
+    const esp_timer_create_args_t timer_args = {
+        .callback = demand_check_timer_cb,
+        .arg = demand,
+        .name = "modem_demand"
+    };
+    if (esp_timer_create(&timer_args, &demand->check_timer) != ESP_OK ||
+        esp_timer_start_periodic(demand->check_timer, DEMAND_CHECK_PERIOD_US) != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot start dial on demand timer");
+        goto err;
+    }
+    if (esp_event_handler_register(IP_EVENT, IP_EVENT_PPP_GOT_IP, demand_got_ip_handler, driver) != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot register dial on demand event handler");
+        goto err;
+    }
+    return ESP_OK;
+err:
+    demand_delete(driver);
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_netif_get_demand_stats(void *h, esp_modem_demand_stats_t *stats)
+{
+    esp_modem_netif_driver_t *driver = h;
+    esp_modem_demand_t *demand = driver->demand;
+    if (demand == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&demand->lock);
+    *stats = demand->stats;
+    if (demand->state == DEMAND_CONNECTED) {
+        stats->connected_ms += (now - demand->connect_time) / 1000;
+    }
+    portEXIT_CRITICAL(&demand->lock);
+    return ESP_OK;
+}
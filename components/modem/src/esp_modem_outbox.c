@@ -0,0 +1,476 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_netif.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_modem_outbox.h"
+
+static const char *TAG = "esp-modem-outbox";
+#define OUTBOX_CHECK(a, str, goto_tag, ...)                                         \
+    do                                                                              \
+    {                                                                               \
+        if (!(a))                                                                   \
+        {                                                                           \
+            ESP_LOGE(TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__);   \
+            goto goto_tag;                                                          \
+        }                                                                           \
+    } while (0)
+
+#define OUTBOX_SECTOR_SIZE (4096)
+#define OUTBOX_MAGIC (0x0B0C)
+#define OUTBOX_MAGIC_FREE (0xFFFF)
+#define OUTBOX_STATE_PENDING (0xFFFFFFFF)
+#define OUTBOX_STATE_SENT (0)
+#define OUTBOX_RETRY_MS (30000)
+
+/**
+ * @brief Record header, followed by the payload padded to 4 bytes
+ *
+ * The payload is written first and the header last, so a record with a valid
+ * magic is complete. Sending a record only clears the state word.
+ */
+typedef struct {
+    uint16_t magic;     /*!< OUTBOX_MAGIC */
+    uint16_t len;       /*!< Payload length */
+    uint32_t seq;       /*!< Sequence number, gives the order across the ring */
+    uint32_t crc;       /*!< CRC32 of the payload */
+    uint32_t state;     /*!< OUTBOX_STATE_PENDING or OUTBOX_STATE_SENT */
+} outbox_record_t;
+
+typedef enum {
+    OUTBOX_RECORD_VALID,
+    OUTBOX_RECORD_FREE,
+    OUTBOX_RECORD_INVALID
+} outbox_record_status_t;
+
+struct esp_modem_outbox {
+    esp_modem_outbox_config_t config;       /*!< Outbox configuration */
+    const esp_partition_t *partition;       /*!< Ring partition */
+    uint8_t *buffer;                        /*!< Payload buffer used while sending */
+    size_t head;                            /*!< Offset of the next record to write */
+    size_t tail;                            /*!< Offset of the oldest pending record */
+    uint32_t next_seq;                      /*!< Sequence number of the next record */
+    esp_modem_outbox_stats_t stats;         /*!< Statistics, also holds the pending counters */
+    TickType_t oldest_tick;                 /*!< Time the oldest pending message was queued */
+    bool link_up;                           /*!< PPP has an IP address */
+    bool link_up_edge;                      /*!< PPP came up since the last check */
+    bool flush_requested;                   /*!< esp_modem_outbox_flush() was called */
+    SemaphoreHandle_t lock;                 /*!< Protects the ring state */
+    SemaphoreHandle_t exit_sem;             /*!< Given by the task when it exits */
+    TaskHandle_t task_hdl;                  /*!< Outbox task */
+    volatile bool running;                  /*!< Cleared to stop the task */
+};
+
+static inline size_t outbox_record_size(size_t len)
+{
+    return sizeof(outbox_record_t) + ((len + 3) & ~3);
+}
+
+static inline size_t outbox_next_sector(esp_modem_outbox_t *outbox, size_t offset)
+{
+    size_t next = (offset / OUTBOX_SECTOR_SIZE + 1) * OUTBOX_SECTOR_SIZE;
+    return next >= outbox->partition->size ? 0 : next;
+}
+
+/**
+ * @brief Read and check the record header at the given offset
+ */
+static outbox_record_status_t outbox_read_record(esp_modem_outbox_t *outbox, size_t offset, outbox_record_t *record)
+{
+    if (offset % OUTBOX_SECTOR_SIZE + sizeof(outbox_record_t) > OUTBOX_SECTOR_SIZE ||
+        esp_partition_read(outbox->partition, offset, record, sizeof(outbox_record_t)) != ESP_OK) {
+        return OUTBOX_RECORD_INVALID;
+    }
+    if (record->magic == OUTBOX_MAGIC_FREE) {
+        return OUTBOX_RECORD_FREE;
+    }
+    if (record->magic != OUTBOX_MAGIC ||
+        offset % OUTBOX_SECTOR_SIZE + outbox_record_size(record->len) > OUTBOX_SECTOR_SIZE) {
+        return OUTBOX_RECORD_INVALID;
+    }
+    return OUTBOX_RECORD_VALID;
+}
+
+/**
+ * @brief Check that the flash from offset to the end of its sector is erased
+ */
+static bool outbox_sector_tail_erased(esp_modem_outbox_t *outbox, size_t offset)
+{
+    size_t end = (offset / OUTBOX_SECTOR_SIZE + 1) * OUTBOX_SECTOR_SIZE;
+    uint32_t word;
+    for (; offset < end; offset += sizeof(word)) {
+        if (esp_partition_read(outbox->partition, offset, &word, sizeof(word)) != ESP_OK || word != 0xFFFFFFFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Move the tail to the next pending record, must be called with the lock held
+ */
+static void outbox_seek_pending(esp_modem_outbox_t *outbox)
+{
+    outbox_record_t record;
+    size_t max_steps = outbox->partition->size / sizeof(outbox_record_t);
+    while (outbox->stats.pending_messages && max_steps--) {
+        outbox_record_status_t status = outbox_read_record(outbox, outbox->tail, &record);
+        if (status == OUTBOX_RECORD_VALID && record.state == OUTBOX_STATE_PENDING) {
+            return;
+        }
+        if (status == OUTBOX_RECORD_VALID) {
+            outbox->tail += outbox_record_size(record.len);
+            if (outbox->tail >= outbox->partition->size) {
+                outbox->tail = 0;
+            } else if (outbox->tail % OUTBOX_SECTOR_SIZE + sizeof(outbox_record_t) > OUTBOX_SECTOR_SIZE) {
+                outbox->tail = outbox_next_sector(outbox, outbox->tail);
+            }
+        } else {
+            /* writer skipped the rest of this sector */
+            outbox->tail = outbox_next_sector(outbox, outbox->tail);
+        }
+    }
+    if (outbox->stats.pending_messages) {
+        ESP_LOGE(TAG, "lost track of %d pending messages", outbox->stats.pending_messages);
+        outbox->stats.dropped_messages += outbox->stats.pending_messages;
+        outbox->stats.pending_messages = 0;
+        outbox->stats.pending_bytes = 0;
+    }
+    outbox->tail = outbox->head;
+}
+
+/**
+ * @brief Recover the ring state from flash
+ */
+static void outbox_recover(esp_modem_outbox_t *outbox)
+{
+    outbox_record_t record;
+    bool found = false;
+    bool pending_found = false;
+    uint32_t max_seq = 0;
+    uint32_t min_pending_seq = 0;
+    for (size_t sector = 0; sector < outbox->partition->size; sector += OUTBOX_SECTOR_SIZE) {
+        size_t offset = sector;
+        while (offset < sector + OUTBOX_SECTOR_SIZE &&
+               outbox_read_record(outbox, offset, &record) == OUTBOX_RECORD_VALID) {
+            if (!found || (int32_t)(record.seq - max_seq) > 0) {
+                found = true;
+                max_seq = record.seq;
+                outbox->head = offset + outbox_record_size(record.len);
+            }
+            if (record.state == OUTBOX_STATE_PENDING) {
+                outbox->stats.pending_messages++;
+                outbox->stats.pending_bytes += record.len;
+                if (!pending_found || (int32_t)(record.seq - min_pending_seq) < 0) {
+                    pending_found = true;
+                    min_pending_seq = record.seq;
+                    outbox->tail = offset;
+                }
+            }
+            offset += outbox_record_size(record.len);
+        }
+    }
+    outbox->next_seq = found ? max_seq + 1 : 0;
+    if (outbox->head >= outbox->partition->size) {
+        outbox->head = 0;
+    }
+    /* An interrupted write may have left garbage after the last record */
+    if (outbox->head % OUTBOX_SECTOR_SIZE && !outbox_sector_tail_erased(outbox, outbox->head)) {
+        outbox->head = outbox_next_sector(outbox, outbox->head);
+    }
+    if (!pending_found) {
+        outbox->tail = outbox->head;
+    }
+    /* Messages from previous boots count as queued now */
+    outbox->oldest_tick = xTaskGetTickCount();
+    ESP_LOGI(TAG, "recovered %d pending messages (%d bytes)", outbox->stats.pending_messages, outbox->stats.pending_bytes);
+}
+
+/**
+ * @brief Drop the pending messages of the sector at offset, must be called with the lock held
+ */
+static void outbox_drop_sector(esp_modem_outbox_t *outbox, size_t offset)
+{
+    outbox_record_t record;
+    size_t end = offset + OUTBOX_SECTOR_SIZE;
+    while (offset < end && outbox_read_record(outbox, offset, &record) == OUTBOX_RECORD_VALID) {
+        if (record.state == OUTBOX_STATE_PENDING) {
+            outbox->stats.pending_messages--;
+            outbox->stats.pending_bytes -= record.len;
+            outbox->stats.dropped_messages++;
+        }
+        offset += outbox_record_size(record.len);
+    }
+    outbox->tail = outbox_next_sector(outbox, end - 1);
+    outbox_seek_pending(outbox);
+}
+
+static void outbox_ip_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    esp_modem_outbox_t *outbox = arg;
+    if (event_id == IP_EVENT_PPP_GOT_IP) {
+        outbox->link_up = true;
+        if (outbox->config.flush_on_ppp_up) {
+            outbox->link_up_edge = true;
+            xTaskNotifyGive(outbox->task_hdl);
+        }
+    } else if (event_id == IP_EVENT_PPP_LOST_IP) {
+        outbox->link_up = false;
+    }
+}
+
+/**
+ * @brief Send all pending messages in one radio session
+ */
+static esp_err_t outbox_run_session(esp_modem_outbox_t *outbox)
+{
+    esp_modem_outbox_config_t *config = &outbox->config;
+    bool opened = false;
+    esp_err_t ret = ESP_OK;
+    uint32_t batch_messages = 0;
+    uint32_t batch_bytes = 0;
+    if (!outbox->link_up && config->session_open) {
+        OUTBOX_CHECK(config->session_open(config->ctx) == ESP_OK, "open session failed", err);
+        opened = true;
+    }
+    while (outbox->running) {
+        outbox_record_t record;
+        xSemaphoreTake(outbox->lock, portMAX_DELAY);
+        outbox_seek_pending(outbox);
+        if (outbox->stats.pending_messages == 0) {
+            xSemaphoreGive(outbox->lock);
+            break;
+        }
+        size_t offset = outbox->tail;
+        bool ok = outbox_read_record(outbox, offset, &record) == OUTBOX_RECORD_VALID &&
+                  record.len <= config->max_message_size &&
+                  esp_partition_read(outbox->partition, offset + sizeof(outbox_record_t), outbox->buffer, record.len) == ESP_OK &&
+                  esp_rom_crc32_le(0, outbox->buffer, record.len) == record.crc;
+        xSemaphoreGive(outbox->lock);
+        if (ok && config->send(outbox->buffer, record.len, config->ctx) != ESP_OK) {
+            ESP_LOGW(TAG, "send failed, %d messages left", outbox->stats.pending_messages);
+            ret = ESP_FAIL;
+            break;
+        }
+        xSemaphoreTake(outbox->lock, portMAX_DELAY);
+        /* the record may have been dropped by a writer while it was being sent */
+        if (outbox->tail == offset) {
+            uint32_t state = OUTBOX_STATE_SENT;
+            esp_partition_write(outbox->partition, offset + offsetof(outbox_record_t, state), &state, sizeof(state));
+            outbox->stats.pending_messages--;
+            outbox->stats.pending_bytes -= record.len;
+            if (ok) {
+                outbox->stats.sent_messages++;
+                outbox->stats.sent_bytes += record.len;
+                batch_messages++;
+                batch_bytes += record.len;
+            } else {
+                ESP_LOGW(TAG, "dropped corrupted message at 0x%x", offset);
+                outbox->stats.dropped_messages++;
+            }
+        }
+        xSemaphoreGive(outbox->lock);
+    }
+    if (opened && config->session_close) {
+        config->session_close(config->ctx);
+    }
+    /* A session which sent nothing is a failed attempt, not a batch */
+    if (batch_messages) {
+        xSemaphoreTake(outbox->lock, portMAX_DELAY);
+        outbox->stats.sessions++;
+        outbox->stats.last_batch_messages = batch_messages;
+        outbox->stats.last_batch_bytes = batch_bytes;
+        if (batch_messages > outbox->stats.max_batch_messages) {
+            outbox->stats.max_batch_messages = batch_messages;
+        }
+        xSemaphoreGive(outbox->lock);
+    }
+    ESP_LOGI(TAG, "session sent %d messages, %d bytes", batch_messages, batch_bytes);
+    return ret;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Outbox Task Entry
+ *
+ * @param param task parameter
+ */
+static void outbox_task_entry(void *param)
+{
+    esp_modem_outbox_t *outbox = (esp_modem_outbox_t *)param;
+    esp_modem_outbox_config_t *config = &outbox->config;
+    TickType_t max_age = pdMS_TO_TICKS(config->flush_max_age_ms);
+    while (outbox->running) {
+        TickType_t wait = portMAX_DELAY;
+        xSemaphoreTake(outbox->lock, portMAX_DELAY);
+        bool trigger = false;
+        if (outbox->stats.pending_messages) {
+            TickType_t age = xTaskGetTickCount() - outbox->oldest_tick;
+            trigger = outbox->flush_requested || age >= max_age ||
+                      outbox->stats.pending_bytes >= config->flush_size_threshold ||
+                      (config->flush_on_ppp_up && outbox->link_up_edge);
+            wait = age < max_age ? max_age - age : 0;
+        }
+        outbox->flush_requested = false;
+        outbox->link_up_edge = false;
+        xSemaphoreGive(outbox->lock);
+        if (trigger && outbox_run_session(outbox) != ESP_OK) {
+            /* Back off instead of dialing again at once, the trigger still holds */
+            wait = pdMS_TO_TICKS(OUTBOX_RETRY_MS);
+        } else if (trigger) {
+            continue;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+    }
+    xSemaphoreGive(outbox->exit_sem);
+    vTaskDelete(NULL);
+}
+
+esp_modem_outbox_t *esp_modem_outbox_create(const esp_modem_outbox_config_t *config)
+{
+    OUTBOX_CHECK(config && config->send, "invalid configuration", err);
+    esp_modem_outbox_t *outbox = calloc(1, sizeof(esp_modem_outbox_t));
+    OUTBOX_CHECK(outbox, "calloc outbox failed", err);
+    outbox->config = *config;
+    outbox->partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, config->partition_label);
+    OUTBOX_CHECK(outbox->partition, "partition %s not found", err_partition, config->partition_label);
+    OUTBOX_CHECK(outbox->partition->size >= 2 * OUTBOX_SECTOR_SIZE && outbox->partition->size % OUTBOX_SECTOR_SIZE == 0,
+                 "partition must be at least two whole sectors", err_partition);
+    OUTBOX_CHECK(outbox_record_size(config->max_message_size) <= OUTBOX_SECTOR_SIZE, "max_message_size too large", err_partition);
+    /* Only touched while a message is stored or sent, PSRAM is fine */
+    outbox->buffer = config->buffer_caps ? heap_caps_malloc(config->max_message_size, config->buffer_caps) :
+                     malloc(config->max_message_size);
+    OUTBOX_CHECK(outbox->buffer, "malloc buffer failed", err_partition);
+    outbox->lock = xSemaphoreCreateMutex();
+    OUTBOX_CHECK(outbox->lock, "create lock failed", err_lock);
+    outbox->exit_sem = xSemaphoreCreateBinary();
+    OUTBOX_CHECK(outbox->exit_sem, "create exit semaphore failed", err_exit_sem);
+    outbox_recover(outbox);
+    outbox->running = true;
+    BaseType_t ret = xTaskCreate(outbox_task_entry, "modem_outbox", config->task_stack_size, outbox,
+                                 config->task_priority, &outbox->task_hdl);
+    OUTBOX_CHECK(ret == pdTRUE, "create outbox task failed", err_task);
+    /* Sessions are only opened while PPP is down, so the link state is always tracked */
+    esp_event_handler_register(IP_EVENT, IP_EVENT_PPP_GOT_IP, outbox_ip_event_handler, outbox);
+    esp_event_handler_register(IP_EVENT, IP_EVENT_PPP_LOST_IP, outbox_ip_event_handler, outbox);
+    return outbox;
+err_task:
+    vSemaphoreDelete(outbox->exit_sem);
+err_exit_sem:
+    vSemaphoreDelete(outbox->lock);
+err_lock:
+    free(outbox->buffer);
+err_partition:
+    free(outbox);
+err:
+    return NULL;
+}
+
+esp_err_t esp_modem_outbox_put(esp_modem_outbox_t *outbox, const void *data, size_t len)
+{
+    esp_err_t err = ESP_OK;
+    if (len > outbox->config.max_message_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    size_t size = outbox_record_size(len);
+    xSemaphoreTake(outbox->lock, portMAX_DELAY);
+    size_t offset = outbox->head;
+    if (offset % OUTBOX_SECTOR_SIZE + size > OUTBOX_SECTOR_SIZE) {
+        offset = outbox_next_sector(outbox, offset);
+    }
+    if (offset % OUTBOX_SECTOR_SIZE == 0) {
+        /* Entering a new sector, which may still hold the oldest messages */
+        if (outbox->stats.pending_messages && outbox->tail / OUTBOX_SECTOR_SIZE == offset / OUTBOX_SECTOR_SIZE) {
+            OUTBOX_CHECK(outbox->config.drop_oldest_when_full, "outbox full", err_full);
+            outbox_drop_sector(outbox, offset);
+        }
+        err = esp_partition_erase_range(outbox->partition, offset, OUTBOX_SECTOR_SIZE);
+        OUTBOX_CHECK(err == ESP_OK, "erase sector failed", err_flash);
+    }
+    outbox_record_t record = {
+        .magic = OUTBOX_MAGIC,
+        .len = len,
+        .seq = outbox->next_seq,
+        .crc = esp_rom_crc32_le(0, data, len),
+        .state = OUTBOX_STATE_PENDING
+    };
+    err = esp_partition_write(outbox->partition, offset + sizeof(record), data, len);
+    OUTBOX_CHECK(err == ESP_OK, "write payload failed", err_flash);
+    err = esp_partition_write(outbox->partition, offset, &record, sizeof(record));
+    OUTBOX_CHECK(err == ESP_OK, "write header failed", err_flash);
+    outbox->next_seq++;
+    outbox->head = offset + size;
+    if (outbox->head >= outbox->partition->size) {
+        outbox->head = 0;
+    }
+    if (outbox->stats.pending_messages == 0) {
+        outbox->tail = offset;
+        outbox->oldest_tick = xTaskGetTickCount();
+    }
+    outbox->stats.pending_messages++;
+    outbox->stats.pending_bytes += len;
+    bool threshold = outbox->stats.pending_bytes >= outbox->config.flush_size_threshold;
+    xSemaphoreGive(outbox->lock);
+    if (threshold) {
+        xTaskNotifyGive(outbox->task_hdl);
+    }
+    return ESP_OK;
+err_full:
+    xSemaphoreGive(outbox->lock);
+    return ESP_ERR_NO_MEM;
+err_flash:
+    /* do not reuse a partially written sector */
+    outbox->head = outbox_next_sector(outbox, offset);
+    xSemaphoreGive(outbox->lock);
+    return err;
+}
+
+esp_err_t esp_modem_outbox_flush(esp_modem_outbox_t *outbox)
+{
+    xSemaphoreTake(outbox->lock, portMAX_DELAY);
+    outbox->flush_requested = true;
+    xSemaphoreGive(outbox->lock);
+    xTaskNotifyGive(outbox->task_hdl);
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_outbox_get_stats(esp_modem_outbox_t *outbox, esp_modem_outbox_stats_t *stats)
+{
+    xSemaphoreTake(outbox->lock, portMAX_DELAY);
+    *stats = outbox->stats;
+    xSemaphoreGive(outbox->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_outbox_destroy(esp_modem_outbox_t *outbox)
+{
+    esp_event_handler_unregister(IP_EVENT, IP_EVENT_PPP_GOT_IP, outbox_ip_event_handler);
+    esp_event_handler_unregister(IP_EVENT, IP_EVENT_PPP_LOST_IP, outbox_ip_event_handler);
+    outbox->running = false;
+    xTaskNotifyGive(outbox->task_hdl);
+    xSemaphoreTake(outbox->exit_sem, portMAX_DELAY);
+    vSemaphoreDelete(outbox->exit_sem);
+    vSemaphoreDelete(outbox->lock);
+    free(outbox->buffer);
+    free(outbox);
+    return ESP_OK;
+}
@@ -0,0 +1,166 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_modem.h"
+#include "esp_modem_dce_service.h"
+#include "esp_modem_dte.h"
+#include "esp_modem_probe.h"
+
+#define ESP_MODEM_PROBE_SYNC_RETRIES (5)
+#define ESP_MODEM_PROBE_SYNC_DELAY_MS (500)
+#define ESP_MODEM_PROBE_ATTACH_TIMEOUT_MS (75000)
+
+static const char *TAG = "esp-modem-probe";
+#define PROBE_CHECK(a, str, goto_tag, ...)                                          \
+    do                                                                              \
+    {                                                                               \
+        if (!(a))                                                                   \
+        {                                                                           \
+            ESP_LOGE(TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__);   \
+            goto goto_tag;                                                          \
+        }                                                                           \
+    } while (0)
+
+/**
+ * @brief Send a command answered with OK or ERROR
+ */
+static esp_err_t probe_send(modem_dce_t *dce, const char *command, uint32_t timeout_ms)
+{
+    dce->handle_line = esp_modem_dce_handle_response_default;
+    if (dce->dte->send_cmd(dce->dte, command, timeout_ms) != ESP_OK || dce->state != MODEM_STATE_SUCCESS) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Wait until the DCE answers commands after leaving data and CMUX mode
+ */
+static esp_err_t probe_sync(modem_dce_t *dce)
+{
+    esp_err_t ret = ESP_FAIL;
+    /* Give the DCE the time to get out of data and CMUX mode */
+    for (int i = 0; i < ESP_MODEM_PROBE_SYNC_RETRIES && ret != ESP_OK; i++) {
+        vTaskDelay(pdMS_TO_TICKS(ESP_MODEM_PROBE_SYNC_DELAY_MS));
+        ret = dce->sync(dce);
+    }
+    return ret;
+}
+
+/**
+ * @brief Detach and attach the packet data service, the call must have been dropped
+ */
+static esp_err_t probe_reattach(modem_dce_t *dce)
+{
+    if (probe_sync(dce) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (probe_send(dce, "AT+CGATT=0\r", ESP_MODEM_PROBE_ATTACH_TIMEOUT_MS) != ESP_OK) {
+        ESP_LOGW(TAG, "detach failed");
+    }
+    return probe_send(dce, "AT+CGATT=1\r", ESP_MODEM_PROBE_ATTACH_TIMEOUT_MS);
+}
+
+esp_err_t esp_modem_probe_run(modem_dce_t *dce, const esp_modem_probe_config_t *config, esp_modem_probe_result_t *result)
+{
+    uint32_t ber = 0;
+    memset(result, 0, sizeof(esp_modem_probe_result_t));
+    if (!dce->ping) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (dce->mode == MODEM_PPP_MODE && !dce->dte->cmux) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (dce->get_signal_quality(dce, &result->rssi, &ber) != ESP_OK) {
+        result->verdict = ESP_MODEM_PROBE_NO_RESPONSE;
+        goto done;
+    }
+    if (result->rssi == ESP_MODEM_RSSI_UNKNOWN) {
+        result->verdict = ESP_MODEM_PROBE_NO_SIGNAL;
+        goto done;
+    }
+    const char *target = config->host;
+    if (config->resolve && dce->resolve) {
+        int64_t start = esp_timer_get_time();
+        result->resolved = dce->resolve(dce, config->host, result->ip, sizeof(result->ip)) == ESP_OK;
+        result->resolve_ms = (esp_timer_get_time() - start) / 1000;
+        if (!result->resolved) {
+            result->verdict = ESP_MODEM_PROBE_NO_DATA;
+            goto done;
+        }
+        target = result->ip;
+    }
+    if (dce->ping(dce, target, config->count, config->timeout_ms, &result->ping) != ESP_OK ||
+        result->ping.sent == 0) {
+        result->loss_percent = 100;
+        result->verdict = ESP_MODEM_PROBE_NO_DATA;
+        goto done;
+    }
+    result->loss_percent = 100 - result->ping.received * 100 / result->ping.sent;
+    result->verdict = result->loss_percent <= config->max_loss_percent ? ESP_MODEM_PROBE_NETWORK_OK : ESP_MODEM_PROBE_NO_DATA;
+done:
+    ESP_LOGI(TAG, "verdict %d, rssi %d, loss %d%%, rtt %d/%d/%d ms", result->verdict, result->rssi, result->loss_percent,
+             result->ping.rtt_min_ms, result->ping.rtt_avg_ms, result->ping.rtt_max_ms);
+    return ESP_OK;
+}
+
+/**
+ * @brief Reset the DTE of a silent DCE and set the PPP session up again
+ *
+ * A silent DCE cannot hang up, so the call is not suspended but stopped with
+ * esp_modem_dte_reset(), which also stops the PPP session of the network interface.
+ */
+static esp_err_t probe_restart(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    PROBE_CHECK(esp_modem_dte_reset(dte) == ESP_OK, "DTE reset failed", err);
+    if (probe_sync(dce) != ESP_OK) {
+        ESP_LOGE(TAG, "modem does not respond after DTE reset");
+        return ESP_ERR_TIMEOUT;
+    }
+    if (dte->cmux) {
+        PROBE_CHECK(esp_modem_start_cmux(dte) == ESP_OK, "start cmux failed", err);
+    }
+    PROBE_CHECK(esp_modem_start_ppp(dte) == ESP_OK, "dial failed", err);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_probe_recover(modem_dce_t *dce, const esp_modem_probe_result_t *result)
+{
+    modem_dte_t *dte = dce->dte;
+    if (result->verdict == ESP_MODEM_PROBE_NO_SIGNAL) {
+        return ESP_OK;
+    }
+    if (dce->mode != MODEM_PPP_MODE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    ESP_LOGI(TAG, "recovering from verdict %d", result->verdict);
+    if (result->verdict == ESP_MODEM_PROBE_NO_RESPONSE) {
+        return probe_restart(dce);
+    }
+    PROBE_CHECK(esp_modem_suspend_ppp(dte) == ESP_OK, "drop data call failed", err);
+    if (result->verdict == ESP_MODEM_PROBE_NO_DATA) {
+        PROBE_CHECK(probe_reattach(dce) == ESP_OK, "re-attach failed", err);
+    }
+    PROBE_CHECK(esp_modem_resume_ppp(dte) == ESP_OK, "dial failed", err);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
@@ -0,0 +1,285 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_modem_scheduler.h"
+
+static const char *TAG = "esp-modem-sched";
+#define SCHED_CHECK(a, str, goto_tag, ...)                                          \
+    do                                                                              \
+    {                                                                               \
+        if (!(a))                                                                   \
+        {                                                                           \
+            ESP_LOGE(TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__);   \
+            goto goto_tag;                                                          \
+        }                                                                           \
+    } while (0)
+
+/**
+ * @brief Pending transfer
+ *
+ */
+typedef struct {
+    bool used;                      /*!< Slot holds a pending transfer */
+    uint8_t transfer_class;         /*!< Statistics class */
+    size_t size_hint;               /*!< Expected transfer size */
+    uint32_t submit_rssi;           /*!< Signal quality at submission */
+    TickType_t submit_tick;         /*!< Submission time */
+    TickType_t deadline_tick;       /*!< Latest start time */
+    esp_modem_transfer_cb_t cb;     /*!< Transfer callback */
+    void *ctx;                      /*!< Transfer callback context */
+} esp_modem_transfer_t;
+
+struct esp_modem_scheduler {
+    modem_dce_t *dce;                                               /*!< DCE used for AT+CSQ by esp_modem_scheduler_sample_signal() */
+    esp_modem_scheduler_config_t config;                            /*!< Scheduler configuration */
+    esp_modem_transfer_t *transfers;                                /*!< Pending transfer slots */
+    esp_modem_scheduler_stats_t stats[ESP_MODEM_SCHEDULER_MAX_CLASSES]; /*!< Per-class statistics */
+    uint32_t rssi;                                                  /*!< Last signal sample */
+    TickType_t rssi_tick;                                           /*!< Time of the last signal sample */
+    bool rssi_valid;                                                /*!< At least one sample has been taken */
+    TickType_t attempt_tick;                                        /*!< Time of the last AT+CSQ of esp_modem_scheduler_sample_signal() */
+    bool attempted;                                                 /*!< esp_modem_scheduler_sample_signal() has sent AT+CSQ */
+    SemaphoreHandle_t lock;                                         /*!< Protects transfers, stats and sample */
+    SemaphoreHandle_t exit_sem;                                     /*!< Given by the task when it exits */
+    TaskHandle_t task_hdl;                                          /*!< Scheduler task */
+    volatile bool running;                                          /*!< Cleared to stop the task */
+};
+
+/**
+ * @brief Relative airtime of a transfer at the given signal quality (1000 = good signal)
+ *
+ * Coarse model of how much longer the same payload takes when the link adapts
+ * to a weaker signal (lower modulation/coding, retransmissions).
+ */
+static uint32_t rssi_cost_factor(uint32_t rssi)
+{
+    if (rssi == ESP_MODEM_RSSI_UNKNOWN || rssi < 5) {
+        return 10000;
+    } else if (rssi < 10) {
+        return 5000;
+    } else if (rssi < 15) {
+        return 2500;
+    } else if (rssi < 20) {
+        return 1500;
+    }
+    return 1000;
+}
+
+/**
+ * @brief Check for pending transfers, called with the lock held
+ */
+static bool sched_pending(esp_modem_scheduler_t *sched)
+{
+    for (int i = 0; i < sched->config.max_transfers; i++) {
+        if (sched->transfers[i].used) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Account a released transfer into the statistics of its class
+ */
+static void sched_account(esp_modem_scheduler_t *sched, const esp_modem_transfer_t *transfer,
+                          uint32_t rssi, bool on_signal, TickType_t now)
+{
+    esp_modem_scheduler_stats_t *stats = &sched->stats[transfer->transfer_class];
+    stats->released++;
+    if (on_signal) {
+        stats->released_on_signal++;
+    } else {
+        stats->released_on_deadline++;
+    }
+    stats->bytes += transfer->size_hint;
+    stats->wait_ms += pdTICKS_TO_MS(now - transfer->submit_tick);
+    /* airtime of the transfer had it started right away vs. now */
+    int64_t nominal_ms = (int64_t)transfer->size_hint * sched->config.nominal_ms_per_kib / 1024;
+    int64_t saved_ms = nominal_ms * ((int64_t)rssi_cost_factor(transfer->submit_rssi) - rssi_cost_factor(rssi)) / 1000;
+    stats->time_saved_ms += saved_ms;
+    stats->energy_saved_uah += saved_ms * sched->config.active_current_ma / 3600;
+}
+
+/**
+ * @brief Scheduler Task Entry
+ *
+ * @param param task parameter
+ */
+static void sched_task_entry(void *param)
+{
+    esp_modem_scheduler_t *sched = (esp_modem_scheduler_t *)param;
+    TickType_t margin = pdMS_TO_TICKS(sched->config.deadline_margin_ms);
+    while (sched->running) {
+        xSemaphoreTake(sched->lock, portMAX_DELAY);
+        bool pending = sched_pending(sched);
+        xSemaphoreGive(sched->lock);
+        TickType_t now = xTaskGetTickCount();
+        TickType_t next_wakeup = pdMS_TO_TICKS(sched->config.sample_interval_ms ? sched->config.sample_interval_ms : 1000);
+        for (int i = 0; i < sched->config.max_transfers; i++) {
+            xSemaphoreTake(sched->lock, portMAX_DELAY);
+            esp_modem_transfer_t transfer = sched->transfers[i];
+            uint32_t rssi = sched->rssi_valid ? sched->rssi : ESP_MODEM_RSSI_UNKNOWN;
+            bool on_signal = rssi != ESP_MODEM_RSSI_UNKNOWN && rssi >= sched->config.rssi_threshold;
+            TickType_t left = (int32_t)(transfer.deadline_tick - now) > 0 ? transfer.deadline_tick - now : 0;
+            bool release = transfer.used && (on_signal || left <= margin);
+            if (release) {
+                sched->transfers[i].used = false;
+                sched_account(sched, &transfer, rssi, on_signal, now);
+            } else if (transfer.used && left - margin < next_wakeup) {
+                next_wakeup = left - margin;
+            }
+            xSemaphoreGive(sched->lock);
+            if (release) {
+                ESP_LOGD(TAG, "release class %d transfer at rssi %d (%s)", transfer.transfer_class, rssi,
+                         on_signal ? "signal" : "deadline");
+                transfer.cb(rssi, transfer.ctx);
+            }
+        }
+        ulTaskNotifyTake(pdTRUE, pending ? next_wakeup : portMAX_DELAY);
+    }
+    xSemaphoreGive(sched->exit_sem);
+    vTaskDelete(NULL);
+}
+
+esp_modem_scheduler_t *esp_modem_scheduler_create(modem_dce_t *dce, const esp_modem_scheduler_config_t *config)
+{
+    SCHED_CHECK(dce, "scheduler needs a DCE", err);
+    SCHED_CHECK(config && config->max_transfers > 0, "invalid configuration", err);
+    esp_modem_scheduler_t *sched = calloc(1, sizeof(esp_modem_scheduler_t));
+    SCHED_CHECK(sched, "calloc scheduler failed", err);
+    sched->transfers = calloc(config->max_transfers, sizeof(esp_modem_transfer_t));
+    SCHED_CHECK(sched->transfers, "calloc transfers failed", err_transfers);
+    sched->dce = dce;
+    sched->config = *config;
+    sched->rssi = ESP_MODEM_RSSI_UNKNOWN;
+    sched->lock = xSemaphoreCreateMutex();
+    SCHED_CHECK(sched->lock, "create lock failed", err_lock);
+    sched->exit_sem = xSemaphoreCreateBinary();
+    SCHED_CHECK(sched->exit_sem, "create exit semaphore failed", err_exit_sem);
+    sched->running = true;
+    BaseType_t ret = xTaskCreate(sched_task_entry, "modem_sched", config->task_stack_size, sched,
+                                 config->task_priority, &sched->task_hdl);
+    SCHED_CHECK(ret == pdTRUE, "create scheduler task failed", err_task);
+    return sched;
+err_task:
+    vSemaphoreDelete(sched->exit_sem);
+err_exit_sem:
+    vSemaphoreDelete(sched->lock);
+err_lock:
+    free(sched->transfers);
+err_transfers:
+    free(sched);
+err:
+    return NULL;
+}
+
+esp_err_t esp_modem_scheduler_submit(esp_modem_scheduler_t *sched, uint8_t transfer_class, size_t size_hint,
+                                     uint32_t deadline_ms, esp_modem_transfer_cb_t cb, void *ctx)
+{
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    if (transfer_class >= ESP_MODEM_SCHEDULER_MAX_CLASSES || cb == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(sched->lock, portMAX_DELAY);
+    for (int i = 0; i < sched->config.max_transfers; i++) {
+        esp_modem_transfer_t *transfer = &sched->transfers[i];
+        if (!transfer->used) {
+            transfer->used = true;
+            transfer->transfer_class = transfer_class;
+            transfer->size_hint = size_hint;
+            transfer->submit_rssi = sched->rssi_valid ? sched->rssi : ESP_MODEM_RSSI_UNKNOWN;
+            transfer->submit_tick = xTaskGetTickCount();
+            transfer->deadline_tick = transfer->submit_tick + pdMS_TO_TICKS(deadline_ms);
+            transfer->cb = cb;
+            transfer->ctx = ctx;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    xSemaphoreGive(sched->lock);
+    if (ret == ESP_OK) {
+        xTaskNotifyGive(sched->task_hdl);
+    } else {
+        ESP_LOGW(TAG, "no free transfer slot");
+    }
+    return ret;
+}
+
+esp_err_t esp_modem_scheduler_update_signal(esp_modem_scheduler_t *sched, uint32_t rssi)
+{
+    xSemaphoreTake(sched->lock, portMAX_DELAY);
+    bool crossed = rssi != ESP_MODEM_RSSI_UNKNOWN && rssi >= sched->config.rssi_threshold &&
+                   (!sched->rssi_valid || sched->rssi == ESP_MODEM_RSSI_UNKNOWN || sched->rssi < sched->config.rssi_threshold);
+    sched->rssi = rssi;
+    sched->rssi_tick = xTaskGetTickCount();
+    sched->rssi_valid = true;
+    xSemaphoreGive(sched->lock);
+    if (crossed) {
+        xTaskNotifyGive(sched->task_hdl);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_scheduler_sample_signal(esp_modem_scheduler_t *sched)
+{
+    xSemaphoreTake(sched->lock, portMAX_DELAY);
+    TickType_t now = xTaskGetTickCount();
+    TickType_t interval = pdMS_TO_TICKS(sched->config.sample_interval_ms);
+    /* A failed query leaves the sample stale, so the last attempt also limits the rate */
+    bool needed = sched->config.sample_interval_ms != 0 && sched_pending(sched) &&
+                  (!sched->rssi_valid || (now - sched->rssi_tick) >= interval) &&
+                  (!sched->attempted || (now - sched->attempt_tick) >= interval);
+    if (needed) {
+        sched->attempt_tick = now;
+        sched->attempted = true;
+    }
+    xSemaphoreGive(sched->lock);
+    if (!needed) {
+        return ESP_OK;
+    }
+    uint32_t rssi = ESP_MODEM_RSSI_UNKNOWN, ber = 0;
+    if (sched->dce->get_signal_quality(sched->dce, &rssi, &ber) != ESP_OK) {
+        ESP_LOGW(TAG, "signal quality query failed");
+        return ESP_FAIL;
+    }
+    return esp_modem_scheduler_update_signal(sched, rssi);
+}
+
+esp_err_t esp_modem_scheduler_get_stats(esp_modem_scheduler_t *sched, uint8_t transfer_class, esp_modem_scheduler_stats_t *stats)
+{
+    if (transfer_class >= ESP_MODEM_SCHEDULER_MAX_CLASSES || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(sched->lock, portMAX_DELAY);
+    *stats = sched->stats[transfer_class];
+    xSemaphoreGive(sched->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_scheduler_destroy(esp_modem_scheduler_t *sched)
+{
+    sched->running = false;
+    xTaskNotifyGive(sched->task_hdl);
+    xSemaphoreTake(sched->exit_sem, portMAX_DELAY);
+    vSemaphoreDelete(sched->exit_sem);
+    vSemaphoreDelete(sched->lock);
+    free(sched->transfers);
+    free(sched);
+    return ESP_OK;
+}
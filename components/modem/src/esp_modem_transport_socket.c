@@ -0,0 +1,281 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sdkconfig.h"
+#if CONFIG_COMPONENT_MODEM_TRANSPORT_SOCKET
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_modem.h"
+#include "esp_modem_transport.h"
+
+static const char *TAG = "esp-modem-socket";
+#define SOCKET_CHECK(a, str, goto_tag, ...)                                         \
+    do                                                                              \
+    {                                                                               \
+        if (!(a))                                                                   \
+        {                                                                           \
+            ESP_LOGE(TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__);   \
+            goto goto_tag;                                                          \
+        }                                                                           \
+    } while (0)
+
+/**
+ * @brief File descriptor transport, either a TCP socket or a tty/pty device
+ *
+ * Neither can detect lines, so wait() only reports data and the DTE splits
+ * lines itself.
+ */
+typedef struct {
+    int fd;                                 /*!< Socket or device file descriptor */
+    char *host;                             /*!< TCP host, NULL for a device */
+    uint16_t port;                          /*!< TCP port */
+    char *path;                             /*!< Device path, NULL for TCP */
+    volatile bool wakeup;                   /*!< wakeup() was called */
+    esp_modem_transport_mode_t mode;        /*!< Receive mode */
+    esp_modem_transport_t parent;           /*!< Transport interface that should extend */
+} esp_modem_fd_transport_t;
+
+static speed_t fd_transport_speed(uint32_t baud_rate)
+{
+    switch (baud_rate) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default: return B115200;
+    }
+}
+
+static esp_err_t fd_transport_open(esp_modem_transport_t *transport, const struct esp_modem_dte_config *config)
+{
+    esp_modem_fd_transport_t *fdt = __containerof(transport, esp_modem_fd_transport_t, parent);
+    if (fdt->host) {
+        struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+        struct addrinfo *res = NULL;
+        char port[8];
+        snprintf(port, sizeof(port), "%u", fdt->port);
+        SOCKET_CHECK(getaddrinfo(fdt->host, port, &hints, &res) == 0 && res, "resolve %s failed", err, fdt->host);
+        fdt->fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        if (fdt->fd >= 0 && connect(fdt->fd, res->ai_addr, res->ai_addrlen) != 0) {
+            close(fdt->fd);
+            fdt->fd = -1;
+        }
+        freeaddrinfo(res);
+        SOCKET_CHECK(fdt->fd >= 0, "connect to %s:%u failed", err, fdt->host, fdt->port);
+    } else {
+        struct termios tty;
+        fdt->fd = open(fdt->path, O_RDWR | O_NOCTTY);
+        SOCKET_CHECK(fdt->fd >= 0, "open %s failed", err, fdt->path);
+        /* ptys do not support termios on every host, raw mode is best effort */
+        if (tcgetattr(fdt->fd, &tty) == 0) {
+            cfmakeraw(&tty);
+            cfsetspeed(&tty, fd_transport_speed(config->baud_rate));
+            if (config->flow_control == MODEM_FLOW_CONTROL_HW) {
+                tty.c_cflag |= CRTSCTS;
+            }
+            tcsetattr(fdt->fd, TCSANOW, &tty);
+        }
+    }
+    fdt->mode = ESP_MODEM_TRANSPORT_MODE_LINE;
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Wait until the descriptor is readable
+ *
+ * @return 1 if readable, 0 on timeout, -1 on error
+ */
+static int fd_transport_select(esp_modem_fd_transport_t *fdt, uint32_t timeout_ms)
+{
+    fd_set rfds;
+    struct timeval tv = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+    FD_ZERO(&rfds);
+    FD_SET(fdt->fd, &rfds);
+    return select(fdt->fd + 1, &rfds, NULL, NULL, &tv);
+}
+
+static int fd_transport_read(esp_modem_transport_t *transport, uint8_t *data, size_t len, uint32_t timeout_ms)
+{
+    esp_modem_fd_transport_t *fdt = __containerof(transport, esp_modem_fd_transport_t, parent);
+    size_t total = 0;
+    /* like uart_read_bytes(), block until len bytes or the timeout */
+    while (total < len) {
+        int ret = fd_transport_select(fdt, timeout_ms == portMAX_DELAY ? 1000 : timeout_ms);
+        if (ret == 0 && timeout_ms == portMAX_DELAY) {
+            continue;
+        }
+        if (ret <= 0) {
+            break;
+        }
+        ret = read(fdt->fd, &data[total], len - total);
+        if (ret <= 0) {
+            break;
+        }
+        total += ret;
+    }
+    return total;
+}
+
+static int fd_transport_write(esp_modem_transport_t *transport, const void *data, size_t len)
+{
+    esp_modem_fd_transport_t *fdt = __containerof(transport, esp_modem_fd_transport_t, parent);
+    size_t total = 0;
+    while (total < len) {
+        int ret = write(fdt->fd, (const uint8_t *)data + total, len - total);
+        if (ret <= 0) {
+            return -1;
+        }
+        total += ret;
+    }
+    return total;
+}
+
+static esp_modem_transport_event_t fd_transport_wait(esp_modem_transport_t *transport, size_t *len, uint32_t timeout_ms)
+{
+    esp_modem_fd_transport_t *fdt = __containerof(transport, esp_modem_fd_transport_t, parent);
+    int available = 0;
+    *len = 0;
+    if (fdt->wakeup) {
+        fdt->wakeup = false;
+        return ESP_MODEM_TRANSPORT_EVENT_WAKEUP;
+    }
+    if (fdt->mode == ESP_MODEM_TRANSPORT_MODE_PAUSED) {
+        vTaskDelay(pdMS_TO_TICKS(timeout_ms));
+        return ESP_MODEM_TRANSPORT_EVENT_NONE;
+    }
+    int ret = fd_transport_select(fdt, timeout_ms);
+    if (ret < 0) {
+        return ESP_MODEM_TRANSPORT_EVENT_ERROR;
+    }
+    if (ret == 0 || ioctl(fdt->fd, FIONREAD, &available) != 0) {
+        return ESP_MODEM_TRANSPORT_EVENT_NONE;
+    }
+    if (available == 0) {
+        /* readable with nothing to read: the peer closed the connection */
+        ESP_LOGW(TAG, "connection closed");
+        vTaskDelay(pdMS_TO_TICKS(timeout_ms));
+        return ESP_MODEM_TRANSPORT_EVENT_ERROR;
+    }
+    *len = available;
+    return ESP_MODEM_TRANSPORT_EVENT_DATA;
+}
+
+static esp_err_t fd_transport_wakeup(esp_modem_transport_t *transport)
+{
+    esp_modem_fd_transport_t *fdt = __containerof(transport, esp_modem_fd_transport_t, parent);
+    /* picked up by wait() on its next round, within one event task period */
+    fdt->wakeup = true;
+    return ESP_OK;
+}
+
+static esp_err_t fd_transport_flush(esp_modem_transport_t *transport)
+{
+    esp_modem_fd_transport_t *fdt = __containerof(transport, esp_modem_fd_transport_t, parent);
+    uint8_t discard[64];
+    while (fd_transport_select(fdt, 0) > 0 && read(fdt->fd, discard, sizeof(discard)) > 0) {
+    }
+    return ESP_OK;
+}
+
+static esp_err_t fd_transport_set_mode(esp_modem_transport_t *transport, esp_modem_transport_mode_t mode)
+{
+    esp_modem_fd_transport_t *fdt = __containerof(transport, esp_modem_fd_transport_t, parent);
+    fdt->mode = mode;
+    return ESP_OK;
+}
+
+static esp_err_t fd_transport_set_baud(esp_modem_transport_t *transport, uint32_t baud_rate)
+{
+    esp_modem_fd_transport_t *fdt = __containerof(transport, esp_modem_fd_transport_t, parent);
+    struct termios tty;
+    if (fdt->host || tcgetattr(fdt->fd, &tty) != 0) {
+        /* the bridge owns the serial settings */
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    cfsetspeed(&tty, fd_transport_speed(baud_rate));
+    return tcsetattr(fdt->fd, TCSANOW, &tty) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t fd_transport_deinit(esp_modem_transport_t *transport)
+{
+    esp_modem_fd_transport_t *fdt = __containerof(transport, esp_modem_fd_transport_t, parent);
+    if (fdt->fd >= 0) {
+        close(fdt->fd);
+    }
+    free(fdt->host);
+    free(fdt->path);
+    free(fdt);
+    return ESP_OK;
+}
+
+static esp_modem_fd_transport_t *fd_transport_create(void)
+{
+    esp_modem_fd_transport_t *fdt = calloc(1, sizeof(esp_modem_fd_transport_t));
+    SOCKET_CHECK(fdt, "calloc transport failed", err);
+    fdt->fd = -1;
+    fdt->parent.open = fd_transport_open;
+    fdt->parent.read = fd_transport_read;
+    fdt->parent.write = fd_transport_write;
+    fdt->parent.wait = fd_transport_wait;
+    fdt->parent.wakeup = fd_transport_wakeup;
+    fdt->parent.flush = fd_transport_flush;
+    fdt->parent.set_mode = fd_transport_set_mode;
+    fdt->parent.set_baud = fd_transport_set_baud;
+    fdt->parent.deinit = fd_transport_deinit;
+    return fdt;
+err:
+    return NULL;
+}
+
+esp_modem_transport_t *esp_modem_transport_tcp_create(const char *host, uint16_t port)
+{
+    esp_modem_fd_transport_t *fdt = fd_transport_create();
+    SOCKET_CHECK(fdt, "create transport failed", err);
+    fdt->host = strdup(host);
+    fdt->port = port;
+    SOCKET_CHECK(fdt->host, "strdup host failed", err_host);
+    return &fdt->parent;
+err_host:
+    free(fdt);
+err:
+    return NULL;
+}
+
+esp_modem_transport_t *esp_modem_transport_tty_create(const char *path)
+{
+    esp_modem_fd_transport_t *fdt = fd_transport_create();
+    SOCKET_CHECK(fdt, "create transport failed", err);
+    fdt->path = strdup(path);
+    SOCKET_CHECK(fdt->path, "strdup path failed", err_path);
+    return &fdt->parent;
+err_path:
+    free(fdt);
+err:
+    return NULL;
+}
+#endif // CONFIG_COMPONENT_MODEM_TRANSPORT_SOCKET
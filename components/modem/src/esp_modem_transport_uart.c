@@ -0,0 +1,333 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_modem.h"
+#include "esp_modem_transport.h"
+
+#define MIN_PATTERN_INTERVAL (9)
+#define MIN_POST_IDLE (0)
+#define MIN_PRE_IDLE (0)
+
+/* FIFO thresholds of the hardware flow control */
+#define UART_FLOW_CTRL_RX_THRESH (UART_FIFO_LEN - 8)
+#define UART_XON_THRESH (8)
+
+/* Pseudo UART event posted to the event queue by the wakeup method */
+#define UART_TRANSPORT_WAKEUP_EVENT (UART_EVENT_MAX)
+
+static const char *TAG = "esp-modem-uart";
+#define UART_CHECK(a, str, goto_tag, ...)                                           \
+    do                                                                              \
+    {                                                                               \
+        if (!(a))                                                                   \
+        {                                                                           \
+            ESP_LOGE(TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__);   \
+            goto goto_tag;                                                          \
+        }                                                                           \
+    } while (0)
+
+/**
+ * @brief UART transport
+ *
+ */
+typedef struct {
+    uart_port_t uart_port;                  /*!< UART port */
+    QueueHandle_t event_queue;              /*!< UART event queue handle */
+    bool installed;                         /*!< UART driver is installed */
+    modem_flow_ctrl_t flow_control;         /*!< Flow control type */
+    bool rx_paced;                          /*!< The peer stops before the receive buffer overflows */
+    esp_modem_transport_watermarks_t watermarks;    /*!< Peak usage */
+    esp_modem_transport_t parent;           /*!< Transport interface that should extend */
+} esp_modem_uart_transport_t;
+
+static esp_err_t uart_transport_open(esp_modem_transport_t *transport, const struct esp_modem_dte_config *config)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    esp_err_t res;
+    uart->uart_port = config->port_num;
+    uart->flow_control = config->flow_control;
+    /* Line mode, with RTS or the driver's XON/XOFF */
+    uart->rx_paced = config->flow_control != MODEM_FLOW_CONTROL_NONE;
+    /* Config UART */
+    uart_config_t uart_config = {
+        .baud_rate = config->baud_rate,
+        .data_bits = config->data_bits,
+        .parity = config->parity,
+        .stop_bits = config->stop_bits,
+        .source_clk = UART_SCLK_REF_TICK,
+        .flow_ctrl = (config->flow_control == MODEM_FLOW_CONTROL_HW) ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE
+    };
+    UART_CHECK(uart_param_config(uart->uart_port, &uart_config) == ESP_OK, "config uart parameter failed", err);
+    if (config->flow_control == MODEM_FLOW_CONTROL_HW) {
+        res = uart_set_pin(uart->uart_port, config->tx_io_num, config->rx_io_num,
+                           config->rts_io_num, config->cts_io_num);
+    } else {
+        res = uart_set_pin(uart->uart_port, config->tx_io_num, config->rx_io_num,
+                           UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    }
+    UART_CHECK(res == ESP_OK, "config uart gpio failed", err);
+    /* Set flow control threshold */
+    if (config->flow_control == MODEM_FLOW_CONTROL_HW) {
+        res = uart_set_hw_flow_ctrl(uart->uart_port, UART_HW_FLOWCTRL_CTS_RTS, UART_FLOW_CTRL_RX_THRESH);
+    } else if (config->flow_control == MODEM_FLOW_CONTROL_SW) {
+        res = uart_set_sw_flow_ctrl(uart->uart_port, true, UART_XON_THRESH, UART_FLOW_CTRL_RX_THRESH);
+    }
+    UART_CHECK(res == ESP_OK, "config uart flow control failed", err);
+    /* Install UART driver and get event queue used inside driver */
+    res = uart_driver_install(uart->uart_port, config->rx_buffer_size, config->tx_buffer_size,
+                              config->event_queue_size, &(uart->event_queue), 0);
+    UART_CHECK(res == ESP_OK, "install uart driver failed", err);
+    uart->installed = true;
+    res = uart_set_rx_timeout(uart->uart_port, 1);
+    UART_CHECK(res == ESP_OK, "set rx timeout failed", err);
+    if (config->uart_wakeup_threshold > 0) {
+        /* The edges counted for the wakeup are not received */
+        res = uart_set_wakeup_threshold(uart->uart_port, config->uart_wakeup_threshold);
+        res |= esp_sleep_enable_uart_wakeup(uart->uart_port);
+        UART_CHECK(res == ESP_OK, "config uart wakeup failed", err);
+    }
+    /* Set pattern interrupt, used to detect the end of a line. */
+    res = uart_enable_pattern_det_baud_intr(uart->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
+    /* Set pattern queue size */
+    res |= uart_pattern_queue_reset(uart->uart_port, config->pattern_queue_size);
+    /* Starting in command mode -> explicitly disable RX interrupt */
+    uart_disable_rx_intr(uart->uart_port);
+    UART_CHECK(res == ESP_OK, "config uart pattern failed", err);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+static int uart_transport_read(esp_modem_transport_t *transport, uint8_t *data, size_t len, uint32_t timeout_ms)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    return uart_read_bytes(uart->uart_port, data, len, pdMS_TO_TICKS(timeout_ms));
+}
+
+static int uart_transport_write(esp_modem_transport_t *transport, const void *data, size_t len)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    uart->watermarks.tx_write = MAX(uart->watermarks.tx_write, len);
+    return uart_write_bytes(uart->uart_port, data, len);
+}
+
+static esp_err_t uart_transport_flush(esp_modem_transport_t *transport)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    uart_flush_input(uart->uart_port);
+    xQueueReset(uart->event_queue);
+    /* Drop positions of patterns which were flushed */
+    while (uart_pattern_pop_pos(uart->uart_port) != -1) {
+    }
+    return ESP_OK;
+}
+
+static esp_modem_transport_event_t uart_transport_wait(esp_modem_transport_t *transport, size_t *len, uint32_t timeout_ms)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    uart_event_t event;
+    int pos;
+    size_t buffered = 0;
+    *len = 0;
+    if (!xQueueReceive(uart->event_queue, &event, pdMS_TO_TICKS(timeout_ms))) {
+        return ESP_MODEM_TRANSPORT_EVENT_NONE;
+    }
+    if (event.type == UART_TRANSPORT_WAKEUP_EVENT) {
+        return ESP_MODEM_TRANSPORT_EVENT_WAKEUP;
+    }
+    /* the received event plus those still queued */
+    size_t waiting = uxQueueMessagesWaiting(uart->event_queue) + 1;
+    uart->watermarks.event_queue = MAX(uart->watermarks.event_queue, waiting);
+    switch (event.type) {
+    case UART_DATA:
+        uart_get_buffered_data_len(uart->uart_port, len);
+        uart->watermarks.rx_buffer = MAX(uart->watermarks.rx_buffer, *len);
+        return ESP_MODEM_TRANSPORT_EVENT_DATA;
+    case UART_PATTERN_DET:
+        /* each queued event may be a line whose position is still in the pattern queue */
+        uart->watermarks.pattern_queue = MAX(uart->watermarks.pattern_queue, waiting);
+        pos = uart_pattern_pop_pos(uart->uart_port);
+        if (pos == -1) {
+            ESP_LOGW(TAG, "Pattern Queue Size too small");
+            uart->watermarks.overflows++;
+            uart_flush(uart->uart_port);
+            return ESP_MODEM_TRANSPORT_EVENT_OVERFLOW;
+        }
+        uart_get_buffered_data_len(uart->uart_port, &buffered);
+        uart->watermarks.rx_buffer = MAX(uart->watermarks.rx_buffer, buffered);
+        /* one line, including '\n' */
+        *len = pos + 1;
+        return ESP_MODEM_TRANSPORT_EVENT_LINE;
+    case UART_FIFO_OVF:
+        ESP_LOGW(TAG, "HW FIFO Overflow");
+        uart->watermarks.overflows++;
+        uart_flush_input(uart->uart_port);
+        xQueueReset(uart->event_queue);
+        return ESP_MODEM_TRANSPORT_EVENT_OVERFLOW;
+    case UART_BUFFER_FULL:
+        if (uart->rx_paced) {
+            /* The driver keeps the rest in the FIFO and flow control holds off the
+             * modem, nothing is lost once the ring is read */
+            ESP_LOGD(TAG, "Ring Buffer Full");
+            uart_get_buffered_data_len(uart->uart_port, len);
+            return ESP_MODEM_TRANSPORT_EVENT_DATA;
+        }
+        ESP_LOGW(TAG, "Ring Buffer Full");
+        uart->watermarks.overflows++;
+        uart_flush_input(uart->uart_port);
+        xQueueReset(uart->event_queue);
+        return ESP_MODEM_TRANSPORT_EVENT_OVERFLOW;
+    case UART_BREAK:
+        ESP_LOGW(TAG, "Rx Break");
+        return ESP_MODEM_TRANSPORT_EVENT_ERROR;
+    case UART_PARITY_ERR:
+        ESP_LOGE(TAG, "Parity Error");
+        return ESP_MODEM_TRANSPORT_EVENT_ERROR;
+    case UART_FRAME_ERR:
+        ESP_LOGE(TAG, "Frame Error");
+        return ESP_MODEM_TRANSPORT_EVENT_ERROR;
+    default:
+        ESP_LOGW(TAG, "unknown uart event type: %d", event.type);
+        return ESP_MODEM_TRANSPORT_EVENT_NONE;
+    }
+}
+
+static esp_err_t uart_transport_wakeup(esp_modem_transport_t *transport)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    uart_event_t event = { .type = UART_TRANSPORT_WAKEUP_EVENT };
+    return xQueueSend(uart->event_queue, &event, portMAX_DELAY) == pdTRUE ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t uart_transport_set_mode(esp_modem_transport_t *transport, esp_modem_transport_mode_t mode)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    switch (mode) {
+    case ESP_MODEM_TRANSPORT_MODE_LINE:
+        uart_disable_rx_intr(uart->uart_port);
+        uart_enable_pattern_det_baud_intr(uart->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
+        if (uart->flow_control == MODEM_FLOW_CONTROL_SW) {
+            uart_set_sw_flow_ctrl(uart->uart_port, true, UART_XON_THRESH, UART_FLOW_CTRL_RX_THRESH);
+        }
+        uart->rx_paced = uart->flow_control != MODEM_FLOW_CONTROL_NONE;
+        break;
+    case ESP_MODEM_TRANSPORT_MODE_DATA:
+        uart_disable_pattern_det_intr(uart->uart_port);
+        uart_enable_rx_intr(uart->uart_port);
+        /* XON/XOFF bytes are data in CMUX frames and in PPP with a zero ACCM */
+        if (uart->flow_control == MODEM_FLOW_CONTROL_SW) {
+            uart_set_sw_flow_ctrl(uart->uart_port, false, 0, 0);
+        }
+        /* Only RTS holds off the modem until the DTE reports CMUX flow control */
+        uart->rx_paced = uart->flow_control == MODEM_FLOW_CONTROL_HW;
+        break;
+    case ESP_MODEM_TRANSPORT_MODE_PAUSED:
+        uart_disable_pattern_det_intr(uart->uart_port);
+        uart_disable_rx_intr(uart->uart_port);
+        break;
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t uart_transport_set_baud(esp_modem_transport_t *transport, uint32_t baud_rate)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    return uart_set_baudrate(uart->uart_port, baud_rate);
+}
+
+static bool uart_transport_tx_idle(esp_modem_transport_t *transport)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    return uart_wait_tx_done(uart->uart_port, 0) == ESP_OK;
+}
+
+static esp_err_t uart_transport_set_rx_moderation(esp_modem_transport_t *transport, uint8_t fifo_threshold, uint8_t timeout)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    esp_err_t res = uart_set_rx_full_threshold(uart->uart_port, fifo_threshold);
+    res |= uart_set_rx_timeout(uart->uart_port, timeout);
+    return res == ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t uart_transport_set_rx_throttle(esp_modem_transport_t *transport, bool throttle)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    esp_err_t res;
+    if (uart->flow_control != MODEM_FLOW_CONTROL_HW) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (throttle) {
+        /* RTS can only be driven by software while the hardware does not control it */
+        res = uart_set_hw_flow_ctrl(uart->uart_port, UART_HW_FLOWCTRL_CTS, 0);
+        res |= uart_set_rts(uart->uart_port, 0);
+    } else {
+        res = uart_set_hw_flow_ctrl(uart->uart_port, UART_HW_FLOWCTRL_CTS_RTS, UART_FLOW_CTRL_RX_THRESH);
+    }
+    return res == ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t uart_transport_set_rx_paced(esp_modem_transport_t *transport, bool paced)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    uart->rx_paced = uart->flow_control == MODEM_FLOW_CONTROL_HW || paced;
+    return ESP_OK;
+}
+
+static esp_err_t uart_transport_get_watermarks(esp_modem_transport_t *transport, esp_modem_transport_watermarks_t *watermarks)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    *watermarks = uart->watermarks;
+    return ESP_OK;
+}
+
+static esp_err_t uart_transport_deinit(esp_modem_transport_t *transport)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    if (uart->installed) {
+        uart_disable_pattern_det_intr(uart->uart_port);
+        uart_driver_delete(uart->uart_port);
+    }
+    free(uart);
+    return ESP_OK;
+}
+
+esp_modem_transport_t *esp_modem_transport_uart_create(void)
+{
+    esp_modem_uart_transport_t *uart = calloc(1, sizeof(esp_modem_uart_transport_t));
+    UART_CHECK(uart, "calloc uart transport failed", err);
+    uart->parent.open = uart_transport_open;
+    uart->parent.read = uart_transport_read;
+    uart->parent.write = uart_transport_write;
+    uart->parent.wait = uart_transport_wait;
+    uart->parent.wakeup = uart_transport_wakeup;
+    uart->parent.flush = uart_transport_flush;
+    uart->parent.set_mode = uart_transport_set_mode;
+    uart->parent.set_baud = uart_transport_set_baud;
+    uart->parent.tx_idle = uart_transport_tx_idle;
+    uart->parent.set_rx_moderation = uart_transport_set_rx_moderation;
+    uart->parent.get_watermarks = uart_transport_get_watermarks;
+    uart->parent.set_rx_throttle = uart_transport_set_rx_throttle;
+    uart->parent.set_rx_paced = uart_transport_set_rx_paced;
+    uart->parent.deinit = uart_transport_deinit;
+    return &uart->parent;
+err:
+    return NULL;
+}
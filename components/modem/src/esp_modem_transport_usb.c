@@ -0,0 +1,260 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sdkconfig.h"
+#if CONFIG_COMPONENT_MODEM_TRANSPORT_USB
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+#include "esp_log.h"
+#include "usb/usb_host.h"
+#include "usb/cdc_acm_host.h"
+#include "esp_modem.h"
+#include "esp_modem_transport.h"
+
+#define USB_HOST_TASK_STACK_SIZE (4096)
+#define USB_HOST_TASK_PRIORITY (10)
+
+static const char *TAG = "esp-modem-usb";
+#define USB_CHECK(a, str, goto_tag, ...)                                            \
+    do                                                                              \
+    {                                                                               \
+        if (!(a))                                                                   \
+        {                                                                           \
+            ESP_LOGE(TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__);   \
+            goto goto_tag;                                                          \
+        }                                                                           \
+    } while (0)
+
+/**
+ * @brief USB CDC-ACM transport
+ *
+ * Received data is pushed by the CDC-ACM driver into a stream buffer. USB has
+ * no line detection, so the DTE splits lines itself.
+ */
+typedef struct {
+    esp_modem_transport_usb_config_t config;    /*!< USB configuration */
+    cdc_acm_dev_hdl_t cdc_dev;                  /*!< CDC-ACM device */
+    StreamBufferHandle_t rx_stream;             /*!< Received data */
+    SemaphoreHandle_t rx_sem;                   /*!< Given on new data and on wakeup */
+    TaskHandle_t host_task_hdl;                 /*!< USB host library task */
+    volatile bool wakeup;                       /*!< wakeup() was called */
+    volatile bool overflow;                     /*!< Data was dropped because the stream buffer was full */
+    volatile bool disconnected;                 /*!< The modem left the bus */
+    esp_modem_transport_mode_t mode;            /*!< Receive mode */
+    esp_modem_transport_t parent;               /*!< Transport interface that should extend */
+} esp_modem_usb_transport_t;
+
+static void usb_host_task_entry(void *param)
+{
+    while (1) {
+        uint32_t event_flags;
+        usb_host_lib_handle_events(portMAX_DELAY, &event_flags);
+        if (event_flags & USB_HOST_LIB_EVENT_FLAGS_NO_CLIENTS) {
+            usb_host_device_free_all();
+        }
+    }
+}
+
+static void usb_transport_data_cb(uint8_t *data, size_t data_len, void *user_arg)
+{
+    esp_modem_usb_transport_t *usb = user_arg;
+    if (xStreamBufferSend(usb->rx_stream, data, data_len, 0) < data_len) {
+        usb->overflow = true;
+    }
+    xSemaphoreGive(usb->rx_sem);
+}
+
+static void usb_transport_event_cb(const cdc_acm_host_dev_event_data_t *event, void *user_arg)
+{
+    esp_modem_usb_transport_t *usb = user_arg;
+    if (event->type == CDC_ACM_HOST_DEVICE_DISCONNECTED) {
+        ESP_LOGW(TAG, "modem disconnected");
+        usb->disconnected = true;
+        xSemaphoreGive(usb->rx_sem);
+    } else if (event->type == CDC_ACM_HOST_ERROR) {
+        ESP_LOGE(TAG, "CDC-ACM error %d", event->data.error);
+    }
+}
+
+static esp_err_t usb_transport_open(esp_modem_transport_t *transport, const struct esp_modem_dte_config *config)
+{
+    esp_modem_usb_transport_t *usb = __containerof(transport, esp_modem_usb_transport_t, parent);
+    const usb_host_config_t host_config = {
+        .skip_phy_setup = false,
+        .intr_flags = ESP_INTR_FLAG_LEVEL1,
+    };
+    USB_CHECK(usb_host_install(&host_config) == ESP_OK, "install usb host failed", err);
+    BaseType_t ret = xTaskCreate(usb_host_task_entry, "usb_host", USB_HOST_TASK_STACK_SIZE, usb,
+                                 USB_HOST_TASK_PRIORITY, &usb->host_task_hdl);
+    USB_CHECK(ret == pdTRUE, "create usb host task failed", err_task);
+    USB_CHECK(cdc_acm_host_install(NULL) == ESP_OK, "install cdc-acm driver failed", err_cdc);
+    const cdc_acm_host_device_config_t dev_config = {
+        .connection_timeout_ms = usb->config.connection_timeout_ms,
+        .out_buffer_size = usb->config.tx_buffer_size,
+        .event_cb = usb_transport_event_cb,
+        .data_cb = usb_transport_data_cb,
+        .user_arg = usb,
+    };
+    USB_CHECK(cdc_acm_host_open(usb->config.vid, usb->config.pid, usb->config.interface_idx, &dev_config, &usb->cdc_dev) == ESP_OK,
+              "open %04x:%04x interface %d failed", err_open, usb->config.vid, usb->config.pid, usb->config.interface_idx);
+    usb->mode = ESP_MODEM_TRANSPORT_MODE_LINE;
+    return ESP_OK;
+err_open:
+    cdc_acm_host_uninstall();
+err_cdc:
+    vTaskDelete(usb->host_task_hdl);
+    usb->host_task_hdl = NULL;
+err_task:
+    usb_host_uninstall();
+err:
+    return ESP_FAIL;
+}
+
+static int usb_transport_read(esp_modem_transport_t *transport, uint8_t *data, size_t len, uint32_t timeout_ms)
+{
+    esp_modem_usb_transport_t *usb = __containerof(transport, esp_modem_usb_transport_t, parent);
+    TickType_t timeout = timeout_ms == portMAX_DELAY ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    size_t total = 0;
+    TickType_t start = xTaskGetTickCount();
+    /* like uart_read_bytes(), block until len bytes or the timeout */
+    while (total < len) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (timeout != portMAX_DELAY && elapsed >= timeout) {
+            break;
+        }
+        total += xStreamBufferReceive(usb->rx_stream, &data[total], len - total,
+                                      timeout == portMAX_DELAY ? portMAX_DELAY : timeout - elapsed);
+    }
+    return total;
+}
+
+static int usb_transport_write(esp_modem_transport_t *transport, const void *data, size_t len)
+{
+    esp_modem_usb_transport_t *usb = __containerof(transport, esp_modem_usb_transport_t, parent);
+    if (usb->disconnected) {
+        return -1;
+    }
+    esp_err_t err = cdc_acm_host_data_tx_blocking(usb->cdc_dev, data, len, usb->config.tx_timeout_ms);
+    return err == ESP_OK ? len : -1;
+}
+
+static esp_modem_transport_event_t usb_transport_wait(esp_modem_transport_t *transport, size_t *len, uint32_t timeout_ms)
+{
+    esp_modem_usb_transport_t *usb = __containerof(transport, esp_modem_usb_transport_t, parent);
+    *len = 0;
+    do {
+        if (usb->wakeup) {
+            usb->wakeup = false;
+            return ESP_MODEM_TRANSPORT_EVENT_WAKEUP;
+        }
+        if (usb->overflow) {
+            ESP_LOGW(TAG, "Stream Buffer Full");
+            usb->overflow = false;
+            xStreamBufferReset(usb->rx_stream);
+            return ESP_MODEM_TRANSPORT_EVENT_OVERFLOW;
+        }
+        if (usb->disconnected) {
+            return ESP_MODEM_TRANSPORT_EVENT_ERROR;
+        }
+        if (usb->mode != ESP_MODEM_TRANSPORT_MODE_PAUSED) {
+            *len = xStreamBufferBytesAvailable(usb->rx_stream);
+            if (*len) {
+                return ESP_MODEM_TRANSPORT_EVENT_DATA;
+            }
+        }
+    } while (xSemaphoreTake(usb->rx_sem, pdMS_TO_TICKS(timeout_ms)) == pdTRUE);
+    return ESP_MODEM_TRANSPORT_EVENT_NONE;
+}
+
+static esp_err_t usb_transport_wakeup(esp_modem_transport_t *transport)
+{
+    esp_modem_usb_transport_t *usb = __containerof(transport, esp_modem_usb_transport_t, parent);
+    usb->wakeup = true;
+    xSemaphoreGive(usb->rx_sem);
+    return ESP_OK;
+}
+
+static esp_err_t usb_transport_flush(esp_modem_transport_t *transport)
+{
+    esp_modem_usb_transport_t *usb = __containerof(transport, esp_modem_usb_transport_t, parent);
+    return xStreamBufferReset(usb->rx_stream) == pdPASS ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t usb_transport_set_mode(esp_modem_transport_t *transport, esp_modem_transport_mode_t mode)
+{
+    esp_modem_usb_transport_t *usb = __containerof(transport, esp_modem_usb_transport_t, parent);
+    usb->mode = mode;
+    xSemaphoreGive(usb->rx_sem);
+    return ESP_OK;
+}
+
+static esp_err_t usb_transport_set_baud(esp_modem_transport_t *transport, uint32_t baud_rate)
+{
+    esp_modem_usb_transport_t *usb = __containerof(transport, esp_modem_usb_transport_t, parent);
+    /* most modems ignore the line coding of their USB ports */
+    cdc_acm_line_coding_t line_coding = {
+        .dwDTERate = baud_rate,
+        .bCharFormat = 0,
+        .bParityType = 0,
+        .bDataBits = 8,
+    };
+    return cdc_acm_host_line_coding_set(usb->cdc_dev, &line_coding);
+}
+
+static esp_err_t usb_transport_deinit(esp_modem_transport_t *transport)
+{
+    esp_modem_usb_transport_t *usb = __containerof(transport, esp_modem_usb_transport_t, parent);
+    if (usb->cdc_dev) {
+        cdc_acm_host_close(usb->cdc_dev);
+        cdc_acm_host_uninstall();
+    }
+    if (usb->host_task_hdl) {
+        vTaskDelete(usb->host_task_hdl);
+        usb_host_uninstall();
+    }
+    vStreamBufferDelete(usb->rx_stream);
+    vSemaphoreDelete(usb->rx_sem);
+    free(usb);
+    return ESP_OK;
+}
+
+esp_modem_transport_t *esp_modem_transport_usb_create(const esp_modem_transport_usb_config_t *config)
+{
+    esp_modem_usb_transport_t *usb = calloc(1, sizeof(esp_modem_usb_transport_t));
+    USB_CHECK(usb, "calloc usb transport failed", err);
+    usb->config = *config;
+    usb->rx_stream = xStreamBufferCreate(config->rx_buffer_size, 1);
+    USB_CHECK(usb->rx_stream, "create stream buffer failed", err_stream);
+    usb->rx_sem = xSemaphoreCreateBinary();
+    USB_CHECK(usb->rx_sem, "create semaphore failed", err_sem);
+    usb->parent.open = usb_transport_open;
+    usb->parent.read = usb_transport_read;
+    usb->parent.write = usb_transport_write;
+    usb->parent.wait = usb_transport_wait;
+    usb->parent.wakeup = usb_transport_wakeup;
+    usb->parent.flush = usb_transport_flush;
+    usb->parent.set_mode = usb_transport_set_mode;
+    usb->parent.set_baud = usb_transport_set_baud;
+    usb->parent.deinit = usb_transport_deinit;
+    return &usb->parent;
+err_sem:
+    vStreamBufferDelete(usb->rx_stream);
+err_stream:
+    free(usb);
+err:
+    return NULL;
+}
+#endif // CONFIG_COMPONENT_MODEM_TRANSPORT_USB
@@ -0,0 +1,109 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include <sys/param.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_modem.h"
+#include "esp_modem_upload.h"
+
+static const char *TAG = "esp-modem-upload";
+
+/**
+ * @brief Source of the raw transfer, maps the partition one window at a time
+ *
+ */
+typedef struct {
+    const esp_partition_t *partition;   /*!< Partition to read */
+    size_t offset;                      /*!< Next byte to send */
+    size_t end;                         /*!< End of the range */
+    size_t window_size;                 /*!< Bytes mapped at a time */
+    spi_flash_mmap_handle_t handle;     /*!< Mapping of the current window */
+    bool mapped;                        /*!< A window is mapped */
+    uint32_t windows;                   /*!< Windows mapped so far */
+} esp_modem_upload_source_t;
+
+static void esp_modem_upload_unmap(esp_modem_upload_source_t *source)
+{
+    if (source->mapped) {
+        spi_flash_munmap(source->handle);
+        source->mapped = false;
+    }
+}
+
+/**
+ * @brief Next block of the raw transfer: the next window of the partition
+ */
+static esp_err_t esp_modem_upload_next(void *ctx, const void **data, size_t *len)
+{
+    esp_modem_upload_source_t *source = ctx;
+    /* The previous window has been written to the transport by now */
+    esp_modem_upload_unmap(source);
+    *len = MIN(source->end - source->offset, source->window_size);
+    if (*len == 0) {
+        return ESP_OK;
+    }
+    esp_err_t err = esp_partition_mmap(source->partition, source->offset, *len, SPI_FLASH_MMAP_DATA,
+                                       data, &source->handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "map 0x%x+%u failed: %s", source->offset, *len, esp_err_to_name(err));
+        return err;
+    }
+    source->mapped = true;
+    source->windows++;
+    source->offset += *len;
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_upload_partition(modem_dce_t *dce, const esp_partition_t *partition, size_t offset, size_t length,
+                                     const esp_modem_upload_config_t *config, esp_modem_upload_stats_t *stats)
+{
+    if (!dce || !partition || !config || !config->command || !config->prompt || !config->window_size ||
+        offset > partition->size || length > partition->size - offset) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_modem_upload_source_t source = {
+        .partition = partition,
+        .offset = offset,
+        .end = length ? offset + length : partition->size,
+        .window_size = config->window_size,
+    };
+    esp_modem_raw_transfer_t transfer = {
+        .command = config->command,
+        .prompt = config->prompt,
+        .prompt_timeout_ms = config->prompt_timeout_ms,
+        .next = esp_modem_upload_next,
+        .ctx = &source,
+        .handle_result = config->handle_result,
+        .result_timeout_ms = config->result_timeout_ms,
+    };
+    size_t sent = 0;
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_modem_send_raw(dce->dte, &transfer, &sent);
+    uint32_t duration_ms = (esp_timer_get_time() - start) / 1000;
+    esp_modem_upload_unmap(&source);
+    uint32_t bytes_per_sec = duration_ms ? (uint64_t)sent * 1000 / duration_ms : 0;
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "uploaded %u bytes of %s in %u ms (%u B/s)", sent, partition->label, duration_ms, bytes_per_sec);
+    } else {
+        ESP_LOGE(TAG, "upload of %s failed after %u bytes: %s", partition->label, sent, esp_err_to_name(err));
+    }
+    if (stats) {
+        stats->bytes = sent;
+        stats->windows = source.windows;
+        stats->duration_ms = duration_ms;
+        stats->bytes_per_sec = bytes_per_sec;
+    }
+    return err;
+}
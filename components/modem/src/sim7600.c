@@ -13,6 +13,7 @@
 // limitations under the License.
 #include <stdlib.h>
 #include <string.h>
+#include <sys/param.h>
 #include "esp_log.h"
 #include "bg96.h"
 #include "bg96_private.h"
@@ -78,6 +79,126 @@ err:
     return ESP_FAIL;
 }
 
+/**
+ * @brief Handle response from AT+CPING
+ */
+static esp_err_t sim7600_handle_cping(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    bg96_modem_dce_t *bg96_dce = __containerof(dce, bg96_modem_dce_t, parent);
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        /* results follow as URCs */
+        err = ESP_OK;
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+CPING: 3", strlen("+CPING: 3"))) {
+        modem_ping_stats_t *stats = bg96_dce->priv_resource;
+        int sent = 0, rcvd = 0, lost = 0, min = 0, max = 0, avg = 0;
+        /* +CPING: 3,<num_pkts_sent>,<num_pkts_recvd>,<num_pkts_lost>,<min_rtt>,<max_rtt>,<avg_rtt> */
+        if (sscanf(line, "+CPING: 3,%d,%d,%d,%d,%d,%d", &sent, &rcvd, &lost, &min, &max, &avg) == 6) {
+            stats->sent = sent;
+            stats->received = rcvd;
+            stats->rtt_min_ms = min;
+            stats->rtt_max_ms = max;
+            stats->rtt_avg_ms = avg;
+            err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+        } else {
+            err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+        }
+    } else if (!strncmp(line, "+CPING", strlen("+CPING"))) {
+        /* +CPING: 1,... reply or +CPING: 2 timeout of one echo request */
+        err = ESP_OK;
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+CDNSGIP
+ */
+static esp_err_t sim7600_handle_cdnsgip(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    bg96_modem_dce_t *bg96_dce = __containerof(dce, bg96_modem_dce_t, parent);
+    bg96_dns_resource_t *dns = bg96_dce->priv_resource;
+    char addr[64];
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, dns->ip[0] ? MODEM_STATE_SUCCESS : MODEM_STATE_FAIL);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (sscanf(line, "+CDNSGIP: 1,\"%*[^\"]\",\"%63[^\"]\"", addr) == 1) {
+        /* +CDNSGIP: 1,<domain name>,<IP address> */
+        snprintf(dns->ip, dns->ip_len, "%s", addr);
+        err = ESP_OK;
+    } else if (!strncmp(line, "+CDNSGIP", strlen("+CDNSGIP"))) {
+        /* +CDNSGIP: 0,<dns error code>, ERROR follows */
+        err = ESP_OK;
+    }
+    return err;
+}
+
+/**
+ * @brief Ping a host from the modem's own IP stack
+ *
+ * @param dce Modem DCE object
+ * @param host host name or IP address
+ * @param count number of echo requests
+ * @param timeout_ms timeout of one echo request
+ * @param stats ping statistics
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7600_ping(modem_dce_t *dce, const char *host, uint32_t count, uint32_t timeout_ms, modem_ping_stats_t *stats)
+{
+    modem_dte_t *dte = dce->dte;
+    bg96_modem_dce_t *bg96_dce = __containerof(dce, bg96_modem_dce_t, parent);
+    char command[96];
+    timeout_ms = MAX(timeout_ms, 1000);
+    count = MIN(MAX(count, 1), 100);
+    memset(stats, 0, sizeof(modem_ping_stats_t));
+    /* AT+CPING=<dest_addr>,<dest_addr_type>,<num_pings>,<data_packet_size>,<interval_time>,<wait_time>,<TTL> */
+    int len = snprintf(command, sizeof(command), "AT+CPING=\"%s\",1,%d,64,1000,%d,255\r", host, count, timeout_ms);
+    DCE_CHECK(len < sizeof(command), "host name too long", err);
+    bg96_dce->priv_resource = stats;
+    dce->handle_line = sim7600_handle_cping;
+    DCE_CHECK(dte->send_cmd(dte, command, count * (timeout_ms + 1000) + MODEM_COMMAND_TIMEOUT_DNS) == ESP_OK, "send command failed", err);
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "ping %s failed", err, host);
+    ESP_LOGD(DCE_TAG, "ping ok, %d/%d replies", stats->received, stats->sent);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Resolve a host name from the modem's own IP stack
+ *
+ * @param dce Modem DCE object
+ * @param host host name
+ * @param ip output buffer for the address
+ * @param ip_len size of the output buffer
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7600_resolve(modem_dce_t *dce, const char *host, char *ip, size_t ip_len)
+{
+    modem_dte_t *dte = dce->dte;
+    bg96_modem_dce_t *bg96_dce = __containerof(dce, bg96_modem_dce_t, parent);
+    char command[96];
+    bg96_dns_resource_t dns = { .ip = ip, .ip_len = ip_len, .remaining = 1 };
+    ip[0] = '\0';
+    int len = snprintf(command, sizeof(command), "AT+CDNSGIP=\"%s\"\r", host);
+    DCE_CHECK(len < sizeof(command), "host name too long", err);
+    bg96_dce->priv_resource = &dns;
+    dce->handle_line = sim7600_handle_cdnsgip;
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DNS) == ESP_OK, "send command failed", err);
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "resolve %s failed", err, host);
+    ESP_LOGD(DCE_TAG, "resolve ok, %s", ip);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
 /**
  * @brief Create and initialize SIM7600 object
  *
@@ -87,5 +208,7 @@ modem_dce_t *sim7600_init(modem_dte_t *dte)
     modem_dce_t *dce = bg96_init(dte);
     dte->dce->get_battery_status = sim7600_get_battery_status;
     dte->dce->setup_cmux = esp_modem_dce_setup_cmux;
+    dte->dce->ping = sim7600_ping;
+    dte->dce->resolve = sim7600_resolve;
     return dce;
 }
@@ -480,6 +480,7 @@ modem_dce_t *sim800_init(modem_dte_t *dte)
     sim800_dce->parent.setup_cmux = esp_modem_dce_setup_cmux;
     /* Sync between DTE and DCE */
     DCE_CHECK(esp_modem_dce_sync(&(sim800_dce->parent)) == ESP_OK, "sync failed", err_io);
+    esp_modem_mark_phase(dte, ESP_MODEM_PHASE_SYNC);
     /* Setup CMUX */
  //   if (sim800_dce->parent.dte->cmux)
  //     DCE_CHECK(sim800_dce->parent.dte->change_mode(sim800_dce->parent.dte, MODEM_CMUX_MODE) == ESP_OK, "CMUX failed", err_io);
@@ -493,6 +494,7 @@ modem_dce_t *sim800_init(modem_dte_t *dte)
     DCE_CHECK(sim800_get_imsi_number(sim800_dce) == ESP_OK, "get imsi failed", err_io);
     /* Get operator name */
     DCE_CHECK(sim800_get_operator_name(sim800_dce) == ESP_OK, "get operator name failed", err_io);
+    esp_modem_mark_phase(dte, ESP_MODEM_PHASE_IDENTITY);
     return &(sim800_dce->parent);
 err_io:
     free(sim800_dce);
@@ -0,0 +1,142 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/**
+ * Host check and benchmark of the CMUX codec
+ *
+ * Compares the frames of esp_modem_cmux.hpp with the bitwise crc8() encoder
+ * the DTE used before, checks that they parse back for every payload length,
+ * then times both encoders. Build and run with `make run` in this directory.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "esp_modem_cmux.hpp"
+#include "esp_modem_cmux.h"
+
+using namespace esp_modem;
+
+/* The bitwise CRC8 of the DTE before the codec */
+static uint8_t crc8(const uint8_t *src, size_t len, uint8_t polynomial, uint8_t initial_value, bool reversed)
+{
+    uint8_t crc = initial_value;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= src[i];
+        for (size_t j = 0; j < 8; j++) {
+            if (reversed) {
+                crc = (crc & 0x01) ? (crc >> 1) ^ polynomial : crc >> 1;
+            } else {
+                crc = (crc & 0x80) ? (crc << 1) ^ polynomial : crc << 1;
+            }
+        }
+    }
+    return crc;
+}
+
+/* UIH frame as the DTE built it before the codec */
+static size_t legacy_encode_uih(uint8_t *frame, uint8_t dlci, const uint8_t *payload, size_t length)
+{
+    frame[0] = SOF_MARKER;
+    frame[1] = (dlci << 2) + 1;
+    frame[2] = FT_UIH;
+    frame[3] = (length << 1) + 1;
+    memcpy(&frame[4], payload, length);
+    frame[4 + length] = 0xFF - crc8(&frame[1], 3, FCS_POLYNOMIAL, FCS_INIT_VALUE, true);
+    frame[5 + length] = SOF_MARKER;
+    return length + CMUX_FRAME_OVERHEAD;
+}
+
+static int check_frames()
+{
+    uint8_t payload[CMUX_N1];
+    uint8_t expected[CMUX_N1 + CMUX_FRAME_OVERHEAD];
+    uint8_t frame[CMUX_N1 + CMUX_FRAME_OVERHEAD];
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = i * 7;
+    }
+    const uint8_t dlcis[] = { 0, CMUX_DLCI_DATA, CMUX_DLCI_AT, 5 };
+    int errors = 0;
+    for (uint8_t dlci : dlcis) {
+        for (size_t length = 0; length <= CMUX_N1; length++) {
+            size_t expected_len = legacy_encode_uih(expected, dlci, payload, length);
+            size_t len = esp_modem_cmux_encode_uih(frame, sizeof(frame), dlci, payload, length);
+            size_t frame_len = 0;
+            if (len != expected_len || memcmp(frame, expected, len) != 0) {
+                printf("DLCI %u, length %zu: frame differs from the crc8() encoder\n", dlci, length);
+                errors++;
+            } else if (esp_modem_cmux_parse(frame, len, &frame_len) != ESP_MODEM_CMUX_FRAME_COMPLETE ||
+                       frame_len != len) {
+                printf("DLCI %u, length %zu: frame does not parse\n", dlci, length);
+                errors++;
+            }
+            frame[4 + length] ^= 0x01;
+            if (esp_modem_cmux_parse(frame, len, &frame_len) != ESP_MODEM_CMUX_FRAME_BAD_FCS) {
+                printf("DLCI %u, length %zu: wrong FCS not detected\n", dlci, length);
+                errors++;
+            }
+        }
+    }
+    if (esp_modem_cmux_encode_uih(frame, sizeof(frame), CMUX_DLCI_AT, payload, CMUX_N1 + 1) != 0) {
+        printf("payload longer than N1 accepted\n");
+        errors++;
+    }
+    return errors;
+}
+
+static volatile size_t sink;
+
+/**
+ * @brief Average time of encoding one frame, in nanoseconds
+ */
+template <typename Encode>
+static double time_encode(Encode encode, size_t length)
+{
+    constexpr int iterations = 10000000;
+    uint8_t frame[CMUX_N1 + CMUX_FRAME_OVERHEAD];
+    uint8_t payload[CMUX_N1];
+    memset(payload, 0x55, sizeof(payload));
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        /* Alternate the length so the FCS cannot be hoisted out of the loop */
+        size_t len = length - (i & 1);
+        sink += encode(frame, payload, len);
+        sink += frame[4 + len];
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+int main()
+{
+    int errors = check_frames();
+    if (errors) {
+        printf("%d errors\n", errors);
+        return 1;
+    }
+    printf("frames of DLCI 0, 1, 2 and 5 match the crc8() encoder and parse back for lengths 0-%d\n", CMUX_N1);
+    printf("payload  crc8()  encode_uih<1>  esp_modem_cmux_encode_uih  (ns per frame)\n");
+    for (size_t length : { 4, 32, 64, CMUX_N1 }) {
+        double legacy = time_encode([](uint8_t *f, const uint8_t *p, size_t l) {
+            return legacy_encode_uih(f, CMUX_DLCI_DATA, p, l);
+        }, length);
+        double codec = time_encode([](uint8_t *f, const uint8_t *p, size_t l) {
+            return cmux::encode_uih<CMUX_DLCI_DATA>(cmux::span<uint8_t>(f, CMUX_N1 + CMUX_FRAME_OVERHEAD), p, l);
+        }, length);
+        double c_api = time_encode([](uint8_t *f, const uint8_t *p, size_t l) {
+            return esp_modem_cmux_encode_uih(f, CMUX_N1 + CMUX_FRAME_OVERHEAD, CMUX_DLCI_DATA, p, l);
+        }, length);
+        printf("%7zu  %6.2f  %13.2f  %25.2f\n", length, legacy, codec, c_api);
+    }
+    return 0;
+}
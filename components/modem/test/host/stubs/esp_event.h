@@ -0,0 +1,8 @@
+/* Host stand-in for the ESP-IDF header, enough for the modem headers used by the host tests */
+#pragma once
+#include "esp_err.h"
+
+typedef const char *esp_event_base_t;
+typedef void (*esp_event_handler_t)(void *handler_args, esp_event_base_t base, int32_t id, void *event_data);
+
+#define ESP_EVENT_DECLARE_BASE(id) extern esp_event_base_t id
@@ -0,0 +1,5 @@
+/* Host stand-in for the ESP-IDF header, enough for the modem headers used by the host tests */
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
@@ -1,15 +1,22 @@
 from __future__ import unicode_literals
 from tiny_test_fw import Utility
 import os
+import random
+import re
+import select
 import serial
+import subprocess
 import threading
 import time
 import ttfw_idf
 
 
-class SerialThread(object):
+class FakeModem(object):
     '''
-    Connect to serial port and fake responses just like from a real modem
+    Fake modem on a serial port, run in a thread: answers AT commands just like a real modem until a command
+    hands the port over (hand_off), e.g. to pppd after ATD or to a CMUX decoder after AT+CMUX, then serves
+    the port in run_data. inject is called on every poll to write unsolicited result codes.
+    Subclasses set their attributes before calling __init__, which starts the thread.
     '''
 
     # Dictionary for transforming received AT command to expected response
@@ -22,33 +29,61 @@ class SerialThread(object):
               b'ATD*99***1#': b'CONNECT',
               }
 
-    def run(self, log_path, exit_event):
-        with serial.Serial(self.port, 115200) as ser, open(log_path, 'w') as f:
-            buff = b''
-            while not exit_event.is_set():
-                time.sleep(0.1)
-                buff += ser.read(ser.in_waiting)
-                if not buff.endswith(b'\r'):
-                    continue  # read more because the complete command wasn't yet received
-                cmd_list = buff.split(b'\r')
-                buff = b''
-                for cmd in cmd_list:
-                    if len(cmd) == 0:
-                        continue
-                    snd = self.AT_FSM.get(cmd, b'')
-                    if snd != b'':
-                        snd += b'\n'
-                    snd += b'OK\n'
-                    f.write('Received: {}\n'.format(repr(cmd.decode())))
-                    f.write('Sent: {}\n'.format(repr(snd.decode())))
-                    ser.write(snd)
+    NAME = 'fake modem'
 
-    def __init__(self, port, log_path):
+    def __init__(self, port, log_path, poll_interval=0.1):
         self.port = port
+        self.log_path = log_path
+        self.poll_interval = poll_interval
+        self.silent_until = 0
         self.exit_event = threading.Event()
-        self.t = threading.Thread(target=self.run, args=(log_path, self.exit_event,))
+        self.t = threading.Thread(target=self.run)
         self.t.start()
 
+    def hand_off(self, cmd):
+        return False
+
+    def inject(self, ser):
+        pass
+
+    def run_data(self, ser, f):
+        pass
+
+    def run_at(self, ser, f):
+        '''
+        Answer AT commands, return True when a command handed the port over
+        '''
+        buff = b''
+        while not self.exit_event.is_set():
+            time.sleep(self.poll_interval)
+            self.inject(ser)
+            buff += ser.read(ser.in_waiting)
+            if not buff.endswith(b'\r'):
+                continue  # read more because the complete command wasn't yet received
+            cmd_list = buff.split(b'\r')
+            buff = b''
+            for cmd in cmd_list:
+                if len(cmd) == 0 or time.time() < self.silent_until:
+                    continue
+                handed_off = self.hand_off(cmd)
+                snd = self.AT_FSM.get(cmd, b'')
+                if snd != b'':
+                    snd += b'\n'
+                # A dial which enters data mode is answered with CONNECT only
+                if not (handed_off and cmd.startswith(b'ATD')):
+                    snd += b'OK\n'
+                f.write('Received: {}\n'.format(repr(cmd.decode())))
+                f.write('Sent: {}\n'.format(repr(snd.decode())))
+                ser.write(snd)
+                if handed_off:
+                    return True
+        return False
+
+    def run(self):
+        with serial.Serial(self.port, 115200) as ser, open(self.log_path, 'w') as f:
+            if self.run_at(ser, f):
+                self.run_data(ser, f)
+
     def __enter__(self):
         return self
 
@@ -56,7 +91,405 @@ class SerialThread(object):
         self.exit_event.set()
         self.t.join(60)
         if self.t.is_alive():
-            Utility.console_log('The serial thread is still alive', 'O')
+            Utility.console_log('The {} thread is still alive'.format(self.NAME), 'O')
+
+
+class SerialThread(FakeModem):
+    '''
+    Connect to serial port and fake responses just like from a real modem
+    '''
+
+    NAME = 'serial'
+
+
+class SoakModemThread(FakeModem):
+    '''
+    Fake modem for the soak test: answers AT commands, hands the port to pppd after ATD and takes
+    it back when the DUT drops the link. Unsolicited noise and modem restarts are injected at random.
+    '''
+
+    NAME = 'soak modem'
+    URC_NOISE = [b'+CREG: 1', b'+CSQ: 4,0', b'RING', b'+CGEV: NW DETACH']
+    RESTART_PROBABILITY = 0.2
+    RESTART_SILENCE = 3
+
+    def __init__(self, port, project_path):
+        self.project_path = project_path
+        self.drop_event = threading.Event()
+        super(SoakModemThread, self).__init__(port, os.path.join(project_path, 'serial_soak.log'))
+
+    def hand_off(self, cmd):
+        return cmd.startswith(b'ATD')
+
+    def inject(self, ser):
+        if random.random() < 0.05:
+            ser.write(random.choice(self.URC_NOISE) + b'\n')
+
+    def run_at(self, ser, f):
+        if random.random() < self.RESTART_PROBABILITY:
+            ser.write(b'\nRDY\n')
+            self.silent_until = time.time() + self.RESTART_SILENCE
+            f.write('Restart\n')
+        return super(SoakModemThread, self).run_at(ser, f)
+
+    def run_data(self, ser, f):
+        cmd = ['pppd', self.port, '115200', '10.0.0.1:10.0.0.2', 'logfile',
+               os.path.join(self.project_path, 'ppp_soak.log'), 'local', 'noauth', 'debug', 'nocrtscts', 'nodetach']
+        ppp = subprocess.Popen(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        while not self.exit_event.is_set() and not self.drop_event.wait(0.1):
+            pass
+        ppp.kill()
+        ppp.wait()
+        self.drop_event.clear()
+        f.write('pppd stopped\n')
+
+    def run(self):
+        with open(self.log_path, 'w') as f:
+            while not self.exit_event.is_set():
+                with serial.Serial(self.port, 115200) as ser:
+                    dialed = self.run_at(ser, f)
+                # pppd opens the port itself
+                if dialed:
+                    self.run_data(None, f)
+
+
+def percentile(values, p):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(len(ordered) * p / 100))]
+
+
+def slope(values):
+    n = len(values)
+    mean_x = (n - 1) / 2.0
+    mean_y = sum(values) / float(n)
+    num = sum((x - mean_x) * (y - mean_y) for x, y in enumerate(values))
+    den = sum((x - mean_x) ** 2 for x in range(n))
+    return num / den if den else 0.0
+
+
+class UrcStormModem(FakeModem):
+    '''
+    Fake modem for the URC load test: floods unsolicited result codes at a fixed rate, both while
+    answering AT commands and, relayed through a pty, between the PPP frames of pppd.
+    '''
+
+    NAME = 'URC storm'
+    URCS = [b'+CREG: 1,"00C3","01A2F2",7', b'+QIURC: "recv",0', b'+CBM: 88', b'+CGREG: 1']
+
+    def __init__(self, port, project_path, rate):
+        self.project_path = project_path
+        self.interval = 1.0 / rate if rate else None
+        self.urcs_sent = 0
+        self.next_urc = time.time()
+        super(UrcStormModem, self).__init__(port, os.path.join(project_path, 'serial_urc_load.log'),
+                                            0.001 if self.interval else 0.1)
+
+    def urc(self):
+        self.urcs_sent += 1
+        return b'\r\n' + random.choice(self.URCS) + b'\r\n'
+
+    def hand_off(self, cmd):
+        return cmd.startswith(b'ATD')
+
+    def inject(self, ser):
+        while self.interval and time.time() >= self.next_urc:
+            ser.write(self.urc())
+            self.next_urc += self.interval
+
+    def run_data(self, ser, f):
+        master, slave = os.openpty()
+        cmd = ['pppd', os.ttyname(slave), '115200', '10.0.0.1:10.0.0.2', 'logfile',
+               os.path.join(self.project_path, 'ppp_urc_load.log'), 'local', 'noauth', 'debug', 'nocrtscts', 'nodetach']
+        ppp = subprocess.Popen(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        self.next_urc = time.time()
+        at_flag = True
+        while not self.exit_event.is_set():
+            ready, _, _ = select.select([master, ser.fileno()], [], [], 0.001)
+            if master in ready:
+                data = os.read(master, 4096)
+                ser.write(data)
+                at_flag = data.endswith(b'\x7e')
+            if ser.fileno() in ready:
+                os.write(master, ser.read(ser.in_waiting))
+            # Only between frames, closed by a flag so the next frame stays intact
+            while self.interval and at_flag and time.time() >= self.next_urc:
+                ser.write(self.urc() + b'\x7e')
+                self.next_urc += self.interval
+            if self.interval and time.time() - self.next_urc > 1:
+                self.next_urc = time.time()
+        ppp.kill()
+        ppp.wait()
+        os.close(master)
+        os.close(slave)
+        f.write('pppd stopped\n')
+
+
+class CmuxUploadModem(FakeModem):
+    '''
+    Fake modem for the upload test: answers AT commands, switches to CMUX on AT+CMUX=0 and opens the
+    DLCIs, then takes the data of AT+CIPSEND on the AT channel after a "> " prompt without line end.
+    '''
+
+    NAME = 'CMUX upload'
+    DLCI_AT = 2
+    FT_SABM = 0x2F
+    FT_UA = 0x63
+    FT_UIH = 0xEF
+    PF = 0x10
+
+    def __init__(self, port, log_path):
+        self.received = 0
+        self.checksum = 0
+        self.crc_table = []
+        for i in range(256):
+            crc = i
+            for _ in range(8):
+                crc = (crc >> 1) ^ 0xE0 if crc & 0x01 else crc >> 1
+            self.crc_table.append(crc)
+        super(CmuxUploadModem, self).__init__(port, log_path)
+
+    def frame(self, dlci, control, payload=b''):
+        header = bytearray([(dlci << 2) | 0x01, control, (len(payload) << 1) | 0x01])
+        crc = 0xFF
+        for b in header:
+            crc = self.crc_table[crc ^ b]
+        return b'\xf9' + bytes(header) + payload + bytes(bytearray([0xFF - crc])) + b'\xf9'
+
+    def hand_off(self, cmd):
+        return cmd == b'AT+CMUX=0'
+
+    def run_data(self, ser, f):
+        buff = bytearray()
+        command = b''
+        upload_left = 0
+        while not self.exit_event.is_set():
+            time.sleep(0.01)
+            buff += bytearray(ser.read(ser.in_waiting))
+            while True:
+                start = buff.find(b'\xf9')
+                # Skip the closing flag of the previous frame too
+                while start >= 0 and start + 1 < len(buff) and buff[start + 1] == 0xF9:
+                    start += 1
+                if start < 0 or len(buff) < start + 4:
+                    break
+                length = buff[start + 3] >> 1
+                if len(buff) < start + length + 6:
+                    break
+                dlci = buff[start + 1] >> 2
+                control = buff[start + 2] & ~self.PF
+                payload = bytes(buff[start + 4:start + 4 + length])
+                del buff[:start + length + 5]
+                if control == self.FT_SABM:
+                    ser.write(self.frame(dlci, self.FT_UA | self.PF))
+                    continue
+                if control != self.FT_UIH or dlci != self.DLCI_AT:
+                    continue
+                if upload_left:
+                    take = min(upload_left, len(payload))
+                    self.received += take
+                    self.checksum = (self.checksum + sum(bytearray(payload[:take]))) & 0xFFFF
+                    upload_left -= take
+                    if upload_left == 0:
+                        f.write('Upload: {} bytes, checksum {:04x}\n'.format(self.received, self.checksum))
+                        ser.write(self.frame(dlci, self.FT_UIH, b'\r\nSEND OK\r\n'))
+                    continue
+                command += payload
+                while b'\r' in command:
+                    cmd, command = command.split(b'\r', 1)
+                    f.write('Received: {}\n'.format(repr(cmd.decode())))
+                    if cmd.startswith(b'AT+CIPSEND='):
+                        upload_left = int(cmd[len(b'AT+CIPSEND='):])
+                        ser.write(self.frame(dlci, self.FT_UIH, b'\r\n> '))
+                        continue
+                    snd = self.AT_FSM.get(cmd, b'')
+                    if snd != b'':
+                        snd = b'\r\n' + snd
+                    ser.write(self.frame(dlci, self.FT_UIH, snd + b'\r\nOK\r\n'))
+
+
+@ttfw_idf.idf_example_test(env_tag='Example_PPP')
+def test_examples_pppos_client_urc_load(env, extra_data):
+    '''
+    Run the example (sdkconfig.ci.urc_load) under URC storms of increasing rate and report command
+    latency inflation, receive side CPU time and data path losses for each rate.
+    '''
+    rel_project_path = 'examples/protocols/pppos_client'
+    dut = env.get_dut('pppos_client', rel_project_path, app_config_name='urc_load')
+    project_path = os.path.join(dut.app.get_sdk_path(), rel_project_path)
+
+    modem_port = '/dev/ttyUSB{}'.format(0 if dut.port.endswith('1') else 1)
+    urc_rates = [int(r) for r in os.getenv('URC_LOAD_RATES', '0,20,100,500').split(',')]
+
+    results = []
+    for rate in urc_rates:
+        with UrcStormModem(modem_port, project_path, rate):
+            dut.reset()
+            cmds = dut.expect(re.compile(r'urc load: commands (\d+) failed (\d+) avg (\d+) us max (\d+) us '
+                                         r'unknown (\d+) dropped (\d+) rx cpu ([\d.]+)%'), timeout=180)
+            dut.expect('pppos_example: GOT ip event!!!', timeout=60)
+            ping = subprocess.Popen(['ping', '-c', '50', '-i', '0.2', '-W', '1', '10.0.0.2'],
+                                    stdout=subprocess.PIPE, universal_newlines=True)
+            cpu = []
+            overflows = 0
+            while True:
+                line = dut.expect(re.compile(r'urc load: (data rx cpu ([\d.]+)% bytes \d+ overflows (\d+) '
+                                             r'line overflows (\d+)|done)'), timeout=30)
+                if line[0] == 'done':
+                    break
+                cpu.append(float(line[1]))
+                overflows += int(line[2]) + int(line[3])
+            out, _ = ping.communicate()
+            loss = re.search(r'([\d.]+)% packet loss', out)
+        results.append({'rate': rate, 'failed': int(cmds[1]), 'avg_us': int(cmds[2]), 'max_us': int(cmds[3]),
+                        'dropped': int(cmds[5]), 'cmd_cpu': float(cmds[6]), 'data_cpu': max(cpu) if cpu else 0.0,
+                        'overflows': overflows, 'loss': float(loss.group(1)) if loss else 100.0})
+
+    base = results[0]
+    Utility.console_log('urc/s  cmd avg us  inflation  cmd max us  failed  events dropped  '
+                        'rx cpu cmd/data %  overflows  ping loss %')
+    for r in results:
+        inflation = float(r['avg_us']) / base['avg_us'] if base['avg_us'] else 0.0
+        Utility.console_log('{rate:5d}  {avg_us:10d}  {0:8.2f}x  {max_us:10d}  {failed:6d}  {dropped:14d}  '
+                            '{cmd_cpu:7.1f}/{data_cpu:<7.1f}  {overflows:9d}  {loss:10.1f}'.format(inflation, **r))
+        ttfw_idf.log_performance('pppos_urc_{}_cmd_latency_us'.format(r['rate']), r['avg_us'])
+        ttfw_idf.log_performance('pppos_urc_{}_rx_cpu_percent'.format(r['rate']), r['data_cpu'])
+    if base['failed'] or base['overflows'] or base['loss']:
+        raise ValueError('urc load: the data path loses data even without URCs')
+
+
+@ttfw_idf.idf_example_test(env_tag='Example_PPP')
+def test_examples_pppos_client_soak(env, extra_data):
+    '''
+    Reconnect the example over and over (sdkconfig.ci.soak) and check that reconnects keep succeeding
+    and that the largest free heap block does not shrink from cycle to cycle.
+    '''
+    rel_project_path = 'examples/protocols/pppos_client'
+    dut = env.get_dut('pppos_client', rel_project_path, app_config_name='soak')
+    project_path = os.path.join(dut.app.get_sdk_path(), rel_project_path)
+
+    modem_port = '/dev/ttyUSB{}'.format(0 if dut.port.endswith('1') else 1)
+    max_leak_bytes = 1024
+
+    reconnect_ms = []
+    min_free = []
+    largest = []
+    with SoakModemThread(modem_port, project_path) as modem:
+        dut.start_app()
+        dut.expect('pppos_example: GOT ip event!!!', timeout=120)
+        while True:
+            line = dut.expect(re.compile(r'soak: (cycle (\d+) drop|cycle (\d+) reconnect (\d+) ms free (\d+) min (\d+) largest (\d+)'
+                                         r'|cycle \d+ reconnect failed.*|done.*)'), timeout=120)[0]
+            if line.startswith('done'):
+                break
+            if 'failed' in line:
+                raise ValueError('soak: {}'.format(line))
+            if line.endswith('drop'):
+                modem.drop_event.set()
+                continue
+            fields = [int(v) for v in re.findall(r'\d+', line)]
+            reconnect_ms.append(fields[1])
+            min_free.append(fields[3])
+            largest.append(fields[4])
+
+    trend = slope(largest)
+    Utility.console_log('soak: {} cycles, reconnect p50 {} ms p90 {} ms max {} ms, heap min {}, largest block trend {:.1f} B/cycle'
+                        ''.format(len(reconnect_ms), percentile(reconnect_ms, 50), percentile(reconnect_ms, 90),
+                                  max(reconnect_ms), min(min_free), trend))
+    ttfw_idf.log_performance('pppos_reconnect_p90_ms', percentile(reconnect_ms, 90))
+    ttfw_idf.log_performance('pppos_heap_min_free', min(min_free))
+    if trend * len(largest) < -max_leak_bytes:
+        raise ValueError('soak: largest free block shrinks by {:.1f} bytes per cycle'.format(-trend))
+
+
+@ttfw_idf.idf_example_test(env_tag='Example_PPP')
+def test_examples_pppos_client_lifecycle(env, extra_data):
+    '''
+    Create and destroy DTE, DCE and netif through the C++ handles (sdkconfig.ci.lifecycle) and check
+    that every cycle succeeds and that the free heap returns to the same level after the first cycle.
+    '''
+    rel_project_path = 'examples/protocols/pppos_client'
+    dut = env.get_dut('pppos_client', rel_project_path, app_config_name='lifecycle')
+    project_path = os.path.join(dut.app.get_sdk_path(), rel_project_path)
+
+    modem_port = '/dev/ttyUSB{}'.format(0 if dut.port.endswith('1') else 1)
+    max_leak_bytes = 64
+
+    free = []
+    with SerialThread(modem_port, os.path.join(project_path, 'serial_lifecycle.log')):
+        dut.start_app()
+        while True:
+            line = dut.expect(re.compile(r'lifecycle: (cycle \d+ free \d+|cycle \d+ failed.*|done.*)'), timeout=60)[0]
+            if 'failed' in line:
+                raise ValueError('lifecycle: {}'.format(line))
+            if line.startswith('done'):
+                break
+            free.append(int(re.findall(r'\d+', line)[1]))
+
+    leaked = free[0] - free[-1]
+    Utility.console_log('lifecycle: {} cycles, free heap {} after the first cycle, {} after the last'
+                        ''.format(len(free), free[0], free[-1]))
+    ttfw_idf.log_performance('pppos_lifecycle_leak_bytes', leaked)
+    if leaked > max_leak_bytes:
+        raise ValueError('lifecycle: {} bytes leaked in {} cycles'.format(leaked, len(free) - 1))
+
+
+@ttfw_idf.idf_example_test(env_tag='Example_PPP')
+def test_examples_pppos_client_flows(env, extra_data):
+    '''
+    Run concurrent command flows as coroutines on one executor task (sdkconfig.ci.flows) and check that
+    they all succeed, that cancellation and time limits end flows with the right error, and that a flow
+    costs less memory than the task stack it replaces.
+    '''
+    rel_project_path = 'examples/protocols/pppos_client'
+    dut = env.get_dut('pppos_client', rel_project_path, app_config_name='flows')
+    project_path = os.path.join(dut.app.get_sdk_path(), rel_project_path)
+
+    modem_port = '/dev/ttyUSB{}'.format(0 if dut.port.endswith('1') else 1)
+
+    with SerialThread(modem_port, os.path.join(project_path, 'serial_flows.log')):
+        dut.start_app()
+        run = dut.expect(re.compile(r'flows: (\d+) flows, (\d+) commands in (\d+) ms, (\d+) failed'), timeout=120)
+        mem = dut.expect(re.compile(r'flows: frames peak (\d+) bytes, (\d+) per flow, executor stack (\d+)'), timeout=10)
+        ends = dut.expect(re.compile(r'flows: cancel (\w+), timeout (\w+)'), timeout=10)
+
+    flows, commands, elapsed_ms, failed = [int(v) for v in run]
+    peak, per_flow, stack = [int(v) for v in mem]
+    Utility.console_log('flows: {} flows, {} commands in {} ms, frames peak {} bytes ({} per flow, task stack {})'
+                        ''.format(flows, commands, elapsed_ms, peak, per_flow, stack))
+    ttfw_idf.log_performance('pppos_flows_bytes_per_flow', per_flow)
+    ttfw_idf.log_performance('pppos_flows_cmd_per_sec', commands * 1000 // max(elapsed_ms, 1))
+    if failed:
+        raise ValueError('flows: {} flows failed'.format(failed))
+    if ends[0] != 'ESP_ERR_INVALID_STATE' or ends[1] != 'ESP_ERR_TIMEOUT':
+        raise ValueError('flows: cancelled flow ended with {}, timed out flow with {}'.format(ends[0], ends[1]))
+    if per_flow >= stack:
+        raise ValueError('flows: a flow takes {} bytes, more than a {} bytes task stack'.format(per_flow, stack))
+
+
+@ttfw_idf.idf_example_test(env_tag='Example_PPP')
+def test_examples_pppos_client_upload(env, extra_data):
+    '''
+    Upload generated data with esp_modem_send_raw() over CMUX (sdkconfig.ci.upload), where the "> " prompt
+    arrives without a line end, and check that the modem got every byte.
+    '''
+    rel_project_path = 'examples/protocols/pppos_client'
+    dut = env.get_dut('pppos_client', rel_project_path, app_config_name='upload')
+    project_path = os.path.join(dut.app.get_sdk_path(), rel_project_path)
+
+    modem_port = '/dev/ttyUSB{}'.format(0 if dut.port.endswith('1') else 1)
+
+    with CmuxUploadModem(modem_port, os.path.join(project_path, 'serial_upload.log')) as modem:
+        dut.start_app()
+        sent, elapsed_ms, checksum, err = dut.expect(re.compile(r'upload: (\d+) bytes in (\d+) ms, checksum ([0-9a-f]{4}): (\w+)'),
+                                                     timeout=60)
+
+    Utility.console_log('upload: {} bytes in {} ms, modem received {}'.format(sent, elapsed_ms, modem.received))
+    ttfw_idf.log_performance('pppos_cmux_upload_ms', int(elapsed_ms))
+    if err != 'ESP_OK':
+        raise ValueError('upload: failed with {}'.format(err))
+    if modem.received != int(sent) or modem.checksum != int(checksum, 16):
+        raise ValueError('upload: sent {} bytes checksum {}, modem received {} bytes checksum {:04x}'
+                         ''.format(sent, checksum, modem.received, modem.checksum))
 
 
 @ttfw_idf.idf_example_test(env_tag='Example_PPP')
@@ -100,3 +533,8 @@ def test_examples_pppos_client(env, extra_data):
 
 if __name__ == '__main__':
     test_examples_pppos_client()
+    test_examples_pppos_client_soak()
+    test_examples_pppos_client_urc_load()
+    test_examples_pppos_client_lifecycle()
+    test_examples_pppos_client_flows()
+    test_examples_pppos_client_upload()
@@ -2,3 +2,15 @@
 # "main" pseudo-component makefile.
 #
 # (Uses default behaviour of compiling all source files in directory, adding 'include' to include path.)
+
+ifndef CONFIG_EXAMPLE_LIFECYCLE_TEST
+COMPONENT_OBJEXCLUDE += example_lifecycle.o
+endif
+ifndef CONFIG_EXAMPLE_CORO_FLOWS_TEST
+COMPONENT_OBJEXCLUDE += example_flows.o
+endif
+
+# esp_modem_cxx.hpp needs C++17
+example_lifecycle.o: CXXFLAGS += -std=gnu++17
+# esp_modem_coro.hpp needs C++20 coroutines, which GCC 10 only enables with -fcoroutines
+example_flows.o: CXXFLAGS += -std=gnu++20 -fcoroutines
@@ -0,0 +1,157 @@
+/* PPPoS Client Example, concurrent command flows
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include "sdkconfig.h"
+
+#if CONFIG_EXAMPLE_CORO_FLOWS_TEST
+#if !defined(__cpp_impl_coroutine)
+#error "EXAMPLE_CORO_FLOWS_TEST needs a toolchain with C++20 coroutines (GCC 10 or later)"
+#endif
+
+#include <atomic>
+#include <cstdio>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_modem_coro.hpp"
+#include "example_flows.h"
+
+using esp_modem::coro::executor;
+using esp_modem::coro::flow;
+
+static const char *TAG = "pppos_example";
+
+/**
+ * @brief Results collected by the done callback on the executor task
+ *
+ */
+struct example_flows_state {
+    SemaphoreHandle_t done_sem;
+    std::atomic<int> pending;
+    std::atomic<int> failed;
+    esp_modem::coro::flow_id cancel_id;
+    esp_modem::coro::flow_id timeout_id;
+    esp_err_t cancel_err;
+    esp_err_t timeout_err;
+};
+
+static int s_commands;
+
+static void example_flow_done(esp_modem::coro::flow_id id, esp_err_t err, void *ctx)
+{
+    example_flows_state *state = static_cast<example_flows_state *>(ctx);
+    if (id == state->cancel_id) {
+        state->cancel_err = err;
+    } else if (id == state->timeout_id) {
+        state->timeout_err = err;
+    } else if (err != ESP_OK) {
+        state->failed++;
+        ESP_LOGW(TAG, "flows: flow %u failed: %s", (unsigned)id, esp_err_to_name(err));
+    }
+    if (--state->pending == 0) {
+        xSemaphoreGive(state->done_sem);
+    }
+}
+
+static flow example_flow_signal(executor &modem, uint32_t *rssi)
+{
+    s_commands++;
+    auto csq = co_await modem.cmd("AT+CSQ\r");
+    if (!csq) {
+        co_return csq.error();
+    }
+    uint32_t ber;
+    if (sscanf(csq->data(), "+CSQ: %u,%u", rssi, &ber) != 2) {
+        co_return ESP_FAIL;
+    }
+    co_return ESP_OK;
+}
+
+/**
+ * @brief Status poll of one client: signal, operator and battery, a few times with pauses in between
+ *
+ */
+static flow example_flow_status(executor &modem, int index)
+{
+    for (int round = 0; round < CONFIG_EXAMPLE_CORO_FLOWS_ROUNDS; round++) {
+        uint32_t rssi = 0;
+        esp_err_t err = co_await example_flow_signal(modem, &rssi);
+        if (err != ESP_OK) {
+            co_return err;
+        }
+        s_commands++;
+        auto cops = co_await modem.cmd("AT+COPS?\r", MODEM_COMMAND_TIMEOUT_OPERATOR);
+        if (!cops) {
+            co_return cops.error();
+        }
+        s_commands++;
+        auto cbc = co_await modem.cmd("AT+CBC\r");
+        if (!cbc) {
+            co_return cbc.error();
+        }
+        err = co_await modem.sleep(10 * (index % 8));
+        if (err != ESP_OK) {
+            co_return err;
+        }
+    }
+    co_return ESP_OK;
+}
+
+static flow example_flow_wait(executor &modem)
+{
+    co_return co_await modem.sleep(60000);
+}
+
+static void example_flows_run(executor &modem, example_flows_state *state)
+{
+    int64_t start = esp_timer_get_time();
+    state->pending = CONFIG_EXAMPLE_CORO_FLOWS + 2;
+    for (int i = 0; i < CONFIG_EXAMPLE_CORO_FLOWS; i++) {
+        if (!modem.spawn(example_flow_status(modem, i), example_flow_done, state)) {
+            state->failed++;
+            state->pending--;
+        }
+    }
+    /* One flow cancelled from here, one cancelled by its time limit */
+    state->cancel_id = modem.spawn(example_flow_wait(modem), example_flow_done, state).value_or(0);
+    state->timeout_id = modem.spawn(example_flow_wait(modem), example_flow_done, state, 100).value_or(0);
+    vTaskDelay(pdMS_TO_TICKS(50));
+    modem.cancel(state->cancel_id);
+    xSemaphoreTake(state->done_sem, portMAX_DELAY);
+    int elapsed_ms = (int)((esp_timer_get_time() - start) / 1000);
+    esp_modem::coro::frame_stats frames = flow::stats();
+    ESP_LOGI(TAG, "flows: %d flows, %d commands in %d ms, %d failed", CONFIG_EXAMPLE_CORO_FLOWS, s_commands,
+             elapsed_ms, state->failed.load());
+    ESP_LOGI(TAG, "flows: frames peak %u bytes, %u per flow, executor stack %u",
+             (unsigned)frames.peak_bytes, (unsigned)(frames.peak_bytes / (CONFIG_EXAMPLE_CORO_FLOWS + 2)),
+             (unsigned)esp_modem::coro::executor_config{}.task_stack_size);
+    ESP_LOGI(TAG, "flows: cancel %s, timeout %s", esp_err_to_name(state->cancel_err),
+             esp_err_to_name(state->timeout_err));
+}
+
+void example_flows(modem_dce_t *dce)
+{
+    example_flows_state state = {};
+    state.done_sem = xSemaphoreCreateBinary();
+    if (!state.done_sem) {
+        ESP_LOGE(TAG, "flows: create semaphore failed");
+        return;
+    }
+    {
+        /* The executor stops at the end of this scope, before the state goes */
+        auto modem = executor::create(dce);
+        if (modem) {
+            example_flows_run(*modem, &state);
+        } else {
+            ESP_LOGE(TAG, "flows: create executor failed: %s", esp_err_to_name(modem.error()));
+        }
+    }
+    vSemaphoreDelete(state.done_sem);
+}
+#endif
@@ -0,0 +1,25 @@
+/* PPPoS Client Example, concurrent command flows
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include "esp_modem.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Run concurrent AT command flows as coroutines on one executor task and log their cost
+ *
+ */
+void example_flows(modem_dce_t *dce);
+
+#ifdef __cplusplus
+}
+#endif
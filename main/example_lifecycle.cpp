@@ -0,0 +1,117 @@
+/* PPPoS Client Example, lifecycle test
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_modem_cxx.hpp"
+#include "example_lifecycle.h"
+
+#define LIFECYCLE_DCE_RETRIES (5)
+
+static const char *TAG = "pppos_example";
+
+/**
+ * @brief Handles of one modem, members are destroyed in reverse order: events, netif, DCE and the DTE last
+ *
+ */
+struct example_modem {
+    esp_modem::dte dte;
+    esp_modem::dce dce;
+    esp_modem::netif netif;
+    esp_modem::event_subscription events;
+};
+
+static void example_lifecycle_event_handler(void *arg, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    ESP_LOGD(TAG, "lifecycle: modem event %d", event_id);
+}
+
+static esp_modem::result<esp_modem::dce> example_lifecycle_dce(esp_modem::dte &dte)
+{
+    esp_modem::result<esp_modem::dce> dce = esp_modem::unexpected{ESP_FAIL};
+    for (int i = 0; i < LIFECYCLE_DCE_RETRIES && !dce; i++) {
+#if CONFIG_EXAMPLE_MODEM_DEVICE_SIM800
+        dce = esp_modem::dce::sim800(dte);
+#elif CONFIG_EXAMPLE_MODEM_DEVICE_BG96
+        dce = esp_modem::dce::bg96(dte);
+#elif CONFIG_EXAMPLE_MODEM_DEVICE_SIM7600
+        dce = esp_modem::dce::sim7600(dte);
+#else
+#error "Unsupported DCE"
+#endif
+        if (!dce) {
+            vTaskDelay(pdMS_TO_TICKS(500));
+        }
+    }
+    return dce;
+}
+
+/**
+ * @brief Bring up one modem, the handles own everything created so far when a step fails
+ *
+ */
+static esp_modem::result<example_modem> example_lifecycle_bring_up(const esp_modem_dte_config_t *config)
+{
+    example_modem modem;
+    auto dte = esp_modem::dte::create(*config);
+    if (!dte) {
+        return esp_modem::unexpected{dte.error()};
+    }
+    modem.dte = std::move(*dte);
+    auto events = esp_modem::event_subscription::create(modem.dte, example_lifecycle_event_handler,
+                  ESP_EVENT_ANY_ID, nullptr);
+    if (!events) {
+        return esp_modem::unexpected{events.error()};
+    }
+    modem.events = std::move(*events);
+    esp_netif_config_t netif_config = ESP_NETIF_DEFAULT_PPP();
+    auto netif = esp_modem::netif::create(modem.dte, netif_config);
+    if (!netif) {
+        return esp_modem::unexpected{netif.error()};
+    }
+    modem.netif = std::move(*netif);
+    auto dce = example_lifecycle_dce(modem.dte);
+    if (!dce) {
+        return esp_modem::unexpected{dce.error()};
+    }
+    modem.dce = std::move(*dce);
+    return modem;
+}
+
+void example_lifecycle(const esp_modem_dte_config_t *config)
+{
+    unsigned failures = 0;
+    size_t first_free = 0;
+    size_t free_size = 0;
+    for (int cycle = 1; cycle <= CONFIG_EXAMPLE_LIFECYCLE_CYCLES; cycle++) {
+        {
+            auto modem = example_lifecycle_bring_up(config);
+            if (!modem) {
+                failures++;
+                ESP_LOGW(TAG, "lifecycle: cycle %d failed: %s", cycle, esp_err_to_name(modem.error()));
+            } else {
+                std::string_view name = modem->dce.name();
+                ESP_LOGI(TAG, "lifecycle: cycle %d up, module %.*s", cycle, (int)name.size(), name.data());
+                if (cycle % 2 == 0) {
+                    /* Half of the cycles release the DCE early and leave the rest to scope exit */
+                    modem->dce.reset();
+                }
+            }
+        }
+        /* The deleted tasks are freed by the idle task */
+        vTaskDelay(pdMS_TO_TICKS(100));
+        free_size = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        if (cycle == 1) {
+            first_free = free_size;
+        }
+        ESP_LOGI(TAG, "lifecycle: cycle %d free %u", cycle, (unsigned)free_size);
+    }
+    ESP_LOGI(TAG, "lifecycle: done, %u failures, leaked %d bytes", failures, (int)(first_free - free_size));
+}
@@ -0,0 +1,25 @@
+/* PPPoS Client Example, lifecycle test
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include "esp_modem.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Create and destroy DTE, DCE and netif through the C++ handles, logging the free heap of every cycle
+ *
+ */
+void example_lifecycle(const esp_modem_dte_config_t *config);
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,17 +7,27 @@
    CONDITIONS OF ANY KIND, either express or implied.
 */
 #include <string.h>
+#include <sys/param.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
 #include "esp_netif.h"
 #include "esp_netif_ppp.h"
 #include "mqtt_client.h"
 #include "esp_modem.h"
 #include "esp_modem_netif.h"
+#include "esp_modem_bringup.h"
+#include "esp_modem_caps.h"
+#include "esp_modem_probe.h"
+#include "esp_modem_scheduler.h"
+#include "nvs_flash.h"
 #include "esp_log.h"
 #include "sim800.h"
 #include "bg96.h"
 #include "sim7600.h"
+#include "example_lifecycle.h"
+#include "example_flows.h"
 
 #define BROKER_URL "mqtt://test.mosquitto.org"
 
@@ -26,6 +36,7 @@ static EventGroupHandle_t event_group = NULL;
 static const int CONNECT_BIT = BIT0;
 static const int STOP_BIT = BIT1;
 static const int GOT_DATA_BIT = BIT2;
+static const int LOST_IP_BIT = BIT3;
 
 #if CONFIG_EXAMPLE_SEND_MSG
 /**
@@ -199,11 +210,13 @@ static void on_ip_event(void *arg, esp_event_base_t event_base,
         esp_netif_get_dns_info(netif, 1, &dns_info);
         ESP_LOGI(TAG, "Name Server2: " IPSTR, IP2STR(&dns_info.ip.u_addr.ip4));
         ESP_LOGI(TAG, "~~~~~~~~~~~~~~");
+        xEventGroupClearBits(event_group, LOST_IP_BIT);
         xEventGroupSetBits(event_group, CONNECT_BIT);
 
         ESP_LOGI(TAG, "GOT ip event!!!");
     } else if (event_id == IP_EVENT_PPP_LOST_IP) {
         ESP_LOGI(TAG, "Modem Disconnect from PPP Server");
+        xEventGroupSetBits(event_group, LOST_IP_BIT);
     } else if (event_id == IP_EVENT_GOT_IP6) {
         ESP_LOGI(TAG, "GOT IPv6 event!");
 
@@ -212,6 +225,258 @@ static void on_ip_event(void *arg, esp_event_base_t event_base,
     }
 }
 
+#if CONFIG_EXAMPLE_SOAK_TEST
+#define SOAK_SYNC_RETRIES (20)
+
+/**
+ * @brief Drop and re-establish the PPP link over and over, logging reconnect time and heap state
+ *
+ */
+static void example_soak(modem_dte_t *dte, modem_dce_t *dce)
+{
+    unsigned failures = 0;
+    for (int cycle = 1; CONFIG_EXAMPLE_SOAK_CYCLES == 0 || cycle <= CONFIG_EXAMPLE_SOAK_CYCLES; cycle++) {
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_EXAMPLE_SOAK_HOLD_MS));
+        ESP_LOGI(TAG, "soak: cycle %d drop", cycle);
+        xEventGroupClearBits(event_group, CONNECT_BIT | STOP_BIT);
+        if (esp_modem_dte_reset(dte) != ESP_OK) {
+            ESP_LOGE(TAG, "soak: reset failed");
+        }
+        xEventGroupWaitBits(event_group, STOP_BIT, pdTRUE, pdTRUE, pdMS_TO_TICKS(1000));
+        int64_t start = esp_timer_get_time();
+        esp_err_t err = ESP_FAIL;
+        /* The simulated modem may be restarting, retry until it answers */
+        for (int i = 0; i < SOAK_SYNC_RETRIES && err != ESP_OK; i++) {
+            err = dce->sync(dce);
+            if (err != ESP_OK) {
+                vTaskDelay(pdMS_TO_TICKS(500));
+            }
+        }
+        dce->echo_mode(dce, false);
+        if (err == ESP_OK && dte->cmux) {
+            err = esp_modem_start_cmux(dte);
+        }
+        if (err == ESP_OK) {
+            err = esp_modem_start_ppp(dte);
+        }
+        EventBits_t bits = 0;
+        if (err == ESP_OK) {
+            bits = xEventGroupWaitBits(event_group, CONNECT_BIT, pdTRUE, pdTRUE,
+                                       pdMS_TO_TICKS(CONFIG_EXAMPLE_SOAK_CONNECT_TIMEOUT_MS));
+        }
+        unsigned reconnect_ms = (esp_timer_get_time() - start) / 1000;
+        if (!(bits & CONNECT_BIT)) {
+            failures++;
+            ESP_LOGW(TAG, "soak: cycle %d reconnect failed after %u ms", cycle, reconnect_ms);
+        }
+        ESP_LOGI(TAG, "soak: cycle %d reconnect %u ms free %u min %u largest %u", cycle, reconnect_ms,
+                 heap_caps_get_free_size(MALLOC_CAP_8BIT), heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+                 heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    }
+    ESP_LOGI(TAG, "soak: done, %u failures", failures);
+}
+#endif
+
+#if CONFIG_EXAMPLE_MODEM_SCHEDULER
+#define EXAMPLE_SCHEDULER_REPORT_SIZE (2048)
+
+/**
+ * @brief Send the deferred status report, released by the scheduler task
+ */
+static void example_scheduled_report(uint32_t rssi, void *ctx)
+{
+    volatile bool *pending = ctx;
+    ESP_LOGI(TAG, "Deferred report sent at rssi %d", rssi);
+    *pending = false;
+}
+#endif
+
+#if CONFIG_EXAMPLE_UPLOAD_TEST
+#define EXAMPLE_UPLOAD_BLOCK_SIZE (200)
+
+/**
+ * @brief Generated upload data, in blocks which do not line up with CMUX frames
+ *
+ */
+typedef struct {
+    uint8_t block[EXAMPLE_UPLOAD_BLOCK_SIZE];
+    size_t offset;
+    uint16_t checksum;
+} example_upload_source_t;
+
+static esp_err_t example_upload_next(void *ctx, const void **data, size_t *len)
+{
+    example_upload_source_t *source = ctx;
+    *len = MIN(CONFIG_EXAMPLE_UPLOAD_SIZE - source->offset, sizeof(source->block));
+    for (size_t i = 0; i < *len; i++) {
+        source->block[i] = (source->offset + i) * 7;
+        source->checksum += source->block[i];
+    }
+    source->offset += *len;
+    *data = source->block;
+    return ESP_OK;
+}
+
+/**
+ * @brief Send generated data after the "> " prompt and log the checksum for the test to compare
+ *
+ */
+static void example_upload(modem_dte_t *dte)
+{
+    example_upload_source_t source = { 0 };
+    char command[32];
+    snprintf(command, sizeof(command), "AT+CIPSEND=%d\r", CONFIG_EXAMPLE_UPLOAD_SIZE);
+    esp_modem_raw_transfer_t transfer = {
+        .command = command,
+        .prompt = "> ",
+        .prompt_timeout_ms = 5000,
+        .next = example_upload_next,
+        .ctx = &source,
+        .result_timeout_ms = 10000,
+    };
+    size_t sent = 0;
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_modem_send_raw(dte, &transfer, &sent);
+    ESP_LOGI(TAG, "upload: %u bytes in %u ms, checksum %04x: %s", (unsigned)sent,
+             (unsigned)((esp_timer_get_time() - start) / 1000), source.checksum, esp_err_to_name(err));
+}
+#endif
+
+#if CONFIG_EXAMPLE_URC_LOAD_TEST
+/**
+ * @brief Percentage of the time between two samples the receive side was busy, in tenths
+ *
+ */
+static unsigned example_rx_cpu_permille(const esp_modem_rx_stats_t *before, const esp_modem_rx_stats_t *after,
+                                        int64_t elapsed_us)
+{
+    uint64_t busy_us = (after->rx_busy_us + after->handler_busy_us) - (before->rx_busy_us + before->handler_busy_us);
+    return elapsed_us > 0 ? busy_us * 1000 / elapsed_us : 0;
+}
+
+/**
+ * @brief Time a burst of AT commands and report the receive side load meanwhile
+ *
+ */
+static void example_urc_load_commands(modem_dte_t *dte, modem_dce_t *dce)
+{
+    esp_modem_rx_stats_t before, after;
+    uint64_t total_us = 0;
+    unsigned max_us = 0, failures = 0;
+    esp_modem_get_rx_stats(dte, &before);
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < CONFIG_EXAMPLE_URC_LOAD_COMMANDS; i++) {
+        uint32_t rssi = 0, ber = 0;
+        int64_t cmd_start = esp_timer_get_time();
+        if (dce->get_signal_quality(dce, &rssi, &ber) != ESP_OK) {
+            failures++;
+            continue;
+        }
+        unsigned latency_us = esp_timer_get_time() - cmd_start;
+        total_us += latency_us;
+        max_us = MAX(max_us, latency_us);
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start;
+    esp_modem_get_rx_stats(dte, &after);
+    unsigned done = CONFIG_EXAMPLE_URC_LOAD_COMMANDS - failures;
+    unsigned cpu = example_rx_cpu_permille(&before, &after, elapsed_us);
+    ESP_LOGI(TAG, "urc load: commands %u failed %u avg %u us max %u us unknown %u dropped %u rx cpu %u.%u%%",
+             done, failures, done ? (unsigned)(total_us / done) : 0, max_us,
+             (unsigned)(after.unknown_lines - before.unknown_lines),
+             (unsigned)(after.unknown_dropped - before.unknown_dropped),
+             cpu / 10, cpu % 10);
+}
+
+/**
+ * @brief Report the receive side load and data path losses every second while connected
+ *
+ */
+static void example_urc_load_data(modem_dte_t *dte)
+{
+    esp_modem_rx_stats_t before, after;
+    esp_modem_buffer_report_t report;
+    esp_modem_get_rx_stats(dte, &before);
+    int64_t start = esp_timer_get_time();
+    for (int elapsed_ms = 0; elapsed_ms < CONFIG_EXAMPLE_URC_LOAD_DATA_MS; elapsed_ms += 1000) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+        int64_t now = esp_timer_get_time();
+        esp_modem_get_rx_stats(dte, &after);
+        esp_modem_get_buffer_report(dte, &report);
+        unsigned cpu = example_rx_cpu_permille(&before, &after, now - start);
+        ESP_LOGI(TAG, "urc load: data rx cpu %u.%u%% bytes %u overflows %u line overflows %u",
+                 cpu / 10, cpu % 10, (unsigned)(after.data_bytes - before.data_bytes),
+                 (unsigned)report.rx_overflows, (unsigned)report.line_overflows);
+        before = after;
+        start = now;
+    }
+    ESP_LOGI(TAG, "urc load: done");
+}
+#endif
+
+/**
+ * @brief Context of the bring-up steps
+ *
+ */
+typedef struct {
+    esp_netif_t *esp_netif;
+    void *modem_netif_adapter;
+    const esp_modem_caps_t *caps;   /*!< Capabilities of the modem, NULL if unknown */
+} example_bringup_t;
+
+static esp_err_t example_step_flow_ctrl(modem_dce_t *dce, void *arg)
+{
+    example_bringup_t *bringup = (example_bringup_t *)arg;
+    modem_flow_ctrl_t flow_ctrl = MODEM_FLOW_CONTROL_NONE;
+    /* Use RTS/CTS in both directions if the DTE is wired for it and the modem supports it */
+    if (dce->dte->flow_ctrl == MODEM_FLOW_CONTROL_HW && bringup->caps &&
+        (bringup->caps->ifc_dce_by_dte & bringup->caps->ifc_dte_by_dce & (1 << MODEM_FLOW_CONTROL_HW))) {
+        flow_ctrl = MODEM_FLOW_CONTROL_HW;
+    }
+    return dce->set_flow_ctrl(dce, flow_ctrl);
+}
+
+static esp_err_t example_step_store_profile(modem_dce_t *dce, void *arg)
+{
+    return dce->store_profile(dce);
+}
+
+static esp_err_t example_step_identity(modem_dce_t *dce, void *arg)
+{
+    /* Print Module ID, Operator, IMEI, IMSI */
+    ESP_LOGI(TAG, "Module: %s", dce->name);
+    ESP_LOGI(TAG, "Operator: %s", dce->oper);
+    ESP_LOGI(TAG, "IMEI: %s", dce->imei);
+    ESP_LOGI(TAG, "IMSI: %s", dce->imsi);
+    return ESP_OK;
+}
+
+static esp_err_t example_step_signal(modem_dce_t *dce, void *arg)
+{
+    uint32_t rssi = 0, ber = 0;
+    esp_err_t err = dce->get_signal_quality(dce, &rssi, &ber);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "rssi: %d, ber: %d", rssi, ber);
+    }
+    return err;
+}
+
+static esp_err_t example_step_battery(modem_dce_t *dce, void *arg)
+{
+    uint32_t voltage = 0, bcs = 0, bcl = 0;
+    esp_err_t err = dce->get_battery_status(dce, &bcs, &bcl, &voltage);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Battery voltage: %d mV", voltage);
+    }
+    return err;
+}
+
+static esp_err_t example_step_dial(modem_dce_t *dce, void *arg)
+{
+    example_bringup_t *bringup = (example_bringup_t *)arg;
+    /* attach the modem to the network interface, which starts PPP */
+    return esp_netif_attach(bringup->esp_netif, bringup->modem_netif_adapter);
+}
+
 void app_main(void)
 {
 #if CONFIG_LWIP_PPP_PAP_SUPPORT
@@ -220,6 +485,14 @@ void app_main(void)
     esp_netif_auth_type_t auth_type = NETIF_PPP_AUTHTYPE_CHAP;
 #elif !defined(CONFIG_EXAMPLE_MODEM_PPP_AUTH_NONE)
 #error "Unsupported AUTH Negotiation"
+#endif
+#if CONFIG_EXAMPLE_MODEM_CAPS_CACHE
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
 #endif
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
@@ -242,7 +515,23 @@ void app_main(void)
     config.event_task_stack_size = CONFIG_EXAMPLE_MODEM_UART_EVENT_TASK_STACK_SIZE;
     config.event_task_priority = CONFIG_EXAMPLE_MODEM_UART_EVENT_TASK_PRIORITY;
     config.line_buffer_size = CONFIG_EXAMPLE_MODEM_UART_RX_BUFFER_SIZE * 2;
+    config.ri_io_num = CONFIG_EXAMPLE_MODEM_UART_RI_PIN;
+    config.uart_wakeup_threshold = CONFIG_EXAMPLE_MODEM_UART_WAKEUP_THRESHOLD;
+#if !CONFIG_EXAMPLE_MODEM_CMUX
+    config.cmux = false;
+#endif
+#if CONFIG_EXAMPLE_MODEM_RX_PIPELINE
+    config.rx_pipeline = true;
+    config.rx_queue_size = config.line_buffer_size * 2;
+#if !CONFIG_FREERTOS_UNICORE
+    config.rx_task_core = 0;
+    config.event_task_core = 1;
+#endif
+#endif
 
+#if CONFIG_EXAMPLE_LIFECYCLE_TEST
+    example_lifecycle(&config);
+#endif
     modem_dte_t *dte = esp_modem_dte_init(&config);
     /* Register event handler */
     ESP_ERROR_CHECK(esp_modem_set_event_handler(dte, modem_event_handler, ESP_EVENT_ANY_ID, NULL));
@@ -254,6 +543,17 @@ void app_main(void)
 
     void *modem_netif_adapter = esp_modem_netif_setup(dte);
     esp_modem_netif_set_default_handlers(modem_netif_adapter, esp_netif);
+#if CONFIG_EXAMPLE_MODEM_DEMAND_IDLE_MS
+    esp_modem_demand_config_t demand_config = ESP_MODEM_DEMAND_DEFAULT_CONFIG();
+    demand_config.idle_timeout_ms = CONFIG_EXAMPLE_MODEM_DEMAND_IDLE_MS;
+    ESP_ERROR_CHECK(esp_modem_netif_set_demand_config(modem_netif_adapter, &demand_config));
+#endif
+    esp_modem_mem_report_t mem_report;
+    esp_modem_get_mem_report(dte, &mem_report);
+    ESP_LOGI(TAG, "modem memory: internal rx %u tx %u bulk %u, psram bulk %u, fallbacks %u",
+             (unsigned)mem_report.internal_bytes[ESP_MODEM_MEM_RX], (unsigned)mem_report.internal_bytes[ESP_MODEM_MEM_TX],
+             (unsigned)mem_report.internal_bytes[ESP_MODEM_MEM_BULK],
+             (unsigned)mem_report.external_bytes[ESP_MODEM_MEM_BULK], (unsigned)mem_report.fallbacks);
 
     modem_dce_t *dce = NULL;
 
@@ -276,31 +576,56 @@ void app_main(void)
     assert(dce != NULL);
     
     /* Enable CMUX */
-    esp_modem_start_cmux(dte);
+    if (dte->cmux) {
+        esp_modem_start_cmux(dte);
+    }
     
-        ESP_ERROR_CHECK(dce->set_flow_ctrl(dce, MODEM_FLOW_CONTROL_NONE));
-        ESP_ERROR_CHECK(dce->store_profile(dce));
-        /* Print Module ID, Operator, IMEI, IMSI */
-        ESP_LOGI(TAG, "Module: %s", dce->name);
-        ESP_LOGI(TAG, "Operator: %s", dce->oper);
-        ESP_LOGI(TAG, "IMEI: %s", dce->imei);
-        ESP_LOGI(TAG, "IMSI: %s", dce->imsi);
-        /* Get signal quality */
-        uint32_t rssi = 0, ber = 0;
-        ESP_ERROR_CHECK(dce->get_signal_quality(dce, &rssi, &ber));
-        ESP_LOGI(TAG, "rssi: %d, ber: %d", rssi, ber);
-        /* Get battery voltage */
-        uint32_t voltage = 0, bcs = 0, bcl = 0;
-        ESP_ERROR_CHECK(dce->get_battery_status(dce, &bcs, &bcl, &voltage));
-        ESP_LOGI(TAG, "Battery voltage: %d mV", voltage);
+#if CONFIG_EXAMPLE_URC_LOAD_TEST
+        example_urc_load_commands(dte, dce);
+#endif
+#if CONFIG_EXAMPLE_CORO_FLOWS_TEST
+        example_flows(dce);
+#endif
+#if CONFIG_EXAMPLE_UPLOAD_TEST
+        example_upload(dte);
+#endif
         /* setup PPPoS network parameters */
 #if !defined(CONFIG_EXAMPLE_MODEM_PPP_AUTH_NONE) && (defined(CONFIG_LWIP_PPP_PAP_SUPPORT) || defined(CONFIG_LWIP_PPP_CHAP_SUPPORT))
         esp_netif_ppp_set_auth(esp_netif, auth_type, CONFIG_EXAMPLE_MODEM_PPP_AUTH_USERNAME, CONFIG_EXAMPLE_MODEM_PPP_AUTH_PASSWORD);
 #endif
-        /* attach the modem to the network interface */
-        esp_netif_attach(esp_netif, modem_netif_adapter);
+        /* Dial as soon as the profile is set, the queries run on the AT channel while PPP negotiates */
+        example_bringup_t bringup = {
+            .esp_netif = esp_netif,
+            .modem_netif_adapter = modem_netif_adapter,
+        };
+#if CONFIG_EXAMPLE_MODEM_CAPS_CACHE
+        /* Probes the test commands only on the first boot with a new modem firmware */
+        esp_modem_caps_t caps;
+        bool caps_cached = false;
+        if (esp_modem_caps_get(dce, &caps, &caps_cached) == ESP_OK) {
+            ESP_LOGI(TAG, "Firmware: %s (%s), max baud rate %d", caps.revision, caps_cached ? "cached" : "probed",
+                     esp_modem_caps_max_baud_rate(&caps, UINT32_MAX));
+            bringup.caps = &caps;
+        }
+#endif
+        const esp_modem_bringup_step_t bringup_steps[] = {
+            { .name = "flow control", .run = example_step_flow_ctrl, .arg = &bringup },
+            { .name = "store profile", .run = example_step_store_profile, .requires = ESP_MODEM_BRINGUP_STEP(0) },
+            { .name = "identity", .run = example_step_identity, .optional = true },
+            { .name = "signal quality", .run = example_step_signal, .optional = true },
+            { .name = "battery", .run = example_step_battery, .optional = true },
+            { .name = "dial", .run = example_step_dial, .arg = &bringup,
+              .requires = ESP_MODEM_BRINGUP_STEP(0) | ESP_MODEM_BRINGUP_STEP(1), .dial = true },
+        };
+        ESP_ERROR_CHECK(esp_modem_bringup(dce, bringup_steps, sizeof(bringup_steps) / sizeof(bringup_steps[0]), NULL));
         /* Wait for IP address */
         xEventGroupWaitBits(event_group, CONNECT_BIT, pdTRUE, pdTRUE, portMAX_DELAY);
+#if CONFIG_EXAMPLE_SOAK_TEST
+        example_soak(dte, dce);
+#endif
+#if CONFIG_EXAMPLE_URC_LOAD_TEST
+        example_urc_load_data(dte);
+#endif
 
         /* Config MQTT */
         esp_mqtt_client_config_t mqtt_config = {
@@ -321,10 +646,55 @@ void app_main(void)
         ESP_LOGI(TAG, "Send send message [%s] ok", message);
 #endif
 
+    uint32_t rssi = 0, ber = 0;
+#if CONFIG_EXAMPLE_MODEM_PROBE_INTERVAL_S
+    esp_modem_probe_config_t probe_config = ESP_MODEM_PROBE_DEFAULT_CONFIG();
+    int64_t next_probe = esp_timer_get_time() + CONFIG_EXAMPLE_MODEM_PROBE_INTERVAL_S * 1000000LL;
+#endif
+#if CONFIG_EXAMPLE_MODEM_SCHEDULER
+    esp_modem_scheduler_config_t scheduler_config = ESP_MODEM_SCHEDULER_DEFAULT_CONFIG();
+    esp_modem_scheduler_t *scheduler = esp_modem_scheduler_create(dce, &scheduler_config);
+    assert(scheduler != NULL);
+    volatile bool report_pending = false;
+#endif
     while (1) {
+#if CONFIG_EXAMPLE_MODEM_PROBE_INTERVAL_S
+        if (esp_timer_get_time() >= next_probe) {
+            esp_modem_probe_result_t probe;
+            next_probe = esp_timer_get_time() + CONFIG_EXAMPLE_MODEM_PROBE_INTERVAL_S * 1000000LL;
+            bool ip_lost = xEventGroupGetBits(event_group) & LOST_IP_BIT;
+            if (esp_modem_probe_run(dce, &probe_config, &probe) == ESP_OK &&
+                (probe.verdict != ESP_MODEM_PROBE_NETWORK_OK || ip_lost) &&
+                esp_modem_probe_recover(dce, &probe) != ESP_OK) {
+                ESP_LOGE(TAG, "Recovery failed, power cycle the modem");
+            }
+        }
+#endif
+#if CONFIG_EXAMPLE_MODEM_SCHEDULER
+        if (!report_pending) {
+            /* Set before submitting, the scheduler task may release the report at once */
+            report_pending = true;
+            if (esp_modem_scheduler_submit(scheduler, 0, EXAMPLE_SCHEDULER_REPORT_SIZE,
+                                           CONFIG_EXAMPLE_MODEM_SCHEDULER_DEADLINE_S * 1000,
+                                           example_scheduled_report, (void *)&report_pending) != ESP_OK) {
+                report_pending = false;
+            }
+        }
+        esp_modem_scheduler_sample_signal(scheduler);
+        esp_modem_scheduler_stats_t scheduler_stats;
+        ESP_ERROR_CHECK(esp_modem_scheduler_get_stats(scheduler, 0, &scheduler_stats));
+        ESP_LOGI(TAG, "scheduler: released %d (signal %d, deadline %d), saved %d ms %d uAh",
+                 scheduler_stats.released, scheduler_stats.released_on_signal, scheduler_stats.released_on_deadline,
+                 (int)scheduler_stats.time_saved_ms, (int)scheduler_stats.energy_saved_uah);
+#endif
         /* Get signal quality again */
         ESP_ERROR_CHECK(dce->get_signal_quality(dce, &rssi, &ber));
         ESP_LOGI(TAG, "rssi: %d, ber: %d", rssi, ber);
+        esp_modem_wake_stats_t wake_stats;
+        if (esp_modem_get_wake_stats(dte, &wake_stats) == ESP_OK) {
+            ESP_LOGI(TAG, "wakeups: ri %d, uart %d, lines %d, sleeps %d", wake_stats.ri_wakeups,
+                     wake_stats.uart_wakeups, wake_stats.wake_lines, wake_stats.sleep_allowed);
+        }
         vTaskDelay(pdMS_TO_TICKS(5000));
     }
 